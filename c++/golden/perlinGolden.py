@@ -0,0 +1,45 @@
+"""
+@author: Skeel Lee
+@contact: skeel@skeelogy.com
+
+Writes the perlin.py golden results of skNoiseGolden. It reads the inputs of
+the C reference golden file and writes the results of SimplexNoise.snoise3()
+in python/libnoise/perlin.py for the same inputs:
+
+    python golden/perlinGolden.py golden/fbm_noise3.golden golden/perlin_snoise3.golden
+
+Runs with Python 2 and 3, and does not need Maya.
+"""
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'python'))
+
+import libnoise.perlin
+
+def main(inputPath, outputPath):
+    noise = libnoise.perlin.SimplexNoise()
+    inputFile = open(inputPath, 'r')
+    outputFile = open(outputPath, 'w')
+    outputFile.write('# x y z octaves persistence lacunarity value\n')
+    outputFile.write('# results of SimplexNoise.snoise3() in python/libnoise/perlin.py, written by perlinGolden.py\n')
+    for line in inputFile:
+        if line.startswith('#') or not line.strip():
+            continue
+
+        #only the inputs are taken from the C reference file
+        fields = line.split()
+        x, y, z = float(fields[0]), float(fields[1]), float(fields[2])
+        octaves = int(fields[3])
+        persistence, lacunarity = float(fields[4]), float(fields[5])
+        value = noise.snoise3(x, y, z, octaves, persistence, lacunarity)
+        outputFile.write('%s %s %s %d %s %s %.17g\n' % (fields[0], fields[1], fields[2], octaves, fields[4], fields[5], value))
+    inputFile.close()
+    outputFile.close()
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.stderr.write('usage: perlinGolden.py fbmGoldenFile perlinGoldenFile\n')
+        sys.exit(2)
+    main(sys.argv[1], sys.argv[2])
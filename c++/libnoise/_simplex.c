@@ -5,6 +5,10 @@
 /*
  * Skeel Lee, 2 Jun 2014
  * Commented out the Python-related codes so that C++ can import this
+ *
+ * Made fbm_noise3() and fbm_noise4() static inline so that this file links
+ * the same way when it is included from C (python/libnoise/_fastnoise.c) and
+ * from C++
  */
 
 //#include "Python.h"
@@ -131,7 +135,7 @@ noise3(float x, float y, float z)
 	return (noise[0] + noise[1] + noise[2] + noise[3]) * 32.0f;
 }
 
-inline float
+static inline float
 fbm_noise3(float x, float y, float z, int octaves, float persistence, float lacunarity) {
     float freq = 1.0f;
     float amp = 1.0f;
@@ -240,7 +244,7 @@ noise4(float x, float y, float z, float w) {
     return 27.0 * (noise[0] + noise[1] + noise[2] + noise[3] + noise[4]);
 }
 
-inline float
+static inline float
 fbm_noise4(float x, float y, float z, float w, int octaves, float persistence, float lacunarity) {
     float freq = 1.0f;
     float amp = 1.0f;
@@ -0,0 +1,207 @@
+/*
+ * Compact encodings of per-point displacements for the frame cache of the
+ * noise deformer plugins.
+ *
+ * Displacements are stored either as IEEE half floats (fp16) or as 16-bit
+ * fixed point numbers scaled by the largest magnitude on each axis. Both take
+ * 6 bytes per point instead of 12. The half float conversions use the F16C
+ * instructions when the compiler targets them (e.g. -mf16c), and a portable
+ * scalar version otherwise.
+ *
+ * This header does not depend on Maya.
+ *
+ * ---------License-------------
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ *
+ */
+
+#ifndef _SK_DISPLACEMENT_CODEC_H_
+#define _SK_DISPLACEMENT_CODEC_H_
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+//largest code of the 16-bit fixed point encoding
+const float FIXED16_MAX_CODE = 32767.0f;
+
+//converts a float to a half float, rounding to nearest even
+inline unsigned short floatToHalf(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const unsigned int sign = (bits >> 16) & 0x8000;
+    const unsigned int absBits = bits & 0x7fffffff;
+
+    //infinity, and NaN as a quiet NaN that keeps the top of the payload
+    if (absBits >= 0x7f800000)
+    {
+        return static_cast<unsigned short>(sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 | ((absBits >> 13) & 0x3ff) : 0));
+    }
+
+    //overflow to infinity
+    if (absBits >= 0x477ff000)
+    {
+        return static_cast<unsigned short>(sign | 0x7c00);
+    }
+
+    //subnormal half floats, including zero
+    if (absBits < 0x38800000)
+    {
+        if (absBits < 0x33000000)
+        {
+            return static_cast<unsigned short>(sign);
+        }
+        const unsigned int exponent = absBits >> 23;
+        const unsigned int mantissa = (absBits & 0x7fffff) | 0x800000;
+        const unsigned int shift = 126 - exponent;
+        unsigned int half = mantissa >> shift;
+        const unsigned int remainder = mantissa & ((1u << shift) - 1);
+        const unsigned int halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+        {
+            ++half;
+        }
+        return static_cast<unsigned short>(sign | half);
+    }
+
+    //normal half floats, a carry out of the mantissa correctly bumps the exponent
+    unsigned int half = ((absBits - 0x38000000) >> 13);
+    const unsigned int remainder = absBits & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    {
+        ++half;
+    }
+    return static_cast<unsigned short>(sign | half);
+}
+
+//converts a half float to a float, exactly
+inline float halfToFloat(unsigned short half)
+{
+    const unsigned int sign = (half & 0x8000u) << 16;
+    unsigned int exponent = (half >> 10) & 0x1f;
+    unsigned int mantissa = half & 0x3ff;
+    unsigned int bits;
+
+    if (0 == exponent)
+    {
+        if (0 == mantissa)
+        {
+            bits = sign;
+        }
+        else
+        {
+            //normalize the subnormal half float
+            exponent = 113;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    }
+    else if (0x1f == exponent)
+    {
+        //infinity, and NaN as a quiet NaN
+        bits = sign | 0x7f800000 | (mantissa ? 0x400000 | (mantissa << 13) : 0);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+//encodes count floats as half floats
+inline void encodeHalf(const float *values, unsigned short *halves, int count)
+{
+    int i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(values + i), 0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(halves + i), packed);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        halves[i] = floatToHalf(values[i]);
+    }
+}
+
+//decodes count half floats
+inline void decodeHalf(const unsigned short *halves, float *values, int count)
+{
+    int i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i));
+        _mm256_storeu_ps(values + i, _mm256_cvtph_ps(packed));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        values[i] = halfToFloat(halves[i]);
+    }
+}
+
+//calculates the per-axis scales of the fixed point encoding for count interleaved xyz values
+inline void fixed16Scales(const float *values, int count, float *scales)
+{
+    float maxAbs[3] = { 0.0f, 0.0f, 0.0f };
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        const float absValue = std::fabs(values[i]);
+        if (absValue > maxAbs[i % 3])
+        {
+            maxAbs[i % 3] = absValue;
+        }
+    }
+    for (i = 0; i < 3; ++i)
+    {
+        scales[i] = maxAbs[i] / FIXED16_MAX_CODE;
+    }
+}
+
+//encodes count interleaved xyz values as 16-bit fixed point numbers with the given per-axis scales
+inline void encodeFixed16(const float *values, short *codes, int count, const float *scales)
+{
+    const float invScales[3] = {
+        scales[0] > 0.0f ? 1.0f / scales[0] : 0.0f,
+        scales[1] > 0.0f ? 1.0f / scales[1] : 0.0f,
+        scales[2] > 0.0f ? 1.0f / scales[2] : 0.0f
+    };
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        float code = values[i] * invScales[i % 3];
+        code = code > FIXED16_MAX_CODE ? FIXED16_MAX_CODE : (code < -FIXED16_MAX_CODE ? -FIXED16_MAX_CODE : code);
+        codes[i] = static_cast<short>(code < 0.0f ? code - 0.5f : code + 0.5f);
+    }
+}
+
+//decodes count interleaved xyz 16-bit fixed point numbers
+inline void decodeFixed16(const short *codes, float *values, int count, const float *scales)
+{
+    int i;
+    for (i = 0; i + 3 <= count; i += 3)
+    {
+        values[i] = codes[i] * scales[0];
+        values[i + 1] = codes[i + 1] * scales[1];
+        values[i + 2] = codes[i + 2] * scales[2];
+    }
+}
+
+#endif
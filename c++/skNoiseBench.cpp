@@ -0,0 +1,942 @@
+/*
+ * skNoiseBench
+ *
+ * Benchmarks of the noise evaluation of the skNoiseDeformer plugins, run on
+ * generated points with the same kernels as the plugins. This tool does not
+ * depend on Maya.
+ *
+ * The order benchmark compares evaluating the points in their index order
+ * with evaluating them in Z-order (Morton order), as skNoiseDeformerMT does
+ * when spatialReorder is on. The points lie on a sphere and come in two index
+ * orders: row by row like a modelled mesh, and shuffled like a scanned or
+ * merged mesh. In Z-order the points are gathered before and the results
+ * scattered back after the evaluation, and both are part of the timings. The
+ * order itself is cached by the deformer, so the time to compute it is
+ * printed separately. The tasks run one after another on the calling thread,
+ * so that only memory locality differs between the runs, and the results of
+ * both orders are checked to be identical.
+ *
+ * Where the kernel allows it (Linux with perf_event_paranoid low enough, and
+ * hardware counters exposed to virtual machines), the cache misses and level 1
+ * data cache read misses of each run are printed as well.
+ *
+ * The scaling benchmark evaluates the row ordered points with 1, 2, 4 and up
+ * to -maxThreads threads of the parallel-for backend that the tool was built
+ * with (see skParallel.h), split into at least 4 tasks per thread. It prints
+ * the throughput and the speedup over one thread, and how many threads
+ * actually ran tasks, since a backend may use fewer than requested (e.g. TBB
+ * never uses more than there are processors). The results of every thread
+ * count are checked to be identical to the ones of a single thread.
+ *
+ * The NUMA benchmark compares the two ways that skNoiseDeformerMT evaluates
+ * the points with numaAware off and on. The points and results are allocated
+ * and first touched by the calling thread, like the arrays of a mesh. With
+ * numaAware off, the tasks read and write them in place. With it on, every
+ * task is pinned to the node that owns its range, copies the range into a
+ * working buffer that it allocated while pinned, evaluates it from there and
+ * copies the results back. For both, the loads served by the memory of any
+ * node (node-loads) and by the memory of another node (node-load-misses) are
+ * counted over all tasks, which shows the cross-socket traffic where the
+ * kernel exposes these counters. On a machine with a single node, the run
+ * with numaAware on only shows the cost of the extra copies.
+ *
+ * ---------Usage-------------
+ *
+ * 1) Build the tool with "make bench". It is built as skNoiseBench on the
+ * pthread backend, or as skNoiseBench_openmp or skNoiseBench_tbb with
+ * "make bench PARALLEL=openmp" or "make bench PARALLEL=tbb".
+ *
+ * 2) Run the order benchmark with e.g.:
+ *
+ *     skNoiseBench -order -points 1000000 -octaves 4
+ *
+ * 3) Run the scaling benchmark of each backend with e.g.:
+ *
+ *     skNoiseBench -scaling -maxThreads 64
+ *
+ * 4) Run the NUMA benchmark on a machine with more than one node with e.g.:
+ *
+ *     skNoiseBench -numa -points 4000000 -octaves 1 -numTasks 64
+ *
+ * A single octave keeps the noise cheap, so that memory traffic weighs more.
+ *
+ * The flags are -points (-pt, 1000000 by default), -radius (-r) of the
+ * sphere (10 by default), -frequency (-f), -octaves (-oc, 4 by default),
+ * -numTasks (-nt, 16 by default), -maxThreads (-mt, 64 by default) and
+ * -repeats (-rp), the number of runs of which the fastest is printed (5 by
+ * default).
+ *
+ * ---------Credits-------------
+ *
+ * This tool uses the noise library from Casey Duncan:
+ * https://github.com/caseman/noise
+ *
+ * ---------License-------------
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "skNoiseKernels.h"
+#include "skParallel.h"
+
+const char *toolName = "skNoiseBench";
+
+const double BENCH_PI = 3.14159265358979323846;
+
+//parameters of one benchmark
+struct BenchSettings
+{
+    NoiseQuery query;
+    int numPoints;
+    double radius;
+    int numTasks;
+    int maxThreads;
+    int repeats;
+};
+
+//a range of the points of the scaling benchmark, evaluated by one task
+typedef struct
+{
+    const NoiseQuery *query;
+    const double *positions;
+    float *results;
+    int start;
+    int end;
+    pthread_t thread;
+} ScalingTask;
+
+//best time and counter values of one kind of run, counters are -1 if not available
+struct BenchResult
+{
+    double seconds;
+    long long cacheMisses;
+    long long l1ReadMisses;
+};
+
+//hardware counters of the calling thread
+struct BenchCounters
+{
+    int cacheMissesFile;
+    int l1ReadMissesFile;
+};
+
+//most NUMA nodes that the NUMA benchmark pins tasks to
+const int BENCH_MAX_NUMA_NODES = 64;
+
+//a range of the points of the NUMA benchmark, evaluated by one task in place or, pinned to its
+//node, out of a working buffer that it keeps between runs. The counters are -1 if not available.
+typedef struct
+{
+    const NoiseQuery *query;
+    const double *positions;
+    float *results;
+    int start;
+    int end;
+    int node;
+    bool numaLocal;
+    double *work;
+    float *workResults;
+    long long nodeLoads;
+    long long nodeLoadMisses;
+} NumaTask;
+
+static double currentSeconds()
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec * 1.0e-6;
+}
+
+#if defined(__linux__)
+
+//opens a counter of the calling thread that starts disabled, -1 if it is not available
+static int openCounter(unsigned int type, unsigned long long config)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static void openCounters(BenchCounters *counters)
+{
+    counters->cacheMissesFile = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    counters->l1ReadMissesFile = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                                             | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                             | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+static void startCounter(int file)
+{
+    if (file >= 0)
+    {
+        ioctl(file, PERF_EVENT_IOC_RESET, 0);
+        ioctl(file, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static long long stopCounter(int file)
+{
+    long long value = -1;
+    if (file >= 0)
+    {
+        ioctl(file, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(file, &value, sizeof(value)) != sizeof(value))
+        {
+            value = -1;
+        }
+    }
+    return value;
+}
+
+static void closeCounters(BenchCounters *counters)
+{
+    if (counters->cacheMissesFile >= 0)
+    {
+        close(counters->cacheMissesFile);
+    }
+    if (counters->l1ReadMissesFile >= 0)
+    {
+        close(counters->l1ReadMissesFile);
+    }
+}
+
+//opens the counters of the loads of the calling thread that are served by the memory of any node
+//and by the memory of another node
+static void openNodeCounters(int *loadsFile, int *missesFile)
+{
+    *loadsFile = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_NODE
+                             | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                             | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16));
+    *missesFile = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_NODE
+                              | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                              | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+static void closeCounter(int file)
+{
+    if (file >= 0)
+    {
+        close(file);
+    }
+}
+
+//CPUs of every NUMA node as reported by sysfs, and the affinity of the process before pinning
+static int benchNumaNodes = 0;
+static cpu_set_t benchNodeCpus[BENCH_MAX_NUMA_NODES];
+static cpu_set_t benchProcessCpus;
+
+//parses a sysfs cpulist string such as "0-7,16-23" into a CPU set
+static void parseCpuList(const char *cpuList, cpu_set_t *cpus)
+{
+    CPU_ZERO(cpus);
+    const char *c = cpuList;
+    char *end;
+    long first, last, cpu;
+    while (*c)
+    {
+        first = strtol(c, &end, 10);
+        if (end == c)
+        {
+            break;
+        }
+        last = first;
+        c = end;
+        if ('-' == *c)
+        {
+            ++c;
+            last = strtol(c, &end, 10);
+            c = end;
+        }
+        for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+        {
+            CPU_SET(cpu, cpus);
+        }
+        if (',' == *c)
+        {
+            ++c;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+//returns the number of NUMA nodes, reading their CPUs from sysfs on first use. Without sysfs, all
+//CPUs of the process count as a single node.
+static int numaNodeCount()
+{
+    if (0 == benchNumaNodes)
+    {
+        sched_getaffinity(0, sizeof(cpu_set_t), &benchProcessCpus);
+        char path[128];
+        char cpuList[1024];
+        FILE *file;
+        while (benchNumaNodes < BENCH_MAX_NUMA_NODES)
+        {
+            sprintf(path, "/sys/devices/system/node/node%d/cpulist", benchNumaNodes);
+            file = fopen(path, "r");
+            if (!file)
+            {
+                break;
+            }
+            if (!fgets(cpuList, sizeof(cpuList), file))
+            {
+                cpuList[0] = '\0';
+            }
+            fclose(file);
+            parseCpuList(cpuList, &benchNodeCpus[benchNumaNodes]);
+            ++benchNumaNodes;
+        }
+        if (0 == benchNumaNodes)
+        {
+            benchNodeCpus[0] = benchProcessCpus;
+            benchNumaNodes = 1;
+        }
+    }
+    return benchNumaNodes;
+}
+
+//restricts the calling thread to the CPUs of the given node
+static bool pinToNumaNode(int node)
+{
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &benchNodeCpus[node]);
+}
+
+//gives the calling thread the affinity of the process back
+static void unpinFromNumaNode()
+{
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &benchProcessCpus);
+}
+
+#else
+
+static void openCounters(BenchCounters *counters)
+{
+    counters->cacheMissesFile = -1;
+    counters->l1ReadMissesFile = -1;
+}
+
+static void startCounter(int)
+{
+}
+
+static long long stopCounter(int)
+{
+    return -1;
+}
+
+static void closeCounters(BenchCounters *)
+{
+}
+
+static void openNodeCounters(int *loadsFile, int *missesFile)
+{
+    *loadsFile = -1;
+    *missesFile = -1;
+}
+
+static void closeCounter(int)
+{
+}
+
+static int numaNodeCount()
+{
+    return 1;
+}
+
+static bool pinToNumaNode(int)
+{
+    return false;
+}
+
+static void unpinFromNumaNode()
+{
+}
+
+#endif
+
+//points on a sphere, row by row from pole to pole, or shuffled
+static void generateSpherePoints(int numPoints, double radius, bool shuffled, std::vector<double>& positions)
+{
+    const int numRows = std::max(static_cast<int>(sqrt(numPoints * 0.5)), 1);
+    const int numColumns = (numPoints + numRows - 1) / numRows;
+    positions.resize(3 * numPoints);
+    int i;
+    for (i = 0; i < numPoints; ++i)
+    {
+        const double theta = BENCH_PI * (i / numColumns + 0.5) / numRows;
+        const double phi = 2.0 * BENCH_PI * (i % numColumns) / numColumns;
+        positions[3 * i] = radius * sin(theta) * cos(phi);
+        positions[3 * i + 1] = radius * cos(theta);
+        positions[3 * i + 2] = radius * sin(theta) * sin(phi);
+    }
+
+    //Fisher-Yates shuffle with a fixed seed, so that every run gets the same order
+    if (shuffled)
+    {
+        unsigned int state = 12345;
+        int j, c;
+        for (i = numPoints - 1; i > 0; --i)
+        {
+            state = state * 1664525u + 1013904223u;
+            j = static_cast<int>(state % static_cast<unsigned int>(i + 1));
+            for (c = 0; c < 3; ++c)
+            {
+                std::swap(positions[3 * i + c], positions[3 * j + c]);
+            }
+        }
+    }
+}
+
+//evaluates the noise of the points split into tasks, gathering them into the given order first
+//and scattering the results back after if there is one
+static void evaluatePoints(const BenchSettings& settings, const std::vector<double>& positions, const std::vector<unsigned int> *order,
+                           std::vector<double>& orderedPositions, std::vector<float>& orderedResults, std::vector<float>& results)
+{
+    const int numPoints = settings.numPoints;
+    const int taskSize = (numPoints + settings.numTasks - 1) / settings.numTasks;
+    const double *taskPositions = &positions[0];
+    float *taskResults = &results[0];
+    int i, c, start;
+
+    if (order)
+    {
+        for (i = 0; i < numPoints; ++i)
+        {
+            for (c = 0; c < 3; ++c)
+            {
+                orderedPositions[3 * i + c] = positions[3 * (*order)[i] + c];
+            }
+        }
+        taskPositions = &orderedPositions[0];
+        taskResults = &orderedResults[0];
+    }
+
+    for (start = 0; start < numPoints; start += taskSize)
+    {
+        evaluateNoiseQuery(settings.query, taskPositions, start, std::min(start + taskSize, numPoints), taskResults);
+    }
+
+    if (order)
+    {
+        for (i = 0; i < numPoints; ++i)
+        {
+            for (c = 0; c < 3; ++c)
+            {
+                results[3 * (*order)[i] + c] = orderedResults[3 * i + c];
+            }
+        }
+    }
+}
+
+//runs one kind of evaluation the given number of times, keeping the fastest run
+static BenchResult runEvaluation(const BenchSettings& settings, BenchCounters *counters, const std::vector<double>& positions,
+                                 const std::vector<unsigned int> *order, std::vector<float>& results)
+{
+    std::vector<double> orderedPositions(order ? positions.size() : 0);
+    std::vector<float> orderedResults(order ? results.size() : 0);
+    BenchResult best;
+    best.seconds = HUGE_VAL;
+    best.cacheMisses = -1;
+    best.l1ReadMisses = -1;
+    int run;
+    for (run = 0; run < settings.repeats; ++run)
+    {
+        startCounter(counters->cacheMissesFile);
+        startCounter(counters->l1ReadMissesFile);
+        const double startTime = currentSeconds();
+        evaluatePoints(settings, positions, order, orderedPositions, orderedResults, results);
+        const double seconds = currentSeconds() - startTime;
+        const long long cacheMisses = stopCounter(counters->cacheMissesFile);
+        const long long l1ReadMisses = stopCounter(counters->l1ReadMissesFile);
+        if (seconds < best.seconds)
+        {
+            best.seconds = seconds;
+            best.cacheMisses = cacheMisses;
+            best.l1ReadMisses = l1ReadMisses;
+        }
+    }
+    return best;
+}
+
+static void printCounter(long long value)
+{
+    if (value < 0)
+    {
+        printf(" %14s", "n/a");
+    }
+    else
+    {
+        printf(" %14lld", value);
+    }
+}
+
+static void printResult(const char *name, const BenchResult& result)
+{
+    printf("%-22s %10.2f", name, result.seconds * 1.0e3);
+    printCounter(result.cacheMisses);
+    printCounter(result.l1ReadMisses);
+    printf("\n");
+}
+
+//compares the evaluation in index order with the one in Z-order, returning false if the results differ
+static bool runOrderBenchmark(const BenchSettings& settings)
+{
+    BenchCounters counters;
+    openCounters(&counters);
+    if (counters.cacheMissesFile < 0 && counters.l1ReadMissesFile < 0)
+    {
+        printf("[%s] Hardware cache counters are not available, only timings are printed\n", toolName);
+    }
+    printf("[%s] %d points on a sphere of radius %g, %d octaves, %d tasks, fastest of %d runs\n", toolName,
+           settings.numPoints, settings.radius, settings.query.octaves, settings.numTasks, settings.repeats);
+    printf("%-22s %10s %14s %14s\n", "points", "time (ms)", "cache misses", "L1D misses");
+
+    const char *orderNames[2] = { "rows", "shuffled" };
+    std::vector<double> positions;
+    std::vector<unsigned int> order;
+    std::vector<float> indexResults(3 * settings.numPoints);
+    std::vector<float> mortonResults(3 * settings.numPoints);
+    char name[64];
+    bool identical = true;
+    int shuffled;
+    for (shuffled = 0; shuffled < 2; ++shuffled)
+    {
+        generateSpherePoints(settings.numPoints, settings.radius, shuffled != 0, positions);
+
+        const double startTime = currentSeconds();
+        computeMortonOrder(&positions[0], settings.numPoints, order);
+        const double orderSeconds = currentSeconds() - startTime;
+
+        const BenchResult indexResult = runEvaluation(settings, &counters, positions, NULL, indexResults);
+        const BenchResult mortonResult = runEvaluation(settings, &counters, positions, &order, mortonResults);
+        sprintf(name, "%s, index order", orderNames[shuffled]);
+        printResult(name, indexResult);
+        sprintf(name, "%s, Z-order", orderNames[shuffled]);
+        printResult(name, mortonResult);
+        printf("%-22s %10.2f\n", "(computing Z-order)", orderSeconds * 1.0e3);
+
+        if (0 != memcmp(&indexResults[0], &mortonResults[0], indexResults.size() * sizeof(float)))
+        {
+            fprintf(stderr, "[%s] The results in Z-order differ from the ones in index order for %s points\n", toolName, orderNames[shuffled]);
+            identical = false;
+        }
+    }
+
+    closeCounters(&counters);
+    return identical;
+}
+
+//evaluates the noise of one range, remembering the thread that ran it
+static void evaluateRange(void *data)
+{
+    ScalingTask *task = static_cast<ScalingTask*>(data);
+    evaluateNoiseQuery(*task->query, task->positions, task->start, task->end, task->results);
+    task->thread = pthread_self();
+}
+
+//number of different threads that ran the tasks
+static int countThreads(const std::vector<ScalingTask>& tasks)
+{
+    std::vector<pthread_t> threads;
+    size_t i, j;
+    for (i = 0; i < tasks.size(); ++i)
+    {
+        for (j = 0; j < threads.size() && !pthread_equal(threads[j], tasks[i].thread); ++j)
+        {
+        }
+        if (j == threads.size())
+        {
+            threads.push_back(tasks[i].thread);
+        }
+    }
+    return static_cast<int>(threads.size());
+}
+
+//evaluates the points with more and more threads, returning false if the results differ from the
+//ones of a single thread
+static bool runScalingBenchmark(const BenchSettings& settings)
+{
+    printf("[%s] %s backend, %d processors online, %d points, %d octaves, fastest of %d runs\n", toolName,
+           SK_PARALLEL_BACKEND_NAME, static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)), settings.numPoints,
+           settings.query.octaves, settings.repeats);
+    printf("%8s %8s %8s %10s %10s %8s\n", "threads", "tasks", "used", "time (ms)", "Mpoints/s", "speedup");
+
+    std::vector<double> positions;
+    generateSpherePoints(settings.numPoints, settings.radius, false, positions);
+    std::vector<float> expected(3 * settings.numPoints);
+    evaluateNoiseQuery(settings.query, &positions[0], 0, settings.numPoints, &expected[0]);
+
+    std::vector<float> results(3 * settings.numPoints);
+    double singleSeconds = 0.0;
+    bool identical = true;
+    int numThreads, run, start;
+    for (numThreads = 1; numThreads <= settings.maxThreads; numThreads *= 2)
+    {
+        if (!parallelSetNumThreads(numThreads))
+        {
+            fprintf(stderr, "[%s] The %s backend cannot limit its number of threads\n", toolName, SK_PARALLEL_BACKEND_NAME);
+            return identical;
+        }
+        parallelInit();
+
+        const int numTasks = std::min(std::max(settings.numTasks, 4 * numThreads), settings.numPoints);
+        const int taskSize = (settings.numPoints + numTasks - 1) / numTasks;
+        std::vector<ScalingTask> tasks;
+        for (start = 0; start < settings.numPoints; start += taskSize)
+        {
+            ScalingTask task;
+            task.query = &settings.query;
+            task.positions = &positions[0];
+            task.results = &results[0];
+            task.start = start;
+            task.end = std::min(start + taskSize, settings.numPoints);
+            task.thread = pthread_self();
+            tasks.push_back(task);
+        }
+
+        //the thread count is taken from the slowest run, which is the most likely to have used them all
+        double best = HUGE_VAL;
+        int usedThreads = 1;
+        for (run = 0; run < settings.repeats; ++run)
+        {
+            const double startTime = currentSeconds();
+            parallelFor(static_cast<int>(tasks.size()), evaluateRange, &tasks[0], sizeof(ScalingTask));
+            const double seconds = currentSeconds() - startTime;
+            best = std::min(best, seconds);
+            usedThreads = std::max(usedThreads, countThreads(tasks));
+        }
+        parallelRelease();
+
+        if (1 == numThreads)
+        {
+            singleSeconds = best;
+        }
+        printf("%8d %8d %8d %10.2f %10.2f %8.2f\n", numThreads, static_cast<int>(tasks.size()), usedThreads,
+               best * 1.0e3, settings.numPoints / best * 1.0e-6, singleSeconds / best);
+
+        if (0 != memcmp(&results[0], &expected[0], results.size() * sizeof(float)))
+        {
+            fprintf(stderr, "[%s] The results with %d threads differ from the ones of a single thread\n", toolName, numThreads);
+            identical = false;
+        }
+    }
+    parallelSetNumThreads(0);
+    return identical;
+}
+
+//evaluates the noise of one range of the NUMA benchmark, counting the node loads of its thread. With
+//numaLocal, the range is copied into the working buffers of the task and the results copied back,
+//as skNoiseDeformerMT does with numaAware on.
+static void evaluateNumaRange(void *data)
+{
+    NumaTask *task = static_cast<NumaTask*>(data);
+    int loadsFile, missesFile;
+    openNodeCounters(&loadsFile, &missesFile);
+    startCounter(loadsFile);
+    startCounter(missesFile);
+
+    const int count = task->end - task->start;
+    bool pinned = false;
+    if (task->numaLocal)
+    {
+        //the buffers are allocated by the pinned thread on the first run, so that they are first
+        //touched, and thus placed, on its node
+        pinned = pinToNumaNode(task->node);
+        if (!task->work)
+        {
+            task->work = static_cast<double*>(malloc(3 * count * sizeof(double)));
+            task->workResults = static_cast<float*>(malloc(3 * count * sizeof(float)));
+        }
+    }
+    if (task->numaLocal && task->work && task->workResults)
+    {
+        memcpy(task->work, task->positions + 3 * task->start, 3 * count * sizeof(double));
+        evaluateNoiseQuery(*task->query, task->work, 0, count, task->workResults);
+        memcpy(task->results + 3 * task->start, task->workResults, 3 * count * sizeof(float));
+    }
+    else
+    {
+        evaluateNoiseQuery(*task->query, task->positions, task->start, task->end, task->results);
+    }
+    if (pinned)
+    {
+        unpinFromNumaNode();
+    }
+
+    task->nodeLoads = stopCounter(loadsFile);
+    task->nodeLoadMisses = stopCounter(missesFile);
+    closeCounter(loadsFile);
+    closeCounter(missesFile);
+}
+
+//evaluates the points in place and out of node-local working buffers, returning false if the
+//results differ from the ones of a single thread
+static bool runNumaBenchmark(const BenchSettings& settings)
+{
+    const int numNodes = numaNodeCount();
+    printf("[%s] %s backend, %d NUMA nodes, %d points, %d octaves, fastest of %d runs\n", toolName,
+           SK_PARALLEL_BACKEND_NAME, numNodes, settings.numPoints, settings.query.octaves, settings.repeats);
+    if (1 == numNodes)
+    {
+        printf("[%s] There is a single NUMA node, so numaAware on only adds the copies\n", toolName);
+    }
+
+    //the points and results are first touched by this thread, like the arrays of a mesh
+    std::vector<double> positions;
+    generateSpherePoints(settings.numPoints, settings.radius, false, positions);
+    std::vector<float> expected(3 * settings.numPoints);
+    evaluateNoiseQuery(settings.query, &positions[0], 0, settings.numPoints, &expected[0]);
+    std::vector<float> results(3 * settings.numPoints);
+
+    //split the points into contiguous ranges, assigned to the nodes in blocks like the deformer does
+    const int numTasks = std::min(std::max(settings.numTasks, numNodes), settings.numPoints);
+    const int taskSize = (settings.numPoints + numTasks - 1) / numTasks;
+    std::vector<NumaTask> tasks;
+    int start;
+    for (start = 0; start < settings.numPoints; start += taskSize)
+    {
+        NumaTask task;
+        task.query = &settings.query;
+        task.positions = &positions[0];
+        task.results = &results[0];
+        task.start = start;
+        task.end = std::min(start + taskSize, settings.numPoints);
+        task.node = static_cast<int>(tasks.size()) * numNodes / numTasks;
+        task.numaLocal = false;
+        task.work = NULL;
+        task.workResults = NULL;
+        tasks.push_back(task);
+    }
+
+    parallelInit();
+    printf("%-10s %8s %10s %14s %14s %9s\n", "numaAware", "tasks", "time (ms)", "node loads", "remote loads", "remote %");
+    const char *modeNames[2] = { "off", "on" };
+    bool identical = true;
+    bool countersAvailable = true;
+    int numaLocal, run;
+    size_t i;
+    for (numaLocal = 0; numaLocal < 2; ++numaLocal)
+    {
+        for (i = 0; i < tasks.size(); ++i)
+        {
+            tasks[i].numaLocal = numaLocal != 0;
+        }
+        std::fill(results.begin(), results.end(), 0.0f);
+
+        //the loads of a run are summed over its tasks, and are not available if any task lacks them
+        double best = HUGE_VAL;
+        long long bestLoads = -1;
+        long long bestMisses = -1;
+        for (run = 0; run < settings.repeats; ++run)
+        {
+            const double startTime = currentSeconds();
+            parallelFor(static_cast<int>(tasks.size()), evaluateNumaRange, &tasks[0], sizeof(NumaTask));
+            const double seconds = currentSeconds() - startTime;
+            long long loads = 0;
+            long long misses = 0;
+            for (i = 0; i < tasks.size(); ++i)
+            {
+                loads = (loads < 0 || tasks[i].nodeLoads < 0) ? -1 : loads + tasks[i].nodeLoads;
+                misses = (misses < 0 || tasks[i].nodeLoadMisses < 0) ? -1 : misses + tasks[i].nodeLoadMisses;
+            }
+            if (seconds < best)
+            {
+                best = seconds;
+                bestLoads = loads;
+                bestMisses = misses;
+            }
+        }
+
+        printf("%-10s %8d %10.2f", modeNames[numaLocal], static_cast<int>(tasks.size()), best * 1.0e3);
+        printCounter(bestLoads);
+        printCounter(bestMisses);
+        if (bestLoads > 0 && bestMisses >= 0)
+        {
+            printf(" %9.2f\n", 100.0 * bestMisses / bestLoads);
+        }
+        else
+        {
+            printf(" %9s\n", "n/a");
+            countersAvailable = false;
+        }
+
+        if (0 != memcmp(&results[0], &expected[0], results.size() * sizeof(float)))
+        {
+            fprintf(stderr, "[%s] The results with numaAware %s differ from the ones of a single thread\n", toolName, modeNames[numaLocal]);
+            identical = false;
+        }
+    }
+    parallelRelease();
+    if (!countersAvailable)
+    {
+        printf("[%s] Node load counters are not available, only timings are printed\n", toolName);
+    }
+
+    for (i = 0; i < tasks.size(); ++i)
+    {
+        free(tasks[i].work);
+        free(tasks[i].workResults);
+    }
+    return identical;
+}
+
+//reads count numbers after the flag at argv[i] into values, advancing i past them
+static bool getFlagValues(int argc, char **argv, int& i, double *values, int count)
+{
+    char *end;
+    int j;
+    for (j = 0; j < count; ++j)
+    {
+        if (++i >= argc)
+        {
+            return false;
+        }
+        values[j] = strtod(argv[i], &end);
+        if (end == argv[i] || '\0' != *end)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: %s -order | -scaling | -numa [flags]\n", toolName);
+    fprintf(stderr, "flags: -points (-pt), -radius (-r), -frequency (-f) x y z, -octaves (-oc),\n");
+    fprintf(stderr, "       -numTasks (-nt), -maxThreads (-mt), -repeats (-rp)\n");
+}
+
+int main(int argc, char **argv)
+{
+    //defaults of the deformer attributes, with a few octaves so that the lattice cache matters
+    BenchSettings settings;
+    NoiseQuery &query = settings.query;
+    query.freqs[0] = query.freqs[1] = query.freqs[2] = 1.0f;
+    query.offsets[0] = query.offsets[1] = query.offsets[2] = 0.0f;
+    query.octaves = 4;
+    query.persistence = 0.5f;
+    query.lacunarity = 2.0f;
+    query.fractalMode = FRACTAL_MODE_FBM;
+    query.noiseType = NOISE_TYPE_SIMPLEX;
+    query.warp.amount = 0.0f;
+    query.warp.freq = 1.0f;
+    query.warp.octaves = 2;
+    settings.numPoints = 1000000;
+    settings.radius = 10.0;
+    settings.numTasks = 16;
+    settings.maxThreads = 64;
+    settings.repeats = 5;
+
+    bool orderBenchmark = false;
+    bool scalingBenchmark = false;
+    bool numaBenchmark = false;
+    double values[3];
+    bool valid = true;
+    int i;
+    for (i = 1; i < argc && valid; ++i)
+    {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "-order"))
+        {
+            orderBenchmark = true;
+        }
+        else if (!strcmp(arg, "-scaling"))
+        {
+            scalingBenchmark = true;
+        }
+        else if (!strcmp(arg, "-numa"))
+        {
+            numaBenchmark = true;
+        }
+        else if (!strcmp(arg, "-pt") || !strcmp(arg, "-points"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.numPoints = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-r") || !strcmp(arg, "-radius"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.radius = values[0];
+        }
+        else if (!strcmp(arg, "-f") || !strcmp(arg, "-frequency"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 3);
+            query.freqs[0] = static_cast<float>(values[0]);
+            query.freqs[1] = static_cast<float>(values[1]);
+            query.freqs[2] = static_cast<float>(values[2]);
+        }
+        else if (!strcmp(arg, "-oc") || !strcmp(arg, "-octaves"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.octaves = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-nt") || !strcmp(arg, "-numTasks"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.numTasks = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-mt") || !strcmp(arg, "-maxThreads"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.maxThreads = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-rp") || !strcmp(arg, "-repeats"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.repeats = static_cast<int>(values[0]);
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    if (!valid || 1 != static_cast<int>(orderBenchmark) + static_cast<int>(scalingBenchmark) + static_cast<int>(numaBenchmark))
+    {
+        printUsage();
+        return 2;
+    }
+    if (settings.numPoints < 1 || query.octaves < 1 || settings.numTasks < 1 || settings.maxThreads < 1 || settings.repeats < 1)
+    {
+        fprintf(stderr, "[%s] points, octaves, numTasks, maxThreads and repeats must be at least 1\n", toolName);
+        return 2;
+    }
+
+    if (scalingBenchmark)
+    {
+        return runScalingBenchmark(settings) ? 0 : 1;
+    }
+    if (numaBenchmark)
+    {
+        return runNumaBenchmark(settings) ? 0 : 1;
+    }
+    return runOrderBenchmark(settings) ? 0 : 1;
+}
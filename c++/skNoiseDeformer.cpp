@@ -67,6 +67,11 @@
  * 5) Move/rotate/scale the accessory locator to transform the noise space, as
  * desired
  *
+ * 6) Set fractalMode to change how the octaves are summed: fBm (the default),
+ * Turbulence (absolute values, so the noise only pushes outwards), Billow
+ * (rounded lumps) or Ridged (ridged multifractal, sharp crests with smooth
+ * valleys, good for rocks). Every mode runs as fast as plain fBm.
+ *
  * ---------Credits-------------
  *
  * This plugin uses the noise library from Casey Duncan:
@@ -91,6 +96,7 @@
 #include <maya/MFnNumericAttribute.h>
 #include <maya/MFnNumericData.h>
 #include <maya/MFnMatrixAttribute.h>
+#include <maya/MFnEnumAttribute.h>
 
 #include <maya/MPoint.h>
 #include <maya/MMatrix.h>
@@ -100,7 +106,7 @@
 #include <maya/MFnDagNode.h>
 #include <maya/MFnDependencyNode.h>
 
-#include "libnoise/_simplex.c"
+#include "skNoiseKernels.h"
 
 #include "skNoiseDeformer.h"
 
@@ -124,6 +130,7 @@ MObject SkNoiseDeformer::offset;
 MObject SkNoiseDeformer::octaves;
 MObject SkNoiseDeformer::lacunarity;
 MObject SkNoiseDeformer::persistence;
+MObject SkNoiseDeformer::fractalMode;
 MObject SkNoiseDeformer::locatorWorldSpace;
 
 //main deform method
@@ -168,6 +175,10 @@ MStatus SkNoiseDeformer::deform(MDataBlock& dataBlock,
     CHECK_ERROR(stat, "Unable to get persistence data handle\n");
     float persistence = persistenceDataHandle.asFloat();
 
+    MDataHandle fractalModeDataHandle = dataBlock.inputValue(fractalMode, &stat);
+    CHECK_ERROR(stat, "Unable to get fractalMode data handle\n");
+    short fractalMode = fractalModeDataHandle.asShort();
+
     MDataHandle locatorWorldSpaceDataHandle = dataBlock.inputValue(locatorWorldSpace, &stat);
     CHECK_ERROR(stat, "Unable to get locatorWorldSpace data handle\n");
     MMatrix locatorWorldSpaceMat = locatorWorldSpaceDataHandle.asMatrix();
@@ -176,10 +187,13 @@ MStatus SkNoiseDeformer::deform(MDataBlock& dataBlock,
     MMatrix localToLocatorSpaceMat = localToWorldMat * locatorWorldSpaceMat.inverse();
     MMatrix locatorToLocalSpaceMat = locatorWorldSpaceMat * localToWorldMat.inverse();
 
+    //pick the kernel for the fractal mode and noise parameters once
+    NoiseKernel noiseKernel = selectNoiseKernel(octaves, persistence, lacunarity, freqs, fractalMode, NULL);
+
     //iterate through all the points
     float weight;
     MPoint pos;
-    float noiseInput[3];
+    float noiseValues[3];
     float envTimesWeight;
     for (geomIter.reset(); !geomIter.isDone(); geomIter.next())
     {
@@ -195,15 +209,15 @@ MStatus SkNoiseDeformer::deform(MDataBlock& dataBlock,
         pos *= localToLocatorSpaceMat;
 
         //precompute some values
-        noiseInput[0] = freqs[0] * pos.x - offsets[0];
-        noiseInput[1] = freqs[1] * pos.y - offsets[1];
-        noiseInput[2] = freqs[2] * pos.z - offsets[2];
         envTimesWeight = env * weight;
 
+        //calculate noise values
+        noiseKernel(pos.x, pos.y, pos.z, freqs, offsets, octaves, persistence, lacunarity, NULL, 0, NULL, noiseValues);
+
         //calculate new position
-        pos.x += amps[0] * fbm_noise3(noiseInput[0], noiseInput[1], noiseInput[2], octaves, persistence, lacunarity) * envTimesWeight;
-        pos.y += amps[1] * fbm_noise3(noiseInput[0] + 123, noiseInput[1] + 456, noiseInput[2] + 789, octaves, persistence, lacunarity) * envTimesWeight;
-        pos.z += amps[2] * fbm_noise3(noiseInput[0] + 234, noiseInput[1] + 567, noiseInput[2] + 890, octaves, persistence, lacunarity) * envTimesWeight;
+        pos.x += amps[0] * noiseValues[0] * envTimesWeight;
+        pos.y += amps[1] * noiseValues[1] * envTimesWeight;
+        pos.z += amps[2] * noiseValues[2] * envTimesWeight;
 
         //convert back to local space
         pos *= locatorToLocalSpaceMat;
@@ -276,6 +290,7 @@ MStatus SkNoiseDeformer::initialize()
 
     MFnNumericAttribute nAttr;
     MFnMatrixAttribute mAttr;
+    MFnEnumAttribute eAttr;
 
     //amplitude attr
     amp = nAttr.createPoint("amplitude", "amp", &stat);
@@ -335,6 +350,19 @@ MStatus SkNoiseDeformer::initialize()
     stat = attributeAffects(SkNoiseDeformer::persistence, SkNoiseDeformer::outputGeom);
     CHECK_ERROR(stat, "Unable to call attributeAffects from persistence to outputGeom");
 
+    //fractalMode attr
+    fractalMode = eAttr.create("fractalMode", "frm", FRACTAL_MODE_FBM, &stat);
+    CHECK_ERROR(stat, "Unable to create fractalMode attribute\n");
+    eAttr.addField("fBm", FRACTAL_MODE_FBM);
+    eAttr.addField("Turbulence", FRACTAL_MODE_TURBULENCE);
+    eAttr.addField("Billow", FRACTAL_MODE_BILLOW);
+    eAttr.addField("Ridged", FRACTAL_MODE_RIDGED);
+    eAttr.setKeyable(true);
+    stat = addAttribute(fractalMode);
+    CHECK_ERROR(stat, "Unable to add fractalMode attribute\n");
+    stat = attributeAffects(SkNoiseDeformer::fractalMode, SkNoiseDeformer::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from fractalMode to outputGeom");
+
     //locatorWorldSpace attr
     locatorWorldSpace = mAttr.create("locatorWorldSpace", "locsp", MFnMatrixAttribute::kDouble, &stat);
     CHECK_ERROR(stat, "Unable to create locatorWorldSpace attribute\n");
@@ -67,6 +67,11 @@
  * 5) Move/rotate/scale the accessory locator to transform the noise space, as
  * desired
  *
+ * 6) Set fractalMode to change how the octaves are summed: fBm (the default),
+ * Turbulence (absolute values, so the noise only pushes outwards), Billow
+ * (rounded lumps) or Ridged (ridged multifractal, sharp crests with smooth
+ * valleys, good for rocks). Every mode runs as fast as plain fBm.
+ *
  * ---------Credits-------------
  *
  * This plugin uses the noise library from Casey Duncan:
@@ -105,6 +110,7 @@ public:
     static MObject octaves;
     static MObject lacunarity;
     static MObject persistence;
+    static MObject fractalMode;
     static MObject locatorWorldSpace;
 
 };
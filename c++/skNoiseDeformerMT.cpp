@@ -68,6 +68,178 @@
  * 5) Move/rotate/scale the accessory locator to transform the noise space, as
  * desired
  *
+ * 6) On dense meshes, set lodMode to Interactive so that the deformer uses a
+ * cheaper approximation (reduced octaves or a baked noise grid, chosen with
+ * lodMethod) while the locator or the noise attributes are being dragged. A
+ * geometry counts as being manipulated while it is evaluated again at the
+ * same time within a quarter of a second of its last evaluation, so single
+ * channel box edits, frame steps, playblasts and renders stay exact. The exact
+ * result is computed again once the mouse is released, or once the geometry
+ * has not been evaluated for a quarter of a second, so an approximation never
+ * stays on screen.
+ *
+ * 7) To limit the noise to a region, set falloffShape to Sphere or Box. The
+ * volume is centered on the accessory locator and follows its transform, with
+ * falloffRadius as the sphere radius or the box half-size, and
+ * falloffSmoothness as the fraction of it over which the noise fades out.
+ * Points outside the volume are skipped without evaluating any noise.
+ *
+ * 8) On meshes whose vertex order is spatially random (e.g. scans or merged
+ * meshes), turn on spatialReorder so that the points are evaluated in Z-order
+ * (Morton order) instead. Each task then works on a spatially compact set of
+ * points, which is kinder to the caches. The order is computed once and reused
+ * as long as the number of points does not change. Gathering the points into
+ * that order and scattering them back has a cost of its own, which is not
+ * repaid when all the points fit into the caches anyway, so compare both
+ * settings with "skNoiseBench -order" on the target machine first.
+ *
+ * 9) latticeCacheOctaves sets how many of the lowest octaves look up their
+ * lattice gradients through a small per-task cache. Dense meshes revisit the
+ * same lattice cells a lot at those octaves, especially with spatialReorder
+ * on. The results are the same whatever the value, so it can be set to 0 if it
+ * does not help on a particular mesh.
+ *
+ * 10) Turn on asyncPlayback to overlap the noise evaluation with the rest of
+ * the scene during playback. While frame N is being shown, frame N+1 (in the
+ * direction of playback) is computed on background threads from the inputs of
+ * frame N and the noise attributes at frame N+1, which are read when the time
+ * changes to frame N, before it is evaluated. It is used only if a 64-bit
+ * hash of the inputs at frame N+1 matches the one it was computed from,
+ * otherwise the frame is computed synchronously as usual. A changed input
+ * could only go unnoticed through a hash collision, which is practically
+ * impossible, but asyncPlayback is still best left off for final renders.
+ *
+ * 11) Set frameCache to keep the noise displacements of every evaluated frame
+ * in memory, up to frameCacheBudget MB, so that frames that are played again
+ * with the same inputs skip the noise evaluation. Float keeps the full
+ * precision, while Half (fp16) and Fixed 16 use half the memory. The largest
+ * error of the cached displacements, relative to the amplitude, is shown in
+ * frameCacheError. The cache is not used when reproducible is on.
+ *
+ * 12) With incrementalUpdate on, the deformer keeps the displacements of its
+ * last full evaluation. When only the envelope, the amplitude or the weights
+ * change afterwards (e.g. while painting weights or dragging the envelope),
+ * the displacements are rescaled instead of evaluating the noise again. It is
+ * off by default, since while it is on every evaluation also hashes the input
+ * points with the other noise inputs and every full one copies them, which
+ * costs more than it saves during playback. Under the evaluation manager, the
+ * hash is skipped when only those scaling inputs are dirty. evalPath shows how
+ * the last result was obtained: Pass Through, Reuse (nothing that matters
+ * changed), Rescale, Frame Cache, Async or Full. Incremental updates are not
+ * used when reproducible is on.
+ *
+ * 13) For seamless loops, turn on tileable. The noise then repeats every
+ * tilePeriod units of noise space along each axis (0 for an axis that should
+ * not repeat), and over time every loopFrames frames (0 for no time loop).
+ * loopPeriod sets how far the noise travels along its time axis during one
+ * loop, so larger values change it faster. The loop follows the time
+ * attribute, so a retimed time connection retimes the loop as well. The time
+ * attribute is connected to time1.outTime while tileable is on and loopFrames
+ * is above 0, and disconnected again otherwise, so deformers that do not loop
+ * are not evaluated on every frame. The tileable noise is gradient
+ * noise on a cubic lattice rather than simplex noise, since only the former
+ * can repeat along the axes, so it looks slightly different.
+ *
+ * 14) Set fractalMode to change how the octaves are summed: fBm (the
+ * default), Turbulence (absolute values, so the noise only pushes outwards),
+ * Billow (rounded lumps) or Ridged (ridged multifractal, sharp crests with
+ * smooth valleys, good for rocks). Every mode runs as fast as plain fBm.
+ *
+ * 15) To warp the noise, set warpAmount to a non-zero value. The noise space
+ * position is then moved by warpAmount times three more fBm channels of
+ * warpOctaves octaves, sampled at warpFrequency times the noise frequency,
+ * before the noise is looked up. This gives swirly, organic shapes that
+ * stacking two deformers cannot give, since the second one would move the
+ * points rather than the noise space. The warp is ignored when tileable is on.
+ *
+ * 16) Set noiseType to Worley F1, Worley F2 or Worley F2-F1 to displace with
+ * cellular noise instead of simplex noise, which gives cell, scale and
+ * cracked-earth patterns. F1 and F2 are the distances to the nearest and the
+ * second nearest random feature points, and F2-F1 is close to 0 along the
+ * borders between the cells. Octaves, fractalMode and the warp apply to it as
+ * well. Each task keeps the feature points around the cells it last visited,
+ * so it is cheapest on spatially coherent points (see spatialReorder). The
+ * cellular noise is not tileable and is never baked into the LOD grid.
+ *
+ * 17) The deformer works with Maya's cached playback (Maya 2019 and later)
+ * and the parallel evaluation manager (Maya 2016 and later). Evaluations in
+ * the background fill of the cache always take the exact path: no LOD, async
+ * prediction, incremental update or frame cache. They also use their own
+ * scratch memory, so that they can run while the deformer is used in the
+ * foreground. Their results depend on nothing but the inputs at the evaluated
+ * time. With the evaluation manager, the deformer also uses the list of dirty
+ * plugs to skip checking the noise inputs when only the envelope, the
+ * amplitude or the weights have changed.
+ *
+ * 18) To get noise values without deforming a mesh (e.g. for scatter or
+ * placement tools), use the skNoiseEval command. It takes the query positions
+ * as a flat list of x y z values, followed or preceded by the noise
+ * parameters as flags, and returns a flat list of the three noise channels of
+ * every position, evaluated in parallel:
+ *
+ *     skNoiseEval -frequency 1 1 1 -octaves 4 0 0 0 1.5 0.25 -3;
+ *
+ * The flags are -frequency (-f), -offset (-o), -octaves (-oc), -persistence
+ * (-p), -lacunarity (-l), -fractalMode (-fm), -noiseType (-nty), -warpAmount
+ * (-wpa), -warpFrequency (-wpf), -warpOctaves (-wpo) and -numTasks (-nt),
+ * with the same meaning and defaults as the deformer attributes. The values
+ * match the ones the deformer computes for the same locator space positions,
+ * before they are scaled by the amplitude.
+ *
+ * 19) To vary the noise over the surface, paint the ampMap and freqMap
+ * attributes with the Paint Attributes Tool, or set ampColorSet and
+ * freqColorSet to the names of color sets on the input mesh, whose red
+ * channel is then used instead. The displacement of every vertex is scaled
+ * by its ampMap value and its noise frequency by its freqMap value. Vertices
+ * without a value are not scaled. The maps are only read again after they
+ * have changed, or after the input mesh has changed if color sets are used.
+ *
+ * 20) To see how the work is spread over the threads, set traceFile to a
+ * base path such as /tmp/skNoise. Every traceEvaluations evaluations, a
+ * timeline of them is written to the next numbered file (/tmp/skNoise.0.json,
+ * /tmp/skNoise.1.json, ...). Open it in chrome://tracing or Perfetto. It
+ * shows when each task started and finished on each thread, how long the
+ * parallel region took around them, and the preparation and write-back steps
+ * of every geometry. Clear traceFile to stop tracing.
+ *
+ * 21) Turn autoTasks on to use numTasks only as the starting point. The
+ * deformer then times every full evaluation and adjusts the number of tasks
+ * until the throughput stops improving, which takes about ten frames. It
+ * learns a separate count for every power of two of the number of points.
+ * tunedTasks shows the count of the last evaluation. The learned counts are
+ * kept by the node rather than computed, are saved with the scene and are
+ * reused on machines with the same number of processors. autoTasks is off by
+ * default, so the timings never change the task count unless asked to.
+ *
+ * 22) To render with motion blur, set motionBlurSamples to the number of
+ * time samples per frame of the renderer and motionBlurShutter to its
+ * shutter length in frames, centred on the frame. Then run, e.g. from a pre
+ * render frame script:
+ *
+ *     skNoiseMotionBlur -index 0 skNoiseDeformer1;
+ *
+ * It deforms every sample of the current frame of the geometry at that index
+ * in one pass over the points, which reads every point and weight only once
+ * and, if the locator does not move, transforms it only once. It returns the
+ * deformed points of the samples, one after the other, as a flat list of
+ * x y z values in object space. The sub-frame evaluations of the renderer at
+ * the sample times are then served from that pass. evalPath shows Motion Blur
+ * for them. Whole frame and background evaluations are always computed as
+ * usual. Since every sample is deformed from the same input points, the
+ * command only takes mesh inputs and fails if the input mesh changes over
+ * the shutter (e.g. an animated or skinned mesh). Deform such meshes at every
+ * sample time as usual. Leave motionBlurSamples at 1 otherwise.
+ *
+ * 23) numaAware (off by default) is experimental. On machines with more than
+ * one NUMA node, it pins every task to the node that owns its range of points
+ * and runs the noise phase out of a working buffer allocated on that node.
+ * The points are still read from and written back to the arrays of the mesh,
+ * wherever Maya allocated them, and every point is copied twice more, so
+ * whether it helps depends on the machine. Time it (e.g. with traceFile)
+ * before leaving it on. "skNoiseBench -numa" runs both ways outside of Maya
+ * and, where the kernel exposes the counters, prints how many loads were
+ * served by the memory of another node (see skNoiseBench.cpp).
+ *
  * ---------Credits-------------
  *
  * This plugin uses the noise library from Casey Duncan:
@@ -80,35 +252,87 @@
  *
  */
 
+#include <cfloat>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#if defined(LINUX) || defined(LINUX_64)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
 
 #include <maya/MFnPlugin.h>
 #include <maya/MTypeId.h>
 #include <maya/MGlobal.h>
 
 #include <maya/MPxDeformerNode.h>
+#include <maya/MPxCommand.h>
+#include <maya/MArgList.h>
 #include <maya/MItGeometry.h>
 #include <maya/MDataBlock.h>
 #include <maya/MDataHandle.h>
 #include <maya/MPlug.h>
+#include <maya/MArrayDataHandle.h>
 
 #include <maya/MFnNumericAttribute.h>
 #include <maya/MFnNumericData.h>
 #include <maya/MFnMatrixAttribute.h>
+#include <maya/MFnEnumAttribute.h>
+#include <maya/MFnUnitAttribute.h>
+#include <maya/MFnTypedAttribute.h>
+#include <maya/MFnCompoundAttribute.h>
+#include <maya/MFnDoubleArrayData.h>
+#include <maya/MFnIntArrayData.h>
+#include <maya/MFnMesh.h>
 
 #include <maya/MPoint.h>
 #include <maya/MPointArray.h>
 #include <maya/MMatrix.h>
 #include <maya/MFloatArray.h>
+#include <maya/MDoubleArray.h>
+#include <maya/MIntArray.h>
+#include <maya/MColorArray.h>
+#include <maya/MPlugArray.h>
 
 #include <maya/MDagModifier.h>
 #include <maya/MDagPath.h>
 #include <maya/MFnDagNode.h>
 #include <maya/MFnDependencyNode.h>
+#include <maya/MSelectionList.h>
+#include <maya/MFnMatrixData.h>
 
 #include <maya/MThreadPool.h>
+#include <maya/MThreadAsync.h>
+#include <maya/MAtomic.h>
+
+#include <maya/MEventMessage.h>
+#include <maya/MDGMessage.h>
+#include <maya/MTimerMessage.h>
+#include <maya/MNodeMessage.h>
+#include <maya/MFileIO.h>
+#include <maya/MAnimControl.h>
+#include <maya/MDGContext.h>
+#include <maya/MTypes.h>
 
-#include "libnoise/_simplex.c"
+#if MAYA_API_VERSION >= 201600
+#include <maya/MEvaluationNode.h>
+#endif
+#if MAYA_API_VERSION >= 20200000
+#include <maya/MNodeCacheSetupInfo.h>
+#include <maya/MNodeCacheDisablingInfo.h>
+#include <maya/MObjectArray.h>
+#endif
+
+#include "skNoiseKernels.h"
+#include "skDisplacementCodec.h"
+#include "skParallel.h"
+#include "skTrace.h"
 
 #include "skNoiseDeformerMT.h"
 
@@ -133,232 +357,3693 @@ MTypeId SkNoiseDeformerMT::nodeId(0x001212C2); //unique id obtained from ADN
 
 const float EPSILON = 0.0000001;
 
+//values of the lodMode attribute
+enum LodMode
+{
+    LOD_MODE_OFF = 0,
+    LOD_MODE_INTERACTIVE
+};
+
+//values of the lodMethod attribute
+enum LodMethod
+{
+    LOD_METHOD_REDUCED_OCTAVES = 0,
+    LOD_METHOD_BAKED_GRID
+};
+
+//values of the falloffShape attribute
+enum FalloffShape
+{
+    FALLOFF_SHAPE_NONE = 0,
+    FALLOFF_SHAPE_SPHERE,
+    FALLOFF_SHAPE_BOX
+};
+
+//values of the frameCache attribute
+enum FrameCacheFormat
+{
+    FRAME_CACHE_OFF = 0,
+    FRAME_CACHE_FLOAT,
+    FRAME_CACHE_HALF,
+    FRAME_CACHE_FIXED16
+};
+
+//values of the evalPath attribute, from the cheapest to the most expensive way to get a result
+enum EvalPath
+{
+    EVAL_PATH_PASS_THROUGH = 0,
+    EVAL_PATH_REUSE,
+    EVAL_PATH_RESCALE,
+    EVAL_PATH_FRAME_CACHE,
+    EVAL_PATH_ASYNC,
+    EVAL_PATH_MOTION_BLUR,
+    EVAL_PATH_FULL
+};
+
+//number of consecutive points that are culled together against the falloff volume
+const int FALLOFF_CULL_BLOCK_SIZE = 256;
+
+//the task count is tuned separately for every power of two of the number of points
+const int TASK_TUNER_CLASSES = 32;
+const int TASK_TUNER_MAX_TASKS = 1024;
+
+//smallest gain in throughput that counts as an improvement, so that timing noise does not move
+//the count, and the step at which the search stops
+const double TASK_TUNER_TOLERANCE = 0.03;
+const double TASK_TUNER_MIN_STEP = 1.15;
+
+//most time samples of one motion blur batch, and how close (in frames) the time of an evaluation
+//has to be to a sample time to be served from the batch
+const int MOTION_BLUR_MAX_SAMPLES = 16;
+const double MOTION_BLUR_TIME_TOLERANCE = 1.0e-3;
+
+//an evaluation that follows the last one of a geometry at the same time within this many
+//microseconds is taken as part of a manipulation, and a LOD result that has been left alone for
+//as long is refined. The timer that refines them fires at the same interval (in seconds).
+const double LOD_INTERACTION_INTERVAL = 250000.0;
+const float LOD_REFRESH_PERIOD = 0.25f;
+
+//baked grid of the three noise channels, sampled over the noise space bounds of the points
 typedef struct
 {
-    int start;
-    int end;
+    MFloatArray values;
+    float *data;
+    int res;
+    float min[3];
+    float invCellSize[3];
+} LodGrid;
+
+//attribute values that are the same for every geometry in one evaluation
+struct EvalSettings
+{
+    float env;
+    int numTasks;
+    bool numaAware;
+    float *amps;
+    float *freqs;
+    float *offsets;
+    int octaves;
+    float lacunarity;
+    float persistence;
+    short noiseType;
+    short fractalMode;
+    DomainWarp warp;
+    MString ampColorSet;
+    MString freqColorSet;
+    MMatrix locatorWorldSpaceMat;
+    bool useLod;
+    short lodMethod;
+    int lodOctaves;
+    int lodGridResolution;
+    short falloffShape;
+    float falloffRadius;
+    float falloffSmoothness;
+    bool tileable;
+    int tilePeriods[3];
+    int loopFrames;
+    int loopPeriod;
+    MTime loopTime;
+    bool spatialReorder;
+    int latticeCacheOctaves;
+    bool asyncPlayback;
+    MTime time;
+    short frameCache;
+    float frameCacheBudget;
+    bool incrementalUpdate;
+    bool background;
+    int motionBlurSamples;
+    double motionBlurShutter;
+    MString traceFile;
+    int traceEvaluations;
+    TraceSession *trace;
+    TaskTuner *taskTuner;
+};
+
+//data of one geometry, shared by all the tasks working on it
+struct SharedData
+{
     MPointArray *points;
     MFloatArray *weights;
     float env;
-    int width;
-    int numTasks;
     float *amps;
     float *freqs;
     float *offsets;
     int octaves;
     float lacunarity;
     float persistence;
-    MMatrix *localToLocatorSpaceMat;
-    MMatrix *locatorToLocalSpaceMat;
-} SharedData;
+    short noiseType;
+    short fractalMode;
+    DomainWarp warp;
+    MMatrix localToLocatorSpaceMat;
+    MMatrix locatorToLocalSpaceMat;
+    LodGrid *lodGrid;
+    NoiseKernel noiseKernel;
+    PeriodicNoiseKernel periodicNoiseKernel;
+    WorleyNoiseKernel worleyNoiseKernel;
+    int numNumaNodes;
+    short falloffShape;
+    float falloffRadius;
+    float falloffInnerRadius;
+    double falloffLocalMin[3];
+    double falloffLocalMax[3];
+    const unsigned int *order;
+    MPointArray *unorderedPoints;
+    const float *freqScales;
+    const float *meshFreqScales;
+    int latticeCacheOctaves;
+    bool tileable;
+    int tilePeriods[4];
+    float loopPosition;
+    TraceSession *trace;
+};
 
 typedef struct
 {
     int id;
+    int start;
+    int end;
+    int numaNode;
     SharedData *sharedData;
+    double *work;
+    int workCapacity;
+    LatticeCache *latticeCache;
+    WorleyCache *worleyCache;
 } ThreadData;
 
+//list of tasks to run in one parallel region
+typedef struct
+{
+    ThreadData *threadData;
+    int numTasks;
+} TaskList;
+
+//per-geometry scratch memory, kept across evaluations and grown to the high-water mark so that
+//steady-state playback does not go through the heap
+struct ScratchArena
+{
+    MPointArray points;
+    MFloatArray weights;
+    std::vector<unsigned int> order;
+    MPointArray orderedPoints;
+    MPointArray inputPoints;
+    MFloatArray orderedWeights;
+    LodGrid lodGrid;
+    ThreadData *threadData;
+    int threadDataCapacity;
+
+    //per-vertex amplitude and frequency scales in the same order as the points, empty if there is
+    //no map. They are only gathered again once their sources have been dirtied.
+    std::vector<int> vertexIds;
+    std::vector<float> ampScales;
+    std::vector<float> freqScales;
+    std::vector<float> orderedFreqScales;
+    bool vertexMapsValid;
+    unsigned int vertexMapGeneration;
+
+    //inputs and locator space displacements of the last full evaluation, which later evaluations
+    //that only change the envelope, the amplitude or the weights rescale
+    bool lastValid;
+    MUint64 lastNoiseSignature;
+    float lastEnv;
+    float lastAmps[3];
+    MFloatArray lastWeights;
+    std::vector<float> lastDisplacements;
+
+    //manipulation state of the geometry: whether its last result is a LOD approximation, whether
+    //the next evaluation has to be exact, and the time and end of its last evaluation
+    bool lodActive;
+    bool exactPending;
+    MTime lastEvalTime;
+    double lastEvalEnd;
+
+    ScratchArena()
+        : threadData(NULL),
+          threadDataCapacity(0),
+          vertexMapsValid(false),
+          vertexMapGeneration(0),
+          lastValid(false),
+          lodActive(false),
+          exactPending(false),
+          lastEvalEnd(0.0)
+    {
+    }
+
+    ~ScratchArena()
+    {
+        releaseThreadData();
+    }
+
+    //returns thread data for the given number of tasks, reallocating only when it grows
+    ThreadData* reserveThreadData(int numTasks)
+    {
+        if (numTasks > threadDataCapacity)
+        {
+            releaseThreadData();
+            threadData = new ThreadData[numTasks];
+            threadDataCapacity = numTasks;
+            int i;
+            for (i = 0; i < numTasks; ++i)
+            {
+                threadData[i].work = NULL;
+                threadData[i].latticeCache = NULL;
+                threadData[i].worleyCache = NULL;
+                threadData[i].workCapacity = 0;
+            }
+        }
+        return threadData;
+    }
+
+    void releaseThreadData()
+    {
+        int i;
+        for (i = 0; i < threadDataCapacity; ++i)
+        {
+            free(threadData[i].work);
+            free(threadData[i].latticeCache);
+            free(threadData[i].worleyCache);
+        }
+        delete [] threadData;
+        threadData = NULL;
+        threadDataCapacity = 0;
+    }
+
+    void releaseLastResult()
+    {
+        lastValid = false;
+        lastWeights.clear();
+        std::vector<float>().swap(lastDisplacements);
+    }
+
+    //returns the number of bytes held by this arena
+    double memoryUsage() const
+    {
+        double bytes = points.length() * sizeof(MPoint)
+                       + weights.length() * sizeof(float)
+                       + order.capacity() * sizeof(unsigned int)
+                       + orderedPoints.length() * sizeof(MPoint)
+                       + inputPoints.length() * sizeof(MPoint)
+                       + orderedWeights.length() * sizeof(float)
+                       + lodGrid.values.length() * sizeof(float)
+                       + vertexIds.capacity() * sizeof(int)
+                       + (ampScales.capacity() + freqScales.capacity() + orderedFreqScales.capacity()) * sizeof(float)
+                       + lastWeights.length() * sizeof(float)
+                       + lastDisplacements.capacity() * sizeof(float)
+                       + threadDataCapacity * sizeof(ThreadData);
+        int i;
+        for (i = 0; i < threadDataCapacity; ++i)
+        {
+            bytes += 4.0 * threadData[i].workCapacity * sizeof(double);
+            bytes += threadData[i].latticeCache ? sizeof(LatticeCache) : 0;
+            bytes += threadData[i].worleyCache ? sizeof(WorleyCache) : 0;
+        }
+        return bytes;
+    }
+
+private:
+    ScratchArena(const ScratchArena&);
+    ScratchArena& operator=(const ScratchArena&);
+};
+
+//one buffer of a geometry that is evaluated in the background. pending is only changed through
+//MAtomic, and the task that brings it to zero signals done so that waiting threads can sleep.
+struct AsyncSlot
+{
+    ScratchArena arena;
+    SharedData sharedData;
+    float values[9];
+    MTime time;
+    MUint64 signature;
+    volatile int pending;
+    bool valid;
+#if defined(LINUX) || defined(LINUX_64)
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+#endif
+
+    AsyncSlot()
+        : pending(0),
+          valid(false)
+    {
+#if defined(LINUX) || defined(LINUX_64)
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&done, NULL);
+#endif
+    }
+
+    ~AsyncSlot()
+    {
+#if defined(LINUX) || defined(LINUX_64)
+        pthread_cond_destroy(&done);
+        pthread_mutex_destroy(&mutex);
+#endif
+    }
+
+private:
+    AsyncSlot(const AsyncSlot&);
+    AsyncSlot& operator=(const AsyncSlot&);
+};
+
+//double-buffered background results of one geometry. The result of the current frame is taken
+//from one slot while the other one is being filled for the predicted next frame.
+struct AsyncGeometry
+{
+    AsyncSlot slots[2];
+};
+
+//times and attribute values of the frame that is predicted to be evaluated next
+struct AsyncFrame
+{
+    bool active;
+    MTime time;
+    MTime nextTime;
+    EvalSettings nextSettings;
+    float nextValues[9];
+};
+
+//locator space displacements of one geometry at one frame, in one of the frame cache formats
+struct CachedFrame
+{
+    MUint64 signature;
+    short format;
+    int numValues;
+    float scales[3];
+    std::vector<float> floats;
+    std::vector<unsigned short> halves;
+    std::vector<short> codes;
+
+    double memoryUsage() const
+    {
+        return floats.capacity() * sizeof(float)
+               + halves.capacity() * sizeof(unsigned short)
+               + codes.capacity() * sizeof(short);
+    }
+};
+
+//cached frames of all geometries, keyed by multi index and time. The oldest frames are evicted
+//first once the memory budget is exceeded.
+struct FrameCache
+{
+    typedef std::pair<unsigned int, double> Key;
+
+    std::map<Key, CachedFrame*> frames;
+    std::deque<Key> insertionOrder;
+    double bytes;
+    float maxRelativeError;
+    std::vector<float> displacements;
+    std::vector<float> decoded;
+
+    FrameCache()
+        : bytes(0.0),
+          maxRelativeError(0.0f)
+    {
+    }
+
+    ~FrameCache()
+    {
+        std::map<Key, CachedFrame*>::iterator it;
+        for (it = frames.begin(); it != frames.end(); ++it)
+        {
+            delete it->second;
+        }
+    }
+};
+
+//deformed points of one geometry at one time sample of a motion blur batch
+struct MotionBlurSample
+{
+    MTime time;
+    SharedData sharedData;
+    float values[9];
+    MUint64 signature;
+    MPointArray points;
+};
+
+//time samples of one frame of a geometry that are deformed together in a single pass over its
+//points. The points, weights and frequency scales are the same for all samples, so every task
+//reads them once per point, and transforms the point once if the locator and falloff are static.
+//The inputs and settings of the last evaluation of the geometry are kept next to the batch, so
+//that skNoiseMotionBlur can build it outside of compute.
+struct MotionBlurGeometry
+{
+    ScratchArena arena;
+    MotionBlurSample samples[MOTION_BLUR_MAX_SAMPLES];
+    int numSamples;
+    double frame;
+    double shutter;
+    bool staticTransform;
+    bool inputsValid;
+    MPointArray inputPoints;
+    MFloatArray inputWeights;
+    std::vector<float> inputFreqScales;
+    MMatrix localToWorldMat;
+    EvalSettings settings;
+
+    MotionBlurGeometry()
+        : numSamples(0),
+          frame(0.0),
+          shutter(0.0),
+          staticTransform(false),
+          inputsValid(false)
+    {
+    }
+
+    //returns the number of bytes held by this batch
+    double memoryUsage() const
+    {
+        double bytes = arena.memoryUsage();
+        bytes += inputPoints.length() * sizeof(MPoint) + inputWeights.length() * sizeof(float) + inputFreqScales.size() * sizeof(float);
+        int i;
+        for (i = 0; i < MOTION_BLUR_MAX_SAMPLES; ++i)
+        {
+            bytes += samples[i].points.length() * sizeof(MPoint);
+        }
+        return bytes;
+    }
+};
+
+//time samples of the current frame that skNoiseMotionBlur asks to deform, with the attribute values
+//that it has read at every sample time
+struct MotionBlurRequest
+{
+    double frame;
+    int numSamples;
+    double shutter;
+    EvalSettings settings[MOTION_BLUR_MAX_SAMPLES];
+    float values[MOTION_BLUR_MAX_SAMPLES][9];
+};
+
+//path taken to get the result of one geometry in one evaluation
+struct GeometryEval
+{
+    short path;
+    AsyncSlot *resultSlot;
+    AsyncSlot *stagedSlot;
+    MPointArray *motionBlurPoints;
+    MUint64 noiseSignature;
+    MUint64 signature;
+};
+
+//one geometry of a batched evaluation
+typedef struct
+{
+    unsigned int multiIndex;
+    unsigned int groupId;
+    SharedData sharedData;
+    GeometryEval eval;
+} BatchGeometry;
+
+//scratch memory for batched evaluations of all geometries
+struct BatchArena
+{
+    std::vector<BatchGeometry> geometries;
+    ScratchArena tasks;
+};
+
+//hill climb over the task count of one size class of geometries. Every full evaluation measures
+//the throughput of the count it used. The search keeps stepping in the direction that improves
+//it, turns around once, and then halves the step (in log space) until it is too small to matter.
+struct TaskTunerClass
+{
+    int numTasks;
+    int bestTasks;
+    double bestRate;
+    double step;
+    int direction;
+    bool reversed;
+    bool warmUp;
+    bool settled;
+
+    //starts the search at the given count, or takes a count that was learned before
+    void reset(int initialTasks, bool learned)
+    {
+        numTasks = bestTasks = std::max(1, std::min(initialTasks, TASK_TUNER_MAX_TASKS));
+        bestRate = 0.0;
+        step = 2.0;
+        direction = 1;
+        reversed = false;
+        warmUp = !learned;
+        settled = learned;
+    }
+
+    //takes the throughput (points per microsecond) of the current count and moves to the next one
+    void update(double rate)
+    {
+        //the first evaluation also allocates the scratch memory, so it is measured again
+        if (settled || warmUp)
+        {
+            warmUp = false;
+            return;
+        }
+
+        //stepping back from an improvement leads to a count that is known to be worse
+        if (rate > bestRate * (1.0 + TASK_TUNER_TOLERANCE))
+        {
+            reversed = bestRate > 0.0;
+            bestRate = rate;
+            bestTasks = numTasks;
+        }
+        else
+        {
+            turn();
+        }
+
+        //turn again if the next count would go out of range
+        for (;;)
+        {
+            if (settled)
+            {
+                numTasks = bestTasks;
+                return;
+            }
+            numTasks = direction > 0
+                       ? std::min(std::max(bestTasks + 1, static_cast<int>(bestTasks * step + 0.5)), TASK_TUNER_MAX_TASKS)
+                       : std::max(std::min(bestTasks - 1, static_cast<int>(bestTasks / step + 0.5)), 1);
+            if (numTasks != bestTasks)
+            {
+                return;
+            }
+            turn();
+        }
+    }
+
+    //tries the other direction, or a smaller step once both directions have been tried
+    void turn()
+    {
+        if (!reversed)
+        {
+            reversed = true;
+            direction = -direction;
+            return;
+        }
+        step = std::sqrt(step);
+        settled = step < TASK_TUNER_MIN_STEP;
+        reversed = false;
+        direction = 1;
+    }
+};
+
+//returns the number of processors that are online, or 0 if it is not known
+static int processorCount()
+{
+#if defined(LINUX) || defined(LINUX_64)
+    return static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+#else
+    return 0;
+#endif
+}
+
+//task counts learned for every size class of geometries
+struct TaskTuner
+{
+    TaskTunerClass classes[TASK_TUNER_CLASSES];
+    bool used[TASK_TUNER_CLASSES];
+    int lastTasks;
+
+    TaskTuner()
+        : lastTasks(0)
+    {
+        memset(used, 0, sizeof(used));
+    }
+
+    //starts from the given learned counts, if they were learned with the same number of processors
+    void seed(const MIntArray& learned)
+    {
+        if (1 + TASK_TUNER_CLASSES != learned.length() || processorCount() != learned[0])
+        {
+            return;
+        }
+        int i;
+        for (i = 0; i < TASK_TUNER_CLASSES; ++i)
+        {
+            if (learned[1 + i] > 0)
+            {
+                classes[i].reset(learned[1 + i], true);
+                used[i] = true;
+            }
+        }
+    }
+
+    //returns the processor count followed by the settled count of every size class (0 if unsettled)
+    MIntArray learned() const
+    {
+        MIntArray learned;
+        learned.append(processorCount());
+        int i;
+        for (i = 0; i < TASK_TUNER_CLASSES; ++i)
+        {
+            learned.append(used[i] && classes[i].settled ? classes[i].bestTasks : 0);
+        }
+        return learned;
+    }
+
+    static int sizeClass(int numPoints)
+    {
+        int sizeClass = 0;
+        while ((numPoints >>= 1) > 0 && sizeClass < TASK_TUNER_CLASSES - 1)
+        {
+            ++sizeClass;
+        }
+        return sizeClass;
+    }
+
+    //returns the task count to use for the given number of points, starting the search of its size
+    //class at initialTasks
+    int numTasks(int numPoints, int initialTasks)
+    {
+        const int i = sizeClass(numPoints);
+        if (!used[i])
+        {
+            classes[i].reset(initialTasks, false);
+            used[i] = true;
+        }
+        lastTasks = classes[i].numTasks;
+        return lastTasks;
+    }
+
+    //takes the time in microseconds that the given number of points took with the given count
+    void record(int numPoints, int numTasks, double microseconds)
+    {
+        TaskTunerClass &tunerClass = classes[sizeClass(numPoints)];
+        if (numTasks != tunerClass.numTasks || tunerClass.settled)
+        {
+            return;
+        }
+        tunerClass.update(numPoints / std::max(microseconds, 1.0));
+    }
+};
+
 MObject SkNoiseDeformerMT::numTasks;
+MObject SkNoiseDeformerMT::autoTasks;
+MObject SkNoiseDeformerMT::tunedTasks;
+MObject SkNoiseDeformerMT::learnedTasks;
+MObject SkNoiseDeformerMT::numaAware;
+MObject SkNoiseDeformerMT::batchGeometries;
 MObject SkNoiseDeformerMT::amp;
 MObject SkNoiseDeformerMT::freq;
 MObject SkNoiseDeformerMT::offset;
 MObject SkNoiseDeformerMT::octaves;
 MObject SkNoiseDeformerMT::lacunarity;
 MObject SkNoiseDeformerMT::persistence;
+MObject SkNoiseDeformerMT::noiseType;
+MObject SkNoiseDeformerMT::fractalMode;
+MObject SkNoiseDeformerMT::warpAmount;
+MObject SkNoiseDeformerMT::warpFrequency;
+MObject SkNoiseDeformerMT::warpOctaves;
+MObject SkNoiseDeformerMT::vertexMapList;
+MObject SkNoiseDeformerMT::ampMap;
+MObject SkNoiseDeformerMT::freqMap;
+MObject SkNoiseDeformerMT::ampColorSet;
+MObject SkNoiseDeformerMT::freqColorSet;
 MObject SkNoiseDeformerMT::locatorWorldSpace;
+MObject SkNoiseDeformerMT::reproducible;
+MObject SkNoiseDeformerMT::lodMode;
+MObject SkNoiseDeformerMT::lodMethod;
+MObject SkNoiseDeformerMT::lodOctaves;
+MObject SkNoiseDeformerMT::lodGridResolution;
+MObject SkNoiseDeformerMT::lodRefresh;
+MObject SkNoiseDeformerMT::scratchMemory;
+MObject SkNoiseDeformerMT::falloffShape;
+MObject SkNoiseDeformerMT::falloffRadius;
+MObject SkNoiseDeformerMT::falloffSmoothness;
+MObject SkNoiseDeformerMT::tileable;
+MObject SkNoiseDeformerMT::tilePeriod;
+MObject SkNoiseDeformerMT::loopFrames;
+MObject SkNoiseDeformerMT::loopPeriod;
+MObject SkNoiseDeformerMT::time;
+MObject SkNoiseDeformerMT::spatialReorder;
+MObject SkNoiseDeformerMT::latticeCacheOctaves;
+MObject SkNoiseDeformerMT::asyncPlayback;
+MObject SkNoiseDeformerMT::frameCache;
+MObject SkNoiseDeformerMT::frameCacheBudget;
+MObject SkNoiseDeformerMT::frameCacheMemory;
+MObject SkNoiseDeformerMT::frameCacheError;
+MObject SkNoiseDeformerMT::incrementalUpdate;
+MObject SkNoiseDeformerMT::evalPath;
+MObject SkNoiseDeformerMT::motionBlurSamples;
+MObject SkNoiseDeformerMT::motionBlurShutter;
+MObject SkNoiseDeformerMT::traceFile;
+MObject SkNoiseDeformerMT::traceEvaluations;
+
+//waits for the background tasks of a slot to finish, sleeping until the last one signals
+static void waitForAsyncSlot(AsyncSlot *slot)
+{
+    //compareAndSwap() returns 1 only once pending is 0
+#if defined(LINUX) || defined(LINUX_64)
+    pthread_mutex_lock(&slot->mutex);
+    while (MAtomic::compareAndSwap(&slot->pending, 0, 0) == 0)
+    {
+        pthread_cond_wait(&slot->done, &slot->mutex);
+    }
+    pthread_mutex_unlock(&slot->mutex);
+#else
+    while (MAtomic::compareAndSwap(&slot->pending, 0, 0) == 0)
+    {
+    }
+#endif
+}
+
+//constructor
+SkNoiseDeformerMT::SkNoiseDeformerMT()
+    : m_dragReleaseCallbackId(0),
+      m_lodRefreshCallbackId(0),
+      m_attributeChangedCallbackId(0),
+      m_timeChangeCallbackId(0),
+      m_scaleInputsOnly(false),
+      m_vertexMapGeneration(0),
+      m_colorSetsUsed(false),
+      m_batchArena(NULL),
+      m_asyncInitialized(false),
+      m_frameCache(NULL),
+      m_trace(NULL),
+      m_taskTuner(NULL),
+      m_asyncPrediction(NULL)
+{
+    //init thread pool
+    cerr << "[" << nodeType << "] Initializing " << SK_PARALLEL_BACKEND_NAME << " thread pool" << endl;
+    if (!parallelInit())
+    {
+        cerr << "[" << nodeType << "] Unable to create thread pool" << endl;
+    }
+}
+
+//destructor
+SkNoiseDeformerMT::~SkNoiseDeformerMT()
+{
+    //remove interaction and attribute callbacks
+    if (m_dragReleaseCallbackId)
+    {
+        MMessage::removeCallback(m_dragReleaseCallbackId);
+    }
+    if (m_lodRefreshCallbackId)
+    {
+        MMessage::removeCallback(m_lodRefreshCallbackId);
+    }
+    if (m_attributeChangedCallbackId)
+    {
+        MMessage::removeCallback(m_attributeChangedCallbackId);
+    }
+    if (m_timeChangeCallbackId)
+    {
+        MMessage::removeCallback(m_timeChangeCallbackId);
+    }
+
+    //wait for background evaluations before releasing their memory
+    std::map<unsigned int, AsyncGeometry*>::iterator asyncIt;
+    for (asyncIt = m_asyncGeometries.begin(); asyncIt != m_asyncGeometries.end(); ++asyncIt)
+    {
+        waitForAsyncSlot(&asyncIt->second->slots[0]);
+        waitForAsyncSlot(&asyncIt->second->slots[1]);
+        delete asyncIt->second;
+    }
+    if (m_asyncInitialized)
+    {
+        MThreadAsync::release();
+    }
+
+    //release thread pool
+    cerr << "[" << nodeType << "] Releasing thread pool" << endl;
+    parallelRelease();
+
+    //release scratch memory
+    std::map<unsigned int, ScratchArena*>::iterator it;
+    for (it = m_scratchArenas.begin(); it != m_scratchArenas.end(); ++it)
+    {
+        delete it->second;
+    }
+    for (it = m_backgroundArenas.begin(); it != m_backgroundArenas.end(); ++it)
+    {
+        delete it->second;
+    }
+    std::map<unsigned int, MotionBlurGeometry*>::iterator motionBlurIt;
+    for (motionBlurIt = m_motionBlurGeometries.begin(); motionBlurIt != m_motionBlurGeometries.end(); ++motionBlurIt)
+    {
+        delete motionBlurIt->second;
+    }
+    delete m_batchArena;
+    delete m_frameCache;
+    delete m_trace;
+    delete m_taskTuner;
+    delete m_asyncPrediction;
+}
+
+//post constructor method
+void SkNoiseDeformerMT::postConstructor()
+{
+    //listen for mouse releases so that an approximate LOD result can be refined
+    MStatus stat;
+    m_dragReleaseCallbackId = MEventMessage::addEventCallback("DragRelease", dragReleaseCallback, this, &stat);
+    CHECK_ERROR_NO_RETURN(stat, "Unable to add DragRelease callback\n");
+
+    //check regularly for LOD results that are no longer being manipulated, e.g. after a channel box
+    //edit or a drag that ends without a DragRelease event
+    m_lodRefreshCallbackId = MTimerMessage::addTimerCallback(LOD_REFRESH_PERIOD, lodRefreshCallback, this, &stat);
+    CHECK_ERROR_NO_RETURN(stat, "Unable to add LOD refresh timer callback\n");
+
+    //listen for changes to tileable and loopFrames so that the time is only connected while looping
+    MObject thisObj = thisMObject();
+    m_attributeChangedCallbackId = MNodeMessage::addAttributeChangedCallback(thisObj, attributeChangedCallback, this, &stat);
+    CHECK_ERROR_NO_RETURN(stat, "Unable to add attribute changed callback\n");
+
+    //listen for time changes so that async playback can read the next frame outside of compute
+    m_timeChangeCallbackId = MDGMessage::addTimeChangeCallback(timeChangeCallback, this, &stat);
+    CHECK_ERROR_NO_RETURN(stat, "Unable to add time change callback\n");
+}
+
+//callback for the end of an interactive drag, refining every LOD result right away
+void SkNoiseDeformerMT::dragReleaseCallback(void* clientData)
+{
+    static_cast<SkNoiseDeformerMT*>(clientData)->refineLodResults(0.0);
+}
+
+//timer callback, refining the LOD results that have not been evaluated again for a while
+void SkNoiseDeformerMT::lodRefreshCallback(float elapsedTime, float lastTime, void* clientData)
+{
+    static_cast<SkNoiseDeformerMT*>(clientData)->refineLodResults(LOD_INTERACTION_INTERVAL);
+}
+
+//requests an exact evaluation of the geometries whose last result is a LOD approximation that is
+//at least minIdle microseconds old. The refresh attribute is dirtied rather than set, so that this
+//neither modifies the scene nor goes on the undo queue.
+void SkNoiseDeformerMT::refineLodResults(double minIdle)
+{
+    const double now = traceClock();
+    bool refine = false;
+    std::map<unsigned int, ScratchArena*>::iterator it;
+    for (it = m_scratchArenas.begin(); it != m_scratchArenas.end(); ++it)
+    {
+        ScratchArena *arena = it->second;
+        if (arena && arena->lodActive && now - arena->lastEvalEnd >= minIdle)
+        {
+            arena->lodActive = false;
+            arena->exactPending = true;
+            refine = true;
+        }
+    }
+    if (refine)
+    {
+        MFnDependencyNode thisFn(thisMObject());
+        MGlobal::executeCommand("dgdirty " + thisFn.name() + ".lodRefresh");
+    }
+}
+
+//callback for attribute changes, connecting time1.outTime to the time attribute while the noise
+//loops over time and disconnecting it otherwise, so that a deformer that does not loop is not
+//evaluated again on every frame. A time connection from any other node is left alone.
+void SkNoiseDeformerMT::attributeChangedCallback(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* clientData)
+{
+    //connections that are read from a file are kept as they were saved
+    if (!(msg & MNodeMessage::kAttributeSet) || MFileIO::isReadingFile())
+    {
+        return;
+    }
+    const MObject attr = plug.attribute();
+    if (attr != tileable && attr != loopFrames)
+    {
+        return;
+    }
+
+    SkNoiseDeformerMT *node = static_cast<SkNoiseDeformerMT*>(clientData);
+    MObject thisObj = node->thisMObject();
+    MFnDependencyNode thisFn(thisObj);
+    const bool looping = MPlug(thisObj, tileable).asBool() && MPlug(thisObj, loopFrames).asInt() > 0;
+
+    MPlugArray sources;
+    MPlug(thisObj, time).connectedTo(sources, true, false);
+    const bool connected = sources.length() > 0;
+    const bool connectedToTime1 = connected && MFnDependencyNode(sources[0].node()).name() == "time1";
+
+    //the connection is changed on idle since the graph should not be edited from within this callback
+    if (looping && !connected)
+    {
+        MGlobal::executeCommandOnIdle("connectAttr time1.outTime " + thisFn.name() + ".time");
+    }
+    else if (!looping && connectedToTime1)
+    {
+        MGlobal::executeCommandOnIdle("disconnectAttr time1.outTime " + thisFn.name() + ".time");
+    }
+}
+
+//callback for time changes. During async playback it predicts the next frame and reads the attribute
+//values at that time, which compute may not pull itself since that would evaluate other parts of the
+//graph in the middle of a (possibly parallel) evaluation. The callback runs on the main thread
+//before the frame is evaluated.
+void SkNoiseDeformerMT::timeChangeCallback(MTime& time, void* clientData)
+{
+    SkNoiseDeformerMT *node = static_cast<SkNoiseDeformerMT*>(clientData);
+    if (node->m_asyncPrediction)
+    {
+        node->m_asyncPrediction->active = false;
+    }
+    if (!MAnimControl::isPlaying() || !MPlug(node->thisMObject(), asyncPlayback).asBool())
+    {
+        return;
+    }
+
+    if (!node->m_asyncPrediction)
+    {
+        node->m_asyncPrediction = new AsyncFrame();
+    }
+    AsyncFrame *prediction = node->m_asyncPrediction;
+    prediction->time = time;
+    prediction->nextTime = node->predictNextTime(time);
+    MStatus stat = node->getEvalSettingsAtTime(prediction->nextTime, prediction->nextSettings, prediction->nextValues);
+    CHECK_ERROR_NO_RETURN(stat, "Unable to get attribute values of the next frame\n");
+    prediction->active = stat == MS::kSuccess;
+}
+
+//samples the three noise channels from the baked LOD grid using trilinear interpolation
+static void sampleLodGrid(const LodGrid *grid, const float *noiseInput, float *result)
+{
+    const int res = grid->res;
+    int cell[3];
+    float t[3];
+    float u;
+    int c;
+    for (c = 0; c < 3; ++c)
+    {
+        u = (noiseInput[c] - grid->min[c]) * grid->invCellSize[c];
+        cell[c] = static_cast<int>(u);
+        cell[c] = cell[c] < 0 ? 0 : (cell[c] > res - 2 ? res - 2 : cell[c]);
+        t[c] = u - cell[c];
+        t[c] = t[c] < 0.0f ? 0.0f : (t[c] > 1.0f ? 1.0f : t[c]);
+    }
+
+    const float *values = grid->data;
+    const int strideY = res;
+    const int strideZ = res * res;
+    const int base = cell[0] + cell[1] * strideY + cell[2] * strideZ;
+    float c00, c10, c01, c11, c0, c1;
+    for (c = 0; c < 3; ++c)
+    {
+        const float *v = values + c * res * res * res + base;
+        c00 = v[0] + (v[1] - v[0]) * t[0];
+        c10 = v[strideY] + (v[strideY + 1] - v[strideY]) * t[0];
+        c01 = v[strideZ] + (v[strideZ + 1] - v[strideZ]) * t[0];
+        c11 = v[strideZ + strideY] + (v[strideZ + strideY + 1] - v[strideZ + strideY]) * t[0];
+        c0 = c00 + (c10 - c00) * t[1];
+        c1 = c01 + (c11 - c01) * t[1];
+        result[c] = c0 + (c1 - c0) * t[2];
+    }
+}
+
+//bakes the three noise channels into a grid covering the noise space bounds of the given points.
+//The grid is indexed by the unwarped noise space position, so any domain warp is baked in.
+static void bakeLodGrid(LodGrid *grid,
+                        int res,
+                        const MPointArray &points,
+                        const MMatrix &localToLocatorSpaceMat,
+                        const float *freqs,
+                        const float *offsets,
+                        int octaves,
+                        float persistence,
+                        float lacunarity,
+                        int fractalMode,
+                        const DomainWarp *warp)
+{
+    //find local space bounds of the points
+    const int numPoints = points.length();
+    double localMin[3] = { points[0].x, points[0].y, points[0].z };
+    double localMax[3] = { points[0].x, points[0].y, points[0].z };
+    int i, c;
+    for (i = 1; i < numPoints; ++i)
+    {
+        const MPoint &p = points[i];
+        if (p.x < localMin[0]) localMin[0] = p.x; else if (p.x > localMax[0]) localMax[0] = p.x;
+        if (p.y < localMin[1]) localMin[1] = p.y; else if (p.y > localMax[1]) localMax[1] = p.y;
+        if (p.z < localMin[2]) localMin[2] = p.z; else if (p.z > localMax[2]) localMax[2] = p.z;
+    }
+
+    //transform the bounding box corners into noise space to get conservative bounds there
+    float noiseMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float noiseMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    MPoint corner;
+    float u;
+    for (i = 0; i < 8; ++i)
+    {
+        corner = MPoint(i & 1 ? localMax[0] : localMin[0],
+                        i & 2 ? localMax[1] : localMin[1],
+                        i & 4 ? localMax[2] : localMin[2]);
+        corner *= localToLocatorSpaceMat;
+        for (c = 0; c < 3; ++c)
+        {
+            u = freqs[c] * static_cast<float>(corner[c]) - offsets[c];
+            noiseMin[c] = u < noiseMin[c] ? u : noiseMin[c];
+            noiseMax[c] = u > noiseMax[c] ? u : noiseMax[c];
+        }
+    }
+
+    //set up grid
+    grid->res = res;
+    for (c = 0; c < 3; ++c)
+    {
+        grid->min[c] = noiseMin[c];
+        grid->invCellSize[c] = (noiseMax[c] - noiseMin[c] > EPSILON) ? (res - 1) / (noiseMax[c] - noiseMin[c]) : 0.0f;
+    }
+    const int numNodes = res * res * res;
+    grid->values.setLength(numNodes * 3);
+    grid->data = &grid->values[0];
+
+    //evaluate noise at every grid node
+    const bool warped = domainWarpActive(warp);
+    float noiseInput[3];
+    float warpedInput[3];
+    int x, y, z, node;
+    for (z = 0; z < res; ++z)
+    {
+        noiseInput[2] = grid->invCellSize[2] > 0.0f ? noiseMin[2] + z / grid->invCellSize[2] : noiseMin[2];
+        for (y = 0; y < res; ++y)
+        {
+            noiseInput[1] = grid->invCellSize[1] > 0.0f ? noiseMin[1] + y / grid->invCellSize[1] : noiseMin[1];
+            for (x = 0; x < res; ++x)
+            {
+                noiseInput[0] = grid->invCellSize[0] > 0.0f ? noiseMin[0] + x / grid->invCellSize[0] : noiseMin[0];
+                node = x + y * res + z * res * res;
+                warpedInput[0] = noiseInput[0];
+                warpedInput[1] = noiseInput[1];
+                warpedInput[2] = noiseInput[2];
+                if (warped)
+                {
+                    warpNoiseInput<OCTAVE_SCALING_GENERIC>(warpedInput[0], warpedInput[1], warpedInput[2], warp, persistence, lacunarity, NULL, 0);
+                }
+                grid->data[node] = fractal_noise3(warpedInput[0], warpedInput[1], warpedInput[2], octaves, persistence, lacunarity, fractalMode);
+                grid->data[numNodes + node] = fractal_noise3(warpedInput[0] + 123, warpedInput[1] + 456, warpedInput[2] + 789, octaves, persistence, lacunarity, fractalMode);
+                grid->data[2 * numNodes + node] = fractal_noise3(warpedInput[0] + 234, warpedInput[1] + 567, warpedInput[2] + 890, octaves, persistence, lacunarity, fractalMode);
+            }
+        }
+    }
+}
+
+#if defined(LINUX) || defined(LINUX_64)
+
+const int MAX_NUMA_NODES = 64;
+
+//CPUs belonging to each NUMA node, as reported by sysfs
+typedef struct
+{
+    int numNodes;
+    cpu_set_t cpus[MAX_NUMA_NODES];
+} NumaTopology;
+
+//parses a sysfs cpulist string such as "0-7,16-23" into a CPU set
+static void parseCpuList(const char *cpuList, cpu_set_t *cpus)
+{
+    CPU_ZERO(cpus);
+    const char *c = cpuList;
+    char *end;
+    long first, last, cpu;
+    while (*c)
+    {
+        first = strtol(c, &end, 10);
+        if (end == c)
+        {
+            break;
+        }
+        last = first;
+        c = end;
+        if ('-' == *c)
+        {
+            ++c;
+            last = strtol(c, &end, 10);
+            c = end;
+        }
+        for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+        {
+            CPU_SET(cpu, cpus);
+        }
+        if (',' == *c)
+        {
+            ++c;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+//reads the NUMA topology once from sysfs
+static const NumaTopology& numaTopology()
+{
+    static NumaTopology topology;
+    static bool initialized = false;
+    if (!initialized)
+    {
+        topology.numNodes = 0;
+        char path[128];
+        char cpuList[1024];
+        FILE *file;
+        while (topology.numNodes < MAX_NUMA_NODES)
+        {
+            sprintf(path, "/sys/devices/system/node/node%d/cpulist", topology.numNodes);
+            file = fopen(path, "r");
+            if (!file)
+            {
+                break;
+            }
+            if (!fgets(cpuList, sizeof(cpuList), file))
+            {
+                cpuList[0] = '\0';
+            }
+            fclose(file);
+            parseCpuList(cpuList, &topology.cpus[topology.numNodes]);
+            ++topology.numNodes;
+        }
+        if (0 == topology.numNodes)
+        {
+            topology.numNodes = 1;
+        }
+        initialized = true;
+    }
+    return topology;
+}
+
+//returns the number of NUMA nodes on this machine
+static int numaNodeCount()
+{
+    return numaTopology().numNodes;
+}
+
+//restricts the calling thread to the CPUs of the given NUMA node, saving its previous affinity
+static bool pinToNumaNode(int node, cpu_set_t *prevCpus)
+{
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), prevCpus))
+    {
+        return false;
+    }
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &numaTopology().cpus[node]);
+}
+
+//restores the affinity saved by pinToNumaNode
+static void unpinFromNumaNode(const cpu_set_t *prevCpus)
+{
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), prevCpus);
+}
+
+#else
+
+static int numaNodeCount()
+{
+    return 1;
+}
+
+#endif
+
+//computes the Z-order (Morton order) of the given points in locator space (see skNoiseKernels.h)
+static void computeMortonOrder(const MPointArray& points, const MMatrix& localToLocatorSpaceMat, std::vector<unsigned int>& order)
+{
+    const unsigned int numPoints = points.length();
+    std::vector<double> positions(3 * numPoints + 1);
+    unsigned int i;
+    for (i = 0; i < numPoints; ++i)
+    {
+        const MPoint pos = points[i] * localToLocatorSpaceMat;
+        positions[3 * i] = pos.x;
+        positions[3 * i + 1] = pos.y;
+        positions[3 * i + 2] = pos.z;
+    }
+    computeMortonOrder(&positions[0], numPoints, order);
+}
+
+//reorders the points, weights and frequency map of the arena into Z-order, computing the order only when the
+//number of points has changed since it was last computed
+static void applySpatialOrder(ScratchArena *arena, const MMatrix& localToLocatorSpaceMat)
+{
+    const unsigned int numPoints = arena->points.length();
+    if (arena->order.size() != numPoints)
+    {
+        computeMortonOrder(arena->points, localToLocatorSpaceMat, arena->order);
+    }
+
+    arena->orderedPoints.setLength(numPoints);
+    arena->orderedWeights.setLength(numPoints);
+    unsigned int i;
+    for (i = 0; i < numPoints; ++i)
+    {
+        arena->orderedPoints[i] = arena->points[arena->order[i]];
+        arena->orderedWeights[i] = arena->weights[arena->order[i]];
+    }
+
+    //the frequency map follows the points
+    if (!arena->freqScales.empty())
+    {
+        arena->orderedFreqScales.resize(numPoints);
+        for (i = 0; i < numPoints; ++i)
+        {
+            arena->orderedFreqScales[i] = arena->freqScales[arena->order[i]];
+        }
+    }
+}
+
+//returns the deformed points of a geometry in mesh order, scattering them back first if they
+//were evaluated in Z-order
+static MPointArray& restoreOrder(const SharedData& sharedData)
+{
+    if (!sharedData.order)
+    {
+        return *sharedData.points;
+    }
+
+    const MPointArray &orderedPoints = *sharedData.points;
+    MPointArray &points = *sharedData.unorderedPoints;
+    const unsigned int numPoints = orderedPoints.length();
+    unsigned int i;
+    for (i = 0; i < numPoints; ++i)
+    {
+        points[sharedData.order[i]] = orderedPoints[i];
+    }
+    return points;
+}
+
+//calculates the local space bounding box of the falloff volume, so that blocks of points can be
+//culled without transforming them into locator space
+static void computeFalloffBounds(SharedData *sharedData)
+{
+    const double r = sharedData->falloffRadius;
+    int i, j;
+    for (j = 0; j < 3; ++j)
+    {
+        sharedData->falloffLocalMin[j] = HUGE_VAL;
+        sharedData->falloffLocalMax[j] = -HUGE_VAL;
+    }
+    for (i = 0; i < 8; ++i)
+    {
+        MPoint corner((i & 1) ? r : -r, (i & 2) ? r : -r, (i & 4) ? r : -r);
+        corner *= sharedData->locatorToLocalSpaceMat;
+        for (j = 0; j < 3; ++j)
+        {
+            sharedData->falloffLocalMin[j] = std::min(sharedData->falloffLocalMin[j], corner[j]);
+            sharedData->falloffLocalMax[j] = std::max(sharedData->falloffLocalMax[j], corner[j]);
+        }
+    }
+}
+
+//returns true if the local space bounding box of the given points misses the falloff volume
+static bool blockOutsideFalloff(const SharedData *sharedData, int start, int end)
+{
+    if (FALLOFF_SHAPE_NONE == sharedData->falloffShape)
+    {
+        return false;
+    }
+
+    const MPointArray &points = *sharedData->points;
+    double blockMin[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+    double blockMax[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+    int i, j;
+    for (i = start; i < end; ++i)
+    {
+        const MPoint &pos = points[i];
+        for (j = 0; j < 3; ++j)
+        {
+            blockMin[j] = std::min(blockMin[j], pos[j]);
+            blockMax[j] = std::max(blockMax[j], pos[j]);
+        }
+    }
+    for (j = 0; j < 3; ++j)
+    {
+        if (blockMin[j] > sharedData->falloffLocalMax[j] || blockMax[j] < sharedData->falloffLocalMin[j])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//returns the falloff weight for the given locator space position, 1 inside the inner radius and
+//fading smoothly to 0 at the falloff radius
+static inline float falloffWeight(const SharedData *sharedData, double x, double y, double z)
+{
+    double dist;
+    switch (sharedData->falloffShape)
+    {
+        case FALLOFF_SHAPE_SPHERE:
+            dist = std::sqrt(x * x + y * y + z * z);
+            break;
+        case FALLOFF_SHAPE_BOX:
+            dist = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+            break;
+        default:
+            return 1.0f;
+    }
+
+    if (dist >= sharedData->falloffRadius)
+    {
+        return 0.0f;
+    }
+    if (dist <= sharedData->falloffInnerRadius)
+    {
+        return 1.0f;
+    }
+    const float t = static_cast<float>((sharedData->falloffRadius - dist) / (sharedData->falloffRadius - sharedData->falloffInnerRadius));
+    return t * t * (3.0f - 2.0f * t);
+}
+
+//returns the lattice cache of a task, allocating it on first use from the thread running the task.
+//The cached gradients never go stale, so it is kept as is for later evaluations.
+static LatticeCache* taskLatticeCache(ThreadData *threadData)
+{
+    if (threadData->sharedData->latticeCacheOctaves <= 0)
+    {
+        return NULL;
+    }
+    if (!threadData->latticeCache)
+    {
+        threadData->latticeCache = static_cast<LatticeCache*>(malloc(sizeof(LatticeCache)));
+        if (threadData->latticeCache)
+        {
+            resetLatticeCache(threadData->latticeCache);
+        }
+    }
+    return threadData->latticeCache;
+}
+
+//returns the cellular noise cache of a task, allocated the same way as the lattice cache. The
+//feature points only depend on the cells, so it never goes stale either.
+static WorleyCache* taskWorleyCache(ThreadData *threadData)
+{
+    if (!threadData->sharedData->worleyNoiseKernel)
+    {
+        return NULL;
+    }
+    if (!threadData->worleyCache)
+    {
+        threadData->worleyCache = static_cast<WorleyCache*>(malloc(sizeof(WorleyCache)));
+        if (threadData->worleyCache)
+        {
+            resetWorleyCache(threadData->worleyCache);
+        }
+    }
+    return threadData->worleyCache;
+}
+
+//calculates the three noise channels for the given locator space position, either exactly with
+//the kernel selected for this evaluation (or the periodic or cellular one) or from the baked LOD
+//grid. The frequencies are scaled by freqScale, which comes from the frequency map of the point.
+static inline void evaluateNoise(const SharedData *sharedData, LatticeCache *latticeCache, WorleyCache *worleyCache,
+                                 double x, double y, double z, float freqScale, float *noiseValues)
+{
+    const float *freqs = sharedData->freqs;
+    const float *offsets = sharedData->offsets;
+    float scaledFreqs[3];
+    if (1.0f != freqScale)
+    {
+        scaledFreqs[0] = freqs[0] * freqScale;
+        scaledFreqs[1] = freqs[1] * freqScale;
+        scaledFreqs[2] = freqs[2] * freqScale;
+        freqs = scaledFreqs;
+    }
+    if (sharedData->tileable)
+    {
+        sharedData->periodicNoiseKernel(x, y, z, sharedData->loopPosition, freqs, offsets, sharedData->tilePeriods, sharedData->octaves, sharedData->persistence, sharedData->lacunarity, noiseValues);
+    }
+    else if (sharedData->lodGrid)
+    {
+        float noiseInput[3];
+        noiseInput[0] = freqs[0] * x - offsets[0];
+        noiseInput[1] = freqs[1] * y - offsets[1];
+        noiseInput[2] = freqs[2] * z - offsets[2];
+        sampleLodGrid(sharedData->lodGrid, noiseInput, noiseValues);
+    }
+    else if (sharedData->worleyNoiseKernel)
+    {
+        sharedData->worleyNoiseKernel(x, y, z, freqs, offsets, sharedData->octaves, sharedData->persistence, sharedData->lacunarity, worleyCache, &sharedData->warp, noiseValues);
+    }
+    else
+    {
+        sharedData->noiseKernel(x, y, z, freqs, offsets, sharedData->octaves, sharedData->persistence, sharedData->lacunarity, latticeCache, sharedData->latticeCacheOctaves, &sharedData->warp, noiseValues);
+    }
+}
+
+#if defined(LINUX) || defined(LINUX_64)
+
+//NUMA-aware variant of the task loop. The worker is pinned to the node that owns this task and
+//the points are moved through a working buffer that is first touched (hence allocated) on that
+//node, so that the noise phase works on local memory. The points are still gathered from and
+//written back to the shared arrays, wherever they were allocated, so this is experimental.
+static bool processRangeNumaLocal(ThreadData *threadData)
+{
+    const SharedData *sharedData = threadData->sharedData;
+    const int startId = threadData->start;
+    const int count = threadData->end - startId;
+    if (count <= 0)
+    {
+        return true;
+    }
+
+    //pin this worker to the node owning the task
+    cpu_set_t prevCpus;
+    const bool pinned = pinToNumaNode(threadData->numaNode, &prevCpus);
+
+    //(re)allocate the working buffer from the pinned thread, SoA layout. It is kept for later
+    //evaluations and, since a task id always maps to the same node, stays local to it.
+    if (count > threadData->workCapacity)
+    {
+        free(threadData->work);
+        threadData->work = static_cast<double*>(malloc(4 * count * sizeof(double)));
+        threadData->workCapacity = threadData->work ? count : 0;
+    }
+    double *work = threadData->work;
+    if (!work)
+    {
+        if (pinned)
+        {
+            unpinFromNumaNode(&prevCpus);
+        }
+        return false;
+    }
+    double *wx = work;
+    double *wy = work + count;
+    double *wz = work + 2 * count;
+    double *ww = work + 3 * count;
+    LatticeCache *latticeCache = taskLatticeCache(threadData);
+    WorleyCache *worleyCache = taskWorleyCache(threadData);
+
+    MPointArray &points = *sharedData->points;
+    const MFloatArray &weights = *sharedData->weights;
+    const float *amps = sharedData->amps;
+    const float env = sharedData->env;
+    int j;
+
+    //transform phase: gather locator space positions into the node-local buffer
+    MPoint pos;
+    for (j = 0; j < count; ++j)
+    {
+        pos = points[startId + j] * sharedData->localToLocatorSpaceMat;
+        wx[j] = pos.x;
+        wy[j] = pos.y;
+        wz[j] = pos.z;
+        ww[j] = pos.w;
+    }
+
+    //noise phase, the weight is zeroed for points that are left untouched
+    float noiseValues[3];
+    float envTimesWeight;
+    int blockStart, blockEnd;
+    for (blockStart = 0; blockStart < count; blockStart = blockEnd)
+    {
+        blockEnd = std::min(blockStart + FALLOFF_CULL_BLOCK_SIZE, count);
+        if (blockOutsideFalloff(sharedData, startId + blockStart, startId + blockEnd))
+        {
+            for (j = blockStart; j < blockEnd; ++j)
+            {
+                ww[j] = 0.0;
+            }
+            continue;
+        }
+
+        for (j = blockStart; j < blockEnd; ++j)
+        {
+            envTimesWeight = env * weights[startId + j] * falloffWeight(sharedData, wx[j], wy[j], wz[j]);
+            if (0.0f == envTimesWeight)
+            {
+                ww[j] = 0.0;
+                continue;
+            }
+
+            evaluateNoise(sharedData, latticeCache, worleyCache, wx[j], wy[j], wz[j],
+                          sharedData->freqScales ? sharedData->freqScales[startId + j] : 1.0f, noiseValues);
+
+            wx[j] += amps[0] * noiseValues[0] * envTimesWeight;
+            wy[j] += amps[1] * noiseValues[1] * envTimesWeight;
+            wz[j] += amps[2] * noiseValues[2] * envTimesWeight;
+        }
+    }
+
+    //write-back phase: convert back to local space
+    for (j = 0; j < count; ++j)
+    {
+        if (0.0 != ww[j])
+        {
+            points[startId + j] = MPoint(wx[j], wy[j], wz[j], ww[j]) * sharedData->locatorToLocalSpaceMat;
+        }
+    }
+
+    if (pinned)
+    {
+        unpinFromNumaNode(&prevCpus);
+    }
+    return true;
+}
+
+#endif
+
+//main task method for a single thread
+MThreadRetVal threadTask(void* data)
+{
+    ThreadData *threadData = static_cast<ThreadData*>(data);
+
+    //store local variables
+    const SharedData *sharedData = threadData->sharedData;
+    MPointArray *sharedPoints = sharedData->points;
+    const MFloatArray *sharedWeights = sharedData->weights;
+    const float sharedEnv= sharedData->env;
+    const float *sharedAmps = sharedData->amps;
+    const MMatrix &sharedLocalToLocatorSpaceMat = sharedData->localToLocatorSpaceMat;
+    const MMatrix &sharedLocatorToLocalSpaceMat = sharedData->locatorToLocalSpaceMat;
+
+    //get range of ids to work on
+    const int threadStartId = threadData->start;
+    const int threadEndId = threadData->end;
+
+#if defined(LINUX) || defined(LINUX_64)
+    //use node-local working memory on multi-socket machines if requested
+    if (sharedData->numNumaNodes > 1 && processRangeNumaLocal(threadData))
+    {
+        return static_cast<MThreadRetVal>(0);
+    }
+#endif
+
+    //iterate through points within the range, one cull block at a time
+    LatticeCache *latticeCache = taskLatticeCache(threadData);
+    WorleyCache *worleyCache = taskWorleyCache(threadData);
+    float noiseValues[3];
+    float envTimesWeight;
+    MPoint pos;
+    int blockStartId, blockEndId;
+    int i;
+    for (blockStartId = threadStartId; blockStartId < threadEndId; blockStartId = blockEndId)
+    {
+        //skip whole blocks that are outside the falloff volume
+        blockEndId = std::min(blockStartId + FALLOFF_CULL_BLOCK_SIZE, threadEndId);
+        if (blockOutsideFalloff(sharedData, blockStartId, blockEndId))
+        {
+            continue;
+        }
+
+        for (i = blockStartId; i < blockEndId; ++i)
+        {
+            //get locator space position
+            pos = (*sharedPoints)[i] * sharedLocalToLocatorSpaceMat;
+
+            //precompute some values, skip points that are not affected
+            envTimesWeight = sharedEnv * (*sharedWeights)[i] * falloffWeight(sharedData, pos.x, pos.y, pos.z);
+            if (0.0f == envTimesWeight)
+            {
+                continue;
+            }
+
+            //calculate noise values
+            evaluateNoise(sharedData, latticeCache, worleyCache, pos.x, pos.y, pos.z,
+                          sharedData->freqScales ? sharedData->freqScales[i] : 1.0f, noiseValues);
+
+            //calculate new position
+            pos.x += sharedAmps[0] * noiseValues[0] * envTimesWeight;
+            pos.y += sharedAmps[1] * noiseValues[1] * envTimesWeight;
+            pos.z += sharedAmps[2] * noiseValues[2] * envTimesWeight;
+
+            //convert back to local space
+            (*sharedPoints)[i] = pos * sharedLocatorToLocalSpaceMat;
+        }
+    }
+
+    return static_cast<MThreadRetVal>(0);
+}
+
+//task of the parallel-for layer, recorded on the timeline of its thread when tracing
+static void runThreadTask(void* data)
+{
+    const ThreadData *threadData = static_cast<const ThreadData*>(data);
+    TraceSession *trace = threadData->sharedData->trace;
+    const double traceStart = traceBegin(trace);
+    threadTask(data);
+    traceEnd(trace, "task", traceStart, "points", threadData->end - threadData->start);
+}
+
+//runs the tasks of a task list in parallel with the backend chosen at build time and waits for
+//all of them to finish
+static void executeTasks(TaskList *taskList)
+{
+    parallelFor(taskList->numTasks, runThreadTask, taskList->threadData, sizeof(ThreadData));
+}
+
+//a range of the points of a motion blur batch, deformed at every sample by one task
+typedef struct
+{
+    MotionBlurGeometry *geometry;
+    ThreadData *threadData;
+} MotionBlurTask;
+
+//deforms the points of one task at every sample of a motion blur batch. The lattice and cellular
+//caches of the task are shared by all samples, since their entries only depend on the cells.
+static void runMotionBlurTask(void *data)
+{
+    const MotionBlurTask *task = static_cast<const MotionBlurTask*>(data);
+    MotionBlurGeometry *geometry = task->geometry;
+    ThreadData *threadData = task->threadData;
+    MotionBlurSample *samples = geometry->samples;
+    const int numSamples = geometry->numSamples;
+    const bool staticTransform = geometry->staticTransform;
+    const SharedData *firstData = &samples[0].sharedData;
+    const MPointArray &points = geometry->arena.points;
+    const MFloatArray &weights = geometry->arena.weights;
+    const float *freqScales = firstData->freqScales;
+    const double traceStart = traceBegin(firstData->trace);
+
+    LatticeCache *latticeCache = taskLatticeCache(threadData);
+    WorleyCache *worleyCache = taskWorleyCache(threadData);
+    float noiseValues[3];
+    float weight, freqScale, envTimesWeight;
+    float falloff = 1.0f;
+    MPoint locatorPos, pos;
+    int blockStartId, blockEndId;
+    int i, s;
+    for (blockStartId = threadData->start; blockStartId < threadData->end; blockStartId = blockEndId)
+    {
+        //with a static locator and falloff, a block outside the falloff volume is outside of it at
+        //every sample
+        blockEndId = std::min(blockStartId + FALLOFF_CULL_BLOCK_SIZE, threadData->end);
+        if (staticTransform && blockOutsideFalloff(firstData, blockStartId, blockEndId))
+        {
+            for (s = 0; s < numSamples; ++s)
+            {
+                for (i = blockStartId; i < blockEndId; ++i)
+                {
+                    samples[s].points[i] = points[i];
+                }
+            }
+            continue;
+        }
+
+        for (i = blockStartId; i < blockEndId; ++i)
+        {
+            //read the inputs of the point once for all samples
+            const MPoint &inputPos = points[i];
+            weight = weights[i];
+            freqScale = freqScales ? freqScales[i] : 1.0f;
+            if (staticTransform)
+            {
+                locatorPos = inputPos * firstData->localToLocatorSpaceMat;
+                falloff = falloffWeight(firstData, locatorPos.x, locatorPos.y, locatorPos.z);
+            }
+
+            for (s = 0; s < numSamples; ++s)
+            {
+                const SharedData *sharedData = &samples[s].sharedData;
+                if (!staticTransform)
+                {
+                    locatorPos = inputPos * sharedData->localToLocatorSpaceMat;
+                    falloff = falloffWeight(sharedData, locatorPos.x, locatorPos.y, locatorPos.z);
+                }
+
+                //same arithmetic as threadTask, so that a sample matches a separate evaluation
+                envTimesWeight = sharedData->env * weight * falloff;
+                if (0.0f == envTimesWeight)
+                {
+                    samples[s].points[i] = inputPos;
+                    continue;
+                }
+                evaluateNoise(sharedData, latticeCache, worleyCache, locatorPos.x, locatorPos.y, locatorPos.z, freqScale, noiseValues);
+                pos = locatorPos;
+                pos.x += sharedData->amps[0] * noiseValues[0] * envTimesWeight;
+                pos.y += sharedData->amps[1] * noiseValues[1] * envTimesWeight;
+                pos.z += sharedData->amps[2] * noiseValues[2] * envTimesWeight;
+                samples[s].points[i] = pos * sharedData->locatorToLocalSpaceMat;
+            }
+        }
+    }
+
+    traceEnd(firstData->trace, "motionBlurTask", traceStart, "points", threadData->end - threadData->start);
+}
+
+//splits the points of a geometry into tasks of at most chunkSize points each, appending them to
+//the given thread data array and returning the new number of tasks
+static int appendTasks(SharedData *sharedData, int chunkSize, ThreadData *threadData, int numTasks)
+{
+    const int numPoints = sharedData->points->length();
+    int start;
+    for (start = 0; start < numPoints; start += chunkSize)
+    {
+        threadData[numTasks].id = numTasks;
+        threadData[numTasks].start = start;
+        threadData[numTasks].end = start + chunkSize < numPoints ? start + chunkSize : numPoints;
+        threadData[numTasks].sharedData = sharedData;
+        ++numTasks;
+    }
+    return numTasks;
+}
+
+//spreads the tasks over the NUMA nodes in contiguous blocks
+static void assignNumaNodes(ThreadData *threadData, int numTasks, int numNumaNodes)
+{
+    int i;
+    for (i = 0; i < numTasks; ++i)
+    {
+        threadData[i].numaNode = i * numNumaNodes / numTasks;
+    }
+}
+
+//returns whether the data block belongs to an evaluation at another time than the current one,
+//such as the background fill of cached playback, and gets the time that it is evaluated at
+static bool getEvaluationTime(MDataBlock& dataBlock, MTime& time)
+{
+    time = MAnimControl::currentTime();
+#if MAYA_API_VERSION >= 201600
+    const MDGContext &context = dataBlock.context();
+    if (!context.isNormal())
+    {
+        context.getTime(time);
+        return true;
+    }
+#else
+    (void)dataBlock;
+#endif
+    return false;
+}
+
+//reads the attribute values that are shared by all geometries
+MStatus SkNoiseDeformerMT::getEvalSettings(MDataBlock& dataBlock, EvalSettings& settings)
+{
+    MStatus stat = MS::kSuccess;
+
+    MDataHandle envDataHandle = dataBlock.inputValue(envelope, &stat);
+    CHECK_ERROR(stat, "Unable to get envelope data handle\n");
+    settings.env = envDataHandle.asFloat();
+
+    MDataHandle numTasksDataHandle = dataBlock.inputValue(numTasks, &stat);
+    CHECK_ERROR(stat, "Unable to get numTasks data handle\n");
+    settings.numTasks = numTasksDataHandle.asInt();
+
+    MDataHandle autoTasksDataHandle = dataBlock.inputValue(autoTasks, &stat);
+    CHECK_ERROR(stat, "Unable to get autoTasks data handle\n");
+    bool autoTasksValue = autoTasksDataHandle.asBool();
+    settings.taskTuner = NULL;
+
+    MDataHandle numaAwareDataHandle = dataBlock.inputValue(numaAware, &stat);
+    CHECK_ERROR(stat, "Unable to get numaAware data handle\n");
+    settings.numaAware = numaAwareDataHandle.asBool();
+
+    MDataHandle ampDataHandle = dataBlock.inputValue(amp, &stat);
+    CHECK_ERROR(stat, "Unable to get amplitude data handle\n");
+    settings.amps = ampDataHandle.asFloat3();
+
+    MDataHandle freqDataHandle = dataBlock.inputValue(freq, &stat);
+    CHECK_ERROR(stat, "Unable to get frequency data handle\n");
+    settings.freqs = freqDataHandle.asFloat3();
+
+    MDataHandle offsetDataHandle = dataBlock.inputValue(offset, &stat);
+    CHECK_ERROR(stat, "Unable to get offset data handle\n");
+    settings.offsets = offsetDataHandle.asFloat3();
+
+    MDataHandle octavesDataHandle = dataBlock.inputValue(octaves, &stat);
+    CHECK_ERROR(stat, "Unable to get octaves data handle\n");
+    settings.octaves = octavesDataHandle.asInt();
+
+    MDataHandle lacunarityDataHandle = dataBlock.inputValue(lacunarity, &stat);
+    CHECK_ERROR(stat, "Unable to get lacunarity data handle\n");
+    settings.lacunarity = lacunarityDataHandle.asFloat();
+
+    MDataHandle persistenceDataHandle = dataBlock.inputValue(persistence, &stat);
+    CHECK_ERROR(stat, "Unable to get persistence data handle\n");
+    settings.persistence = persistenceDataHandle.asFloat();
+
+    MDataHandle fractalModeDataHandle = dataBlock.inputValue(fractalMode, &stat);
+    CHECK_ERROR(stat, "Unable to get fractalMode data handle\n");
+    settings.fractalMode = fractalModeDataHandle.asShort();
+
+    MDataHandle noiseTypeDataHandle = dataBlock.inputValue(noiseType, &stat);
+    CHECK_ERROR(stat, "Unable to get noiseType data handle\n");
+    settings.noiseType = noiseTypeDataHandle.asShort();
+
+    MDataHandle warpAmountDataHandle = dataBlock.inputValue(warpAmount, &stat);
+    CHECK_ERROR(stat, "Unable to get warpAmount data handle\n");
+    settings.warp.amount = warpAmountDataHandle.asFloat();
+
+    MDataHandle warpFrequencyDataHandle = dataBlock.inputValue(warpFrequency, &stat);
+    CHECK_ERROR(stat, "Unable to get warpFrequency data handle\n");
+    settings.warp.freq = warpFrequencyDataHandle.asFloat();
+
+    MDataHandle warpOctavesDataHandle = dataBlock.inputValue(warpOctaves, &stat);
+    CHECK_ERROR(stat, "Unable to get warpOctaves data handle\n");
+    settings.warp.octaves = warpOctavesDataHandle.asInt();
+
+    MDataHandle ampColorSetDataHandle = dataBlock.inputValue(ampColorSet, &stat);
+    CHECK_ERROR(stat, "Unable to get ampColorSet data handle\n");
+    settings.ampColorSet = ampColorSetDataHandle.asString();
+
+    MDataHandle freqColorSetDataHandle = dataBlock.inputValue(freqColorSet, &stat);
+    CHECK_ERROR(stat, "Unable to get freqColorSet data handle\n");
+    settings.freqColorSet = freqColorSetDataHandle.asString();
+
+    MDataHandle locatorWorldSpaceDataHandle = dataBlock.inputValue(locatorWorldSpace, &stat);
+    CHECK_ERROR(stat, "Unable to get locatorWorldSpace data handle\n");
+    settings.locatorWorldSpaceMat = locatorWorldSpaceDataHandle.asMatrix();
+
+    MDataHandle reproducibleDataHandle = dataBlock.inputValue(reproducible, &stat);
+    CHECK_ERROR(stat, "Unable to get reproducible data handle\n");
+    bool reproducibleValue = reproducibleDataHandle.asBool();
+
+    MDataHandle lodModeDataHandle = dataBlock.inputValue(lodMode, &stat);
+    CHECK_ERROR(stat, "Unable to get lodMode data handle\n");
+    short lodModeValue = lodModeDataHandle.asShort();
+
+    MDataHandle lodMethodDataHandle = dataBlock.inputValue(lodMethod, &stat);
+    CHECK_ERROR(stat, "Unable to get lodMethod data handle\n");
+    settings.lodMethod = lodMethodDataHandle.asShort();
+
+    MDataHandle lodOctavesDataHandle = dataBlock.inputValue(lodOctaves, &stat);
+    CHECK_ERROR(stat, "Unable to get lodOctaves data handle\n");
+    settings.lodOctaves = lodOctavesDataHandle.asInt();
+
+    MDataHandle lodGridResolutionDataHandle = dataBlock.inputValue(lodGridResolution, &stat);
+    CHECK_ERROR(stat, "Unable to get lodGridResolution data handle\n");
+    settings.lodGridResolution = lodGridResolutionDataHandle.asInt();
+
+    MDataHandle falloffShapeDataHandle = dataBlock.inputValue(falloffShape, &stat);
+    CHECK_ERROR(stat, "Unable to get falloffShape data handle\n");
+    settings.falloffShape = falloffShapeDataHandle.asShort();
+
+    MDataHandle falloffRadiusDataHandle = dataBlock.inputValue(falloffRadius, &stat);
+    CHECK_ERROR(stat, "Unable to get falloffRadius data handle\n");
+    settings.falloffRadius = falloffRadiusDataHandle.asFloat();
+
+    MDataHandle falloffSmoothnessDataHandle = dataBlock.inputValue(falloffSmoothness, &stat);
+    CHECK_ERROR(stat, "Unable to get falloffSmoothness data handle\n");
+    settings.falloffSmoothness = falloffSmoothnessDataHandle.asFloat();
+
+    MDataHandle tileableDataHandle = dataBlock.inputValue(tileable, &stat);
+    CHECK_ERROR(stat, "Unable to get tileable data handle\n");
+    settings.tileable = tileableDataHandle.asBool();
+
+    MDataHandle tilePeriodDataHandle = dataBlock.inputValue(tilePeriod, &stat);
+    CHECK_ERROR(stat, "Unable to get tilePeriod data handle\n");
+    const int3 &tilePeriodValue = tilePeriodDataHandle.asInt3();
+    settings.tilePeriods[0] = tilePeriodValue[0];
+    settings.tilePeriods[1] = tilePeriodValue[1];
+    settings.tilePeriods[2] = tilePeriodValue[2];
+
+    MDataHandle loopFramesDataHandle = dataBlock.inputValue(loopFrames, &stat);
+    CHECK_ERROR(stat, "Unable to get loopFrames data handle\n");
+    settings.loopFrames = loopFramesDataHandle.asInt();
+
+    MDataHandle loopPeriodDataHandle = dataBlock.inputValue(loopPeriod, &stat);
+    CHECK_ERROR(stat, "Unable to get loopPeriod data handle\n");
+    settings.loopPeriod = loopPeriodDataHandle.asInt();
+
+    //the loop follows the time attribute, so that a retimed time connection retimes the loop too. It
+    //is only connected while the noise loops.
+    if (settings.tileable && settings.loopFrames > 0)
+    {
+        MDataHandle timeDataHandle = dataBlock.inputValue(time, &stat);
+        CHECK_ERROR(stat, "Unable to get time data handle\n");
+        settings.loopTime = timeDataHandle.asTime();
+    }
+
+    MDataHandle spatialReorderDataHandle = dataBlock.inputValue(spatialReorder, &stat);
+    CHECK_ERROR(stat, "Unable to get spatialReorder data handle\n");
+    settings.spatialReorder = spatialReorderDataHandle.asBool();
+
+    MDataHandle latticeCacheOctavesDataHandle = dataBlock.inputValue(latticeCacheOctaves, &stat);
+    CHECK_ERROR(stat, "Unable to get latticeCacheOctaves data handle\n");
+    settings.latticeCacheOctaves = latticeCacheOctavesDataHandle.asInt();
+
+    MDataHandle asyncPlaybackDataHandle = dataBlock.inputValue(asyncPlayback, &stat);
+    CHECK_ERROR(stat, "Unable to get asyncPlayback data handle\n");
+    settings.background = getEvaluationTime(dataBlock, settings.time);
+    if (settings.background)
+    {
+        settings.loopTime = settings.time;
+    }
+    settings.asyncPlayback = asyncPlaybackDataHandle.asBool() && MAnimControl::isPlaying() && !settings.background;
+
+    MDataHandle frameCacheDataHandle = dataBlock.inputValue(frameCache, &stat);
+    CHECK_ERROR(stat, "Unable to get frameCache data handle\n");
+    settings.frameCache = frameCacheDataHandle.asShort();
+
+    MDataHandle frameCacheBudgetDataHandle = dataBlock.inputValue(frameCacheBudget, &stat);
+    CHECK_ERROR(stat, "Unable to get frameCacheBudget data handle\n");
+    settings.frameCacheBudget = frameCacheBudgetDataHandle.asFloat();
+
+    MDataHandle incrementalUpdateDataHandle = dataBlock.inputValue(incrementalUpdate, &stat);
+    CHECK_ERROR(stat, "Unable to get incrementalUpdate data handle\n");
+    settings.incrementalUpdate = incrementalUpdateDataHandle.asBool() && !reproducibleValue && !settings.background;
+
+    MDataHandle motionBlurSamplesDataHandle = dataBlock.inputValue(motionBlurSamples, &stat);
+    CHECK_ERROR(stat, "Unable to get motionBlurSamples data handle\n");
+    settings.motionBlurSamples = std::min(motionBlurSamplesDataHandle.asInt(), MOTION_BLUR_MAX_SAMPLES);
+
+    MDataHandle motionBlurShutterDataHandle = dataBlock.inputValue(motionBlurShutter, &stat);
+    CHECK_ERROR(stat, "Unable to get motionBlurShutter data handle\n");
+    settings.motionBlurShutter = motionBlurShutterDataHandle.asDouble();
+
+    MDataHandle traceFileDataHandle = dataBlock.inputValue(traceFile, &stat);
+    CHECK_ERROR(stat, "Unable to get traceFile data handle\n");
+    settings.traceFile = traceFileDataHandle.asString();
+
+    MDataHandle traceEvaluationsDataHandle = dataBlock.inputValue(traceEvaluations, &stat);
+    CHECK_ERROR(stat, "Unable to get traceEvaluations data handle\n");
+    settings.traceEvaluations = traceEvaluationsDataHandle.asInt();
+    settings.trace = NULL;
+
+    //pull on the refresh attribute so that it is clean after this evaluation
+    dataBlock.inputValue(lodRefresh, &stat);
+    CHECK_ERROR(stat, "Unable to get lodRefresh data handle\n");
+
+    //background evaluations leave the state of the foreground alone and only take the exact path
+    if (settings.background)
+    {
+        settings.useLod = false;
+        settings.frameCache = FRAME_CACHE_OFF;
+        return stat;
+    }
+
+    //color sets are read from the input geometry, which then has to be watched for changes
+    m_colorSetsUsed = settings.ampColorSet.length() > 0 || settings.freqColorSet.length() > 0;
+
+    //allow the LOD approximation only in the UI, never for playback, batch or reproducible results.
+    //Whether a geometry is actually being manipulated is decided when it is prepared.
+    settings.useLod = (LOD_MODE_INTERACTIVE == lodModeValue)
+                      && !reproducibleValue
+                      && MGlobal::kInteractive == MGlobal::mayaState()
+                      && !MAnimControl::isPlaying();
+
+    //cached displacements are approximate
+    if (reproducibleValue)
+    {
+        settings.frameCache = FRAME_CACHE_OFF;
+    }
+    if (FRAME_CACHE_OFF == settings.frameCache && m_frameCache)
+    {
+        delete m_frameCache;
+        m_frameCache = NULL;
+    }
+
+    //motion blur batches are released once turned off
+    if (settings.motionBlurSamples <= 1 && !m_motionBlurGeometries.empty())
+    {
+        std::map<unsigned int, MotionBlurGeometry*>::iterator it;
+        for (it = m_motionBlurGeometries.begin(); it != m_motionBlurGeometries.end(); ++it)
+        {
+            delete it->second;
+        }
+        m_motionBlurGeometries.clear();
+    }
+
+    //record a timeline of the evaluations if a trace file is given, dropping the events that were
+    //not written out yet when tracing is turned off
+    if (settings.traceFile.length() > 0)
+    {
+        if (!m_trace)
+        {
+            m_trace = new TraceSession();
+        }
+        settings.trace = m_trace;
+    }
+    else if (m_trace)
+    {
+        delete m_trace;
+        m_trace = NULL;
+    }
+
+    //tune the task count if requested, starting from the counts learned in an earlier session (see
+    //getInternalValue())
+    if (autoTasksValue)
+    {
+        if (!m_taskTuner)
+        {
+            m_taskTuner = new TaskTuner();
+            m_taskTuner->seed(m_learnedTasks);
+        }
+        settings.taskTuner = m_taskTuner;
+    }
+    else if (m_taskTuner)
+    {
+        m_learnedTasks = m_taskTuner->learned();
+        delete m_taskTuner;
+        m_taskTuner = NULL;
+    }
+
+    return stat;
+}
+
+//packs the data that the tasks need to deform the given points into sharedData, without any LOD
+//approximation or reordering
+static void packSharedData(const EvalSettings& settings,
+                           const MMatrix& localToWorldMat,
+                           MPointArray *points,
+                           MFloatArray *weights,
+                           SharedData& sharedData)
+{
+    //precompute some transformation matrices
+    sharedData.localToLocatorSpaceMat = localToWorldMat * settings.locatorWorldSpaceMat.inverse();
+    sharedData.locatorToLocalSpaceMat = settings.locatorWorldSpaceMat * localToWorldMat.inverse();
+
+    sharedData.points = points;
+    sharedData.weights = weights;
+    sharedData.order = NULL;
+    sharedData.unorderedPoints = NULL;
+    sharedData.freqScales = NULL;
+    sharedData.meshFreqScales = NULL;
+    sharedData.env = settings.env;
+    sharedData.amps = settings.amps;
+    sharedData.freqs = settings.freqs;
+    sharedData.offsets = settings.offsets;
+    sharedData.octaves = settings.octaves;
+    sharedData.lacunarity = settings.lacunarity;
+    sharedData.persistence = settings.persistence;
+    sharedData.lodGrid = NULL;
+    sharedData.fractalMode = settings.fractalMode;
+    sharedData.warp = settings.warp;
+    if (!domainWarpActive(&settings.warp) || settings.tileable)
+    {
+        sharedData.warp.amount = 0.0f;
+    }
+    sharedData.noiseKernel = selectNoiseKernel(settings.octaves, settings.persistence, settings.lacunarity, settings.freqs, settings.fractalMode, &sharedData.warp);
+    sharedData.periodicNoiseKernel = selectPeriodicNoiseKernel(settings.fractalMode);
+    sharedData.noiseType = settings.tileable ? static_cast<short>(NOISE_TYPE_SIMPLEX) : settings.noiseType;
+    sharedData.worleyNoiseKernel = selectWorleyNoiseKernel(sharedData.noiseType, settings.fractalMode);
+    sharedData.numNumaNodes = settings.numaAware ? numaNodeCount() : 1;
+    sharedData.latticeCacheOctaves = settings.latticeCacheOctaves;
+    sharedData.falloffShape = settings.falloffShape;
+    sharedData.falloffRadius = settings.falloffRadius;
+    sharedData.falloffInnerRadius = settings.falloffRadius * (1.0f - settings.falloffSmoothness);
+    if (FALLOFF_SHAPE_NONE != settings.falloffShape)
+    {
+        computeFalloffBounds(&sharedData);
+    }
+
+    //the time axis of the tileable noise wraps every loopFrames frames
+    sharedData.tileable = settings.tileable;
+    sharedData.tilePeriods[0] = settings.tilePeriods[0];
+    sharedData.tilePeriods[1] = settings.tilePeriods[1];
+    sharedData.tilePeriods[2] = settings.tilePeriods[2];
+    sharedData.tilePeriods[3] = 0;
+    sharedData.loopPosition = 0.0f;
+    sharedData.trace = NULL;
+    if (settings.tileable && settings.loopFrames > 0)
+    {
+        const double frame = std::fmod(settings.loopTime.as(MTime::uiUnit()), static_cast<double>(settings.loopFrames));
+        sharedData.tilePeriods[3] = settings.loopPeriod;
+        sharedData.loopPosition = static_cast<float>((frame < 0.0 ? frame + settings.loopFrames : frame) / settings.loopFrames * settings.loopPeriod);
+    }
+}
+
+//gathers one per-vertex map of a geometry into scales, in the order of vertexIds. A color set of
+//the given name on the input mesh takes precedence (its red channel is used and unset colors scale
+//by 1), then the painted values of mapAttr. scales is left empty if neither of them exists.
+static MStatus gatherVertexMap(MDataBlock& dataBlock,
+                               unsigned int multiIndex,
+                               const MObject& mapAttr,
+                               const MString& colorSet,
+                               const std::vector<int>& vertexIds,
+                               std::vector<float>& scales)
+{
+    MStatus stat = MS::kSuccess;
+    const unsigned int numPoints = vertexIds.size();
+    unsigned int i;
+    scales.clear();
+
+    if (colorSet.length() > 0)
+    {
+        MArrayDataHandle inputArrayDataHandle = dataBlock.inputArrayValue(SkNoiseDeformerMT::input, &stat);
+        CHECK_ERROR(stat, "Unable to get input array data handle\n");
+        if (inputArrayDataHandle.jumpToElement(multiIndex))
+        {
+            MObject meshObj = inputArrayDataHandle.inputValue().child(SkNoiseDeformerMT::inputGeom).asMesh();
+            MColorArray colors;
+            const MColor unsetColor(-1.0f, -1.0f, -1.0f, -1.0f);
+            if (!meshObj.isNull() && MFnMesh(meshObj).getVertexColors(colors, &colorSet, &unsetColor))
+            {
+                scales.resize(numPoints);
+                for (i = 0; i < numPoints; ++i)
+                {
+                    const int id = vertexIds[i];
+                    scales[i] = (id < static_cast<int>(colors.length()) && colors[id].r >= 0.0f) ? colors[id].r : 1.0f;
+                }
+                return stat;
+            }
+        }
+    }
+
+    MArrayDataHandle vertexMapListDataHandle = dataBlock.inputArrayValue(SkNoiseDeformerMT::vertexMapList, &stat);
+    CHECK_ERROR(stat, "Unable to get vertexMapList data handle\n");
+    if (!vertexMapListDataHandle.jumpToElement(multiIndex))
+    {
+        return stat;
+    }
+    MObject mapData = vertexMapListDataHandle.inputValue().child(mapAttr).data();
+    MFnDoubleArrayData mapFn(mapData, &stat);
+    if (!stat)
+    {
+        return MS::kSuccess;
+    }
+    const MDoubleArray values = mapFn.array();
+    if (0 == values.length())
+    {
+        return stat;
+    }
+    scales.resize(numPoints);
+    for (i = 0; i < numPoints; ++i)
+    {
+        const int id = vertexIds[i];
+        scales[i] = id < static_cast<int>(values.length()) ? static_cast<float>(values[id]) : 1.0f;
+    }
+    return stat;
+}
+
+//gathers the amplitude and frequency maps of one geometry into contiguous arrays of its arena. They
+//are kept across evaluations and only gathered again once one of their sources has been dirtied or
+//the number of points has changed. Background evaluations always gather them.
+MStatus SkNoiseDeformerMT::gatherVertexMaps(MDataBlock& dataBlock,
+                                            unsigned int multiIndex,
+                                            const EvalSettings& settings,
+                                            ScratchArena *arena)
+{
+    MStatus stat = MS::kSuccess;
+
+    if (!settings.background
+        && arena->vertexMapsValid
+        && arena->vertexMapGeneration == m_vertexMapGeneration
+        && arena->vertexIds.size() == arena->points.length())
+    {
+        return stat;
+    }
+    arena->vertexMapsValid = !settings.background;
+    arena->vertexMapGeneration = m_vertexMapGeneration;
+
+    stat = gatherVertexMap(dataBlock, multiIndex, ampMap, settings.ampColorSet, arena->vertexIds, arena->ampScales);
+    CHECK_ERROR(stat, "Unable to gather amplitude map\n");
+    stat = gatherVertexMap(dataBlock, multiIndex, freqMap, settings.freqColorSet, arena->vertexIds, arena->freqScales);
+    CHECK_ERROR(stat, "Unable to gather frequency map\n");
+
+    return stat;
+}
+
+//returns true if dirtying the given plug may change the per-vertex maps
+bool SkNoiseDeformerMT::isVertexMapSource(const MPlug& plug) const
+{
+    //climb to the top level attribute of array elements and compound children
+    MPlug topPlug = plug;
+    while (topPlug.isElement() || topPlug.isChild())
+    {
+        topPlug = topPlug.isElement() ? topPlug.array() : topPlug.parent();
+    }
+    const MObject attr = topPlug.attribute();
+    return attr == vertexMapList || attr == ampColorSet || attr == freqColorSet
+           || (m_colorSetsUsed && attr == input);
+}
+
+//gathers the points and weights of one geometry into its scratch arena and packs the data that
+//the tasks need into sharedData
+MStatus SkNoiseDeformerMT::prepareGeometry(MDataBlock& dataBlock,
+                                           MItGeometry& geomIter,
+                                           const MMatrix& localToWorldMat,
+                                           unsigned int multiIndex,
+                                           const EvalSettings& settings,
+                                           SharedData& sharedData)
+{
+    MStatus stat = MS::kSuccess;
+
+    //get the scratch arena for this geometry
+    ScratchArena *&arena = scratchArena(multiIndex, settings.background);
+    if (!arena)
+    {
+        arena = new ScratchArena();
+    }
+
+    //read all points
+    MPointArray &points = arena->points;
+    stat = geomIter.allPositions(points);
+    CHECK_ERROR(stat, "Unable to get point positions\n");
+    int numPoints = points.length();
+
+    //store all weight values and vertex ids, in the same order as the points
+    MFloatArray &weights = arena->weights;
+    weights.setLength(numPoints);
+    arena->vertexIds.resize(numPoints);
+    int i = 0;
+    for (geomIter.reset(); !geomIter.isDone(); geomIter.next(), ++i)
+    {
+        arena->vertexIds[i] = geomIter.index();
+        weights[i] = weightValue(dataBlock, multiIndex, arena->vertexIds[i]);
+    }
+
+    //the amplitude map scales the displacements just like the weights, so it is folded into them
+    stat = gatherVertexMaps(dataBlock, multiIndex, settings, arena);
+    CHECK_ERROR(stat, "Unable to gather vertex maps\n");
+    if (!arena->ampScales.empty())
+    {
+        for (i = 0; i < numPoints; ++i)
+        {
+            weights[i] *= arena->ampScales[i];
+        }
+    }
+
+    //pack data into the struct
+    packSharedData(settings, localToWorldMat, &points, &weights, sharedData);
+    if (!arena->freqScales.empty())
+    {
+        sharedData.freqScales = sharedData.meshFreqScales = &arena->freqScales[0];
+    }
+
+    //take the LOD approximation only while the geometry is being manipulated, i.e. if it was last
+    //evaluated at the same time just before, unless it is due to be refined. Stepping through
+    //frames, playblasts and single edits thus stay exact.
+    const bool useLod = settings.useLod
+                        && !arena->exactPending
+                        && arena->lastEvalTime == settings.time
+                        && traceClock() - arena->lastEvalEnd < LOD_INTERACTION_INTERVAL;
+    if (!settings.background)
+    {
+        arena->exactPending = false;
+        arena->lodActive = useLod;
+    }
+
+    //prepare LOD approximation, the baked grid has a single frequency
+    if (useLod)
+    {
+        if (LOD_METHOD_BAKED_GRID == settings.lodMethod && !settings.tileable && !sharedData.worleyNoiseKernel && !sharedData.freqScales && numPoints > 0)
+        {
+            bakeLodGrid(&arena->lodGrid, settings.lodGridResolution, points, sharedData.localToLocatorSpaceMat, settings.freqs, settings.offsets, settings.octaves, settings.persistence, settings.lacunarity, settings.fractalMode, &sharedData.warp);
+            sharedData.lodGrid = &arena->lodGrid;
+        }
+        else if (settings.lodOctaves < settings.octaves)
+        {
+            sharedData.octaves = settings.lodOctaves;
+            sharedData.noiseKernel = selectNoiseKernel(sharedData.octaves, settings.persistence, settings.lacunarity, settings.freqs, settings.fractalMode, &sharedData.warp);
+        }
+    }
+
+    //evaluate the points in Z-order if requested
+    if (settings.spatialReorder && numPoints > 0)
+    {
+        applySpatialOrder(arena, sharedData.localToLocatorSpaceMat);
+        sharedData.points = &arena->orderedPoints;
+        sharedData.weights = &arena->orderedWeights;
+        sharedData.order = &arena->order[0];
+        sharedData.unorderedPoints = &points;
+        if (sharedData.freqScales)
+        {
+            sharedData.freqScales = &arena->orderedFreqScales[0];
+        }
+    }
+
+    return stat;
+}
+
+//FNV-1a offset basis and prime of the 64-bit signatures
+const MUint64 SIGNATURE_BASIS = 14695981039346656037ULL;
+const MUint64 SIGNATURE_PRIME = 1099511628211ULL;
+
+//folds the given bytes into a 64-bit FNV-1a style hash, 32 bits at a time. The signatures are 64-bit
+//so that a result computed from other inputs is practically never mistaken for the right one.
+static MUint64 hashBytes(MUint64 hash, const void *data, size_t numBytes)
+{
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    unsigned int word;
+    size_t i;
+    for (i = 0; i + sizeof(word) <= numBytes; i += sizeof(word))
+    {
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * SIGNATURE_PRIME;
+    }
+    for (; i < numBytes; ++i)
+    {
+        hash = (hash ^ bytes[i]) * SIGNATURE_PRIME;
+    }
+    return hash;
+}
+
+//hashes everything that the noise of a geometry depends on, leaving out the envelope, the amplitude
+//and the weights (which include the amplitude map) which only scale the displacements
+static MUint64 noiseSignature(const SharedData& sharedData, const MPointArray& points)
+{
+    MUint64 hash = SIGNATURE_BASIS;
+    hash = hashBytes(hash, sharedData.freqs, 3 * sizeof(float));
+    hash = hashBytes(hash, sharedData.offsets, 3 * sizeof(float));
+    hash = hashBytes(hash, &sharedData.octaves, sizeof(int));
+    hash = hashBytes(hash, &sharedData.lacunarity, sizeof(float));
+    hash = hashBytes(hash, &sharedData.persistence, sizeof(float));
+    hash = hashBytes(hash, &sharedData.noiseType, sizeof(short));
+    hash = hashBytes(hash, &sharedData.fractalMode, sizeof(short));
+    hash = hashBytes(hash, &sharedData.warp.amount, sizeof(float));
+    hash = hashBytes(hash, &sharedData.warp.freq, sizeof(float));
+    hash = hashBytes(hash, &sharedData.warp.octaves, sizeof(int));
+    hash = hashBytes(hash, &sharedData.falloffShape, sizeof(short));
+    hash = hashBytes(hash, &sharedData.falloffRadius, sizeof(float));
+    hash = hashBytes(hash, &sharedData.falloffInnerRadius, sizeof(float));
+    const int gridRes = sharedData.lodGrid ? sharedData.lodGrid->res : 0;
+    hash = hashBytes(hash, &gridRes, sizeof(int));
+    hash = hashBytes(hash, &sharedData.tileable, sizeof(bool));
+    hash = hashBytes(hash, sharedData.tilePeriods, 4 * sizeof(int));
+    hash = hashBytes(hash, &sharedData.loopPosition, sizeof(float));
+
+    double matrix[4][4];
+    sharedData.localToLocatorSpaceMat.get(matrix);
+    hash = hashBytes(hash, matrix, sizeof(matrix));
+
+    //MPointArray keeps its points contiguous, so they are hashed in place
+    const unsigned int numPoints = points.length();
+    if (numPoints > 0)
+    {
+        hash = hashBytes(hash, &points[0], numPoints * sizeof(MPoint));
+    }
+    if (sharedData.meshFreqScales)
+    {
+        hash = hashBytes(hash, sharedData.meshFreqScales, numPoints * sizeof(float));
+    }
+    return hash;
+}
+
+//hashes everything that the result of a geometry depends on, so that a background or cached result
+//can be checked against the actual inputs of the frame
+static MUint64 evaluationSignature(const SharedData& sharedData, const MPointArray& points, const MFloatArray& weights)
+{
+    MUint64 hash = noiseSignature(sharedData, points);
+    hash = hashBytes(hash, &sharedData.env, sizeof(float));
+    hash = hashBytes(hash, sharedData.amps, 3 * sizeof(float));
+
+    const unsigned int numPoints = weights.length();
+    float weight;
+    unsigned int i;
+    for (i = 0; i < numPoints; ++i)
+    {
+        weight = weights[i];
+        hash = hashBytes(hash, &weight, sizeof(float));
+    }
+    return hash;
+}
+
+//completion callback of a background task, the last one of a slot wakes up its waiting threads
+static void asyncTaskDone(void *data)
+{
+    AsyncSlot *slot = static_cast<AsyncSlot*>(data);
+    if (MAtomic::preDecrement(&slot->pending) > 0)
+    {
+        return;
+    }
+#if defined(LINUX) || defined(LINUX_64)
+    pthread_mutex_lock(&slot->mutex);
+    pthread_cond_broadcast(&slot->done);
+    pthread_mutex_unlock(&slot->mutex);
+#endif
+}
+
+//returns the slot holding the background result of this geometry for the current frame if it was
+//computed from inputs with the same signature (the inputs are in the arena, before deformation), NULL otherwise. The
+//other slot is then loaded with the inputs of the predicted next frame and returned in stagedSlot.
+static AsyncSlot* exchangeAsyncResult(AsyncGeometry *geometry,
+                                      const ScratchArena& arena,
+                                      const SharedData& sharedData,
+                                      const MMatrix& localToWorldMat,
+                                      AsyncFrame& frame,
+                                      AsyncSlot **stagedSlot)
+{
+    //take the result of the current frame if the prediction was right
+    AsyncSlot *resultSlot = NULL;
+    int i;
+    for (i = 0; i < 2; ++i)
+    {
+        AsyncSlot *slot = &geometry->slots[i];
+        if (slot->valid && slot->time == frame.time)
+        {
+            waitForAsyncSlot(slot);
+            slot->valid = false;
+            if (slot->signature == evaluationSignature(sharedData, arena.points, arena.weights))
+            {
+                resultSlot = slot;
+            }
+            break;
+        }
+    }
+
+    //stage the next frame in the other slot, assuming that the input points, weights and maps stay the same
+    AsyncSlot *slot = (resultSlot == &geometry->slots[0]) ? &geometry->slots[1] : &geometry->slots[0];
+    waitForAsyncSlot(slot);
+    slot->arena.points = arena.points;
+    slot->arena.weights = arena.weights;
+    slot->arena.freqScales = arena.freqScales;
+    packSharedData(frame.nextSettings, localToWorldMat, &slot->arena.points, &slot->arena.weights, slot->sharedData);
+    if (!slot->arena.freqScales.empty())
+    {
+        slot->sharedData.freqScales = slot->sharedData.meshFreqScales = &slot->arena.freqScales[0];
+    }
+    memcpy(slot->values, frame.nextValues, sizeof(slot->values));
+    slot->sharedData.amps = slot->values;
+    slot->sharedData.freqs = slot->values + 3;
+    slot->sharedData.offsets = slot->values + 6;
+    slot->signature = evaluationSignature(slot->sharedData, slot->arena.points, slot->arena.weights);
+    slot->time = frame.nextTime;
+    slot->valid = true;
+    *stagedSlot = slot;
+
+    return resultSlot;
+}
+
+//starts the background tasks of a staged slot
+static void launchAsyncSlot(AsyncSlot *slot, int numTasks)
+{
+    SharedData *sharedData = &slot->sharedData;
+    const int chunkSize = std::max(1, static_cast<int>(std::ceil(sharedData->points->length() / static_cast<double>(numTasks))));
+    ThreadData *threadData = slot->arena.reserveThreadData(numTasks);
+    const int numSlotTasks = appendTasks(sharedData, chunkSize, threadData, 0);
+    assignNumaNodes(threadData, numSlotTasks, sharedData->numNumaNodes);
+
+    //a task that cannot be started in the background is run right away, so that the slot is never
+    //left with a partial result
+    MAtomic::set(&slot->pending, numSlotTasks);
+    int i;
+    for (i = 0; i < numSlotTasks; ++i)
+    {
+        if (!MThreadAsync::createTask(threadTask, static_cast<void*>(&threadData[i]), asyncTaskDone, static_cast<void*>(slot)))
+        {
+            threadTask(static_cast<void*>(&threadData[i]));
+            asyncTaskDone(static_cast<void*>(slot));
+        }
+    }
+}
+
+//returns the background buffers of a geometry, creating them on first use
+AsyncGeometry* SkNoiseDeformerMT::asyncGeometry(unsigned int multiIndex)
+{
+    if (!m_asyncInitialized)
+    {
+        MStatus stat = MThreadAsync::init();
+        CHECK_ERROR_NO_RETURN(stat, "Unable to initialize async threads\n");
+        m_asyncInitialized = true;
+    }
+
+    AsyncGeometry *&geometry = m_asyncGeometries[multiIndex];
+    if (!geometry)
+    {
+        geometry = new AsyncGeometry();
+    }
+    return geometry;
+}
+
+//predicts the time of the next evaluation from the last step of the playback
+MTime SkNoiseDeformerMT::predictNextTime(const MTime& time)
+{
+    const MTime::Unit unit = MTime::uiUnit();
+    const double playbackBy = MAnimControl::playbackBy();
+    double step = time.as(unit) - m_lastPlaybackTime.as(unit);
+    if (0.0 == step || std::fabs(step) > 2.0 * playbackBy)
+    {
+        step = playbackBy;
+    }
+    m_lastPlaybackTime = time;
+
+    MTime nextTime = time + MTime(step, unit);
+    if (nextTime > MAnimControl::maxTime() || nextTime < MAnimControl::minTime())
+    {
+        if (MAnimControl::kPlaybackLoop == MAnimControl::playbackMode())
+        {
+            nextTime = step > 0.0 ? MAnimControl::minTime() : MAnimControl::maxTime();
+        }
+        else
+        {
+            nextTime = time - MTime(step, unit);
+        }
+    }
+    return nextTime;
+}
+
+//reads the animatable attribute values at the given time, with the vector values stored in values.
+//It evaluates the graph at that time, so it is only called outside of compute.
+MStatus SkNoiseDeformerMT::getEvalSettingsAtTime(const MTime& time, EvalSettings& settings, float *values)
+{
+    MStatus stat = MS::kSuccess;
+
+    MDGContext context(time);
+    MObject thisObj = thisMObject();
+    settings.time = time;
+
+    stat = MPlug(thisObj, envelope).getValue(settings.env, context);
+    CHECK_ERROR(stat, "Unable to get envelope value\n");
+
+    const MObject vectorAttrs[3] = { amp, freq, offset };
+    MPlug vectorPlug;
+    unsigned int i, j;
+    for (i = 0; i < 3; ++i)
+    {
+        vectorPlug = MPlug(thisObj, vectorAttrs[i]);
+        for (j = 0; j < 3; ++j)
+        {
+            stat = vectorPlug.child(j).getValue(values[3 * i + j], context);
+            CHECK_ERROR(stat, "Unable to get amplitude, frequency or offset value\n");
+        }
+    }
+    settings.amps = values;
+    settings.freqs = values + 3;
+    settings.offsets = values + 6;
+
+    stat = MPlug(thisObj, octaves).getValue(settings.octaves, context);
+    CHECK_ERROR(stat, "Unable to get octaves value\n");
+    stat = MPlug(thisObj, lacunarity).getValue(settings.lacunarity, context);
+    CHECK_ERROR(stat, "Unable to get lacunarity value\n");
+    stat = MPlug(thisObj, persistence).getValue(settings.persistence, context);
+    CHECK_ERROR(stat, "Unable to get persistence value\n");
+    stat = MPlug(thisObj, fractalMode).getValue(settings.fractalMode, context);
+    CHECK_ERROR(stat, "Unable to get fractalMode value\n");
+    stat = MPlug(thisObj, noiseType).getValue(settings.noiseType, context);
+    CHECK_ERROR(stat, "Unable to get noiseType value\n");
+    stat = MPlug(thisObj, warpAmount).getValue(settings.warp.amount, context);
+    CHECK_ERROR(stat, "Unable to get warpAmount value\n");
+    stat = MPlug(thisObj, warpFrequency).getValue(settings.warp.freq, context);
+    CHECK_ERROR(stat, "Unable to get warpFrequency value\n");
+    stat = MPlug(thisObj, warpOctaves).getValue(settings.warp.octaves, context);
+    CHECK_ERROR(stat, "Unable to get warpOctaves value\n");
+    stat = MPlug(thisObj, falloffShape).getValue(settings.falloffShape, context);
+    CHECK_ERROR(stat, "Unable to get falloffShape value\n");
+    stat = MPlug(thisObj, falloffRadius).getValue(settings.falloffRadius, context);
+    CHECK_ERROR(stat, "Unable to get falloffRadius value\n");
+    stat = MPlug(thisObj, falloffSmoothness).getValue(settings.falloffSmoothness, context);
+    CHECK_ERROR(stat, "Unable to get falloffSmoothness value\n");
+    stat = MPlug(thisObj, SkNoiseDeformerMT::time).getValue(settings.loopTime, context);
+    CHECK_ERROR(stat, "Unable to get time value\n");
+
+    MObject locatorWorldSpaceObj;
+    stat = MPlug(thisObj, locatorWorldSpace).getValue(locatorWorldSpaceObj, context);
+    CHECK_ERROR(stat, "Unable to get locatorWorldSpace value\n");
+    MFnMatrixData matrixFn(locatorWorldSpaceObj, &stat);
+    CHECK_ERROR(stat, "Unable to attach matrix data function set\n");
+    settings.locatorWorldSpaceMat = matrixFn.matrix();
+
+    settings.useLod = false;
+
+    return stat;
+}
+
+//copies the animatable attribute values that getEvalSettingsAtTime() reads from source onto settings
+static void copySettingsAtTime(const EvalSettings& source, EvalSettings& settings)
+{
+    settings.time = source.time;
+    settings.loopTime = source.loopTime;
+    settings.env = source.env;
+    settings.amps = source.amps;
+    settings.freqs = source.freqs;
+    settings.offsets = source.offsets;
+    settings.octaves = source.octaves;
+    settings.lacunarity = source.lacunarity;
+    settings.persistence = source.persistence;
+    settings.fractalMode = source.fractalMode;
+    settings.noiseType = source.noiseType;
+    settings.warp = source.warp;
+    settings.falloffShape = source.falloffShape;
+    settings.falloffRadius = source.falloffRadius;
+    settings.falloffSmoothness = source.falloffSmoothness;
+    settings.locatorWorldSpaceMat = source.locatorWorldSpaceMat;
+    settings.useLod = false;
+}
+
+//sets up the prediction of the next frame if async playback is active, from the attribute values
+//that timeChangeCallback() read at the predicted time before this evaluation
+void SkNoiseDeformerMT::prepareAsyncFrame(const EvalSettings& settings, AsyncFrame& frame)
+{
+    frame.active = settings.asyncPlayback
+                   && m_asyncPrediction
+                   && m_asyncPrediction->active
+                   && m_asyncPrediction->time == settings.time;
+    if (!frame.active)
+    {
+        return;
+    }
+
+    frame.time = settings.time;
+    frame.nextTime = m_asyncPrediction->nextTime;
+    frame.nextSettings = settings;
+    copySettingsAtTime(m_asyncPrediction->nextSettings, frame.nextSettings);
+    memcpy(frame.nextValues, m_asyncPrediction->nextValues, sizeof(frame.nextValues));
+    frame.nextSettings.amps = frame.nextValues;
+    frame.nextSettings.freqs = frame.nextValues + 3;
+    frame.nextSettings.offsets = frame.nextValues + 6;
+}
+
+//returns the deformed points of a geometry if the time of this evaluation is one of the samples of
+//its motion blur batch, NULL otherwise. The batch is only built by skNoiseMotionBlur, outside of
+//compute, so compute never pulls values at other times. Sub-frame evaluations of the frame, such
+//as those of a renderer, are then taken from the batch as long as their inputs (which are in the
+//arena, before deformation) match those of their sample. Whole frame and background evaluations
+//are never taken from a batch, so that an odd number of samples does not slow down normal
+//evaluations. Every other foreground evaluation keeps its inputs for the next batch.
+MPointArray* SkNoiseDeformerMT::motionBlurPoints(unsigned int multiIndex,
+                                                 const MMatrix& localToWorldMat,
+                                                 const EvalSettings& settings,
+                                                 const SharedData& sharedData)
+{
+    if (settings.background)
+    {
+        return NULL;
+    }
+
+    const MTime::Unit unit = MTime::uiUnit();
+    const double now = settings.time.as(unit);
+    const double frame = std::floor(now + 0.5);
+    ScratchArena *arena = scratchArena(multiIndex, false);
+    MotionBlurGeometry *&geometry = m_motionBlurGeometries[multiIndex];
+    if (!geometry)
+    {
+        geometry = new MotionBlurGeometry();
+    }
+    if (std::fabs(now - frame) >= MOTION_BLUR_TIME_TOLERANCE
+        && geometry->frame == frame
+        && geometry->numSamples == settings.motionBlurSamples
+        && geometry->shutter == settings.motionBlurShutter)
+    {
+        const MUint64 signature = evaluationSignature(sharedData, arena->points, arena->weights);
+        int i;
+        for (i = 0; i < geometry->numSamples; ++i)
+        {
+            MotionBlurSample &sample = geometry->samples[i];
+            if (std::fabs(sample.time.as(unit) - now) < MOTION_BLUR_TIME_TOLERANCE && sample.signature == signature)
+            {
+                return &sample.points;
+            }
+        }
+    }
+
+    //keep the inputs of this evaluation, which skNoiseMotionBlur deforms at every sample time
+    geometry->inputPoints = arena->points;
+    geometry->inputWeights = arena->weights;
+    geometry->inputFreqScales = arena->freqScales;
+    geometry->localToWorldMat = localToWorldMat;
+    geometry->settings = settings;
+    geometry->settings.trace = NULL;
+    geometry->inputsValid = true;
+    return NULL;
+}
+
+//deforms the inputs that a geometry has kept at every sample time of the request in a single pass
+//over its points, assuming that the input points, weights and maps stay the same over the shutter
+void SkNoiseDeformerMT::buildMotionBlurBatch(MotionBlurGeometry *geometry, const MotionBlurRequest& request)
+{
+    geometry->arena.points = geometry->inputPoints;
+    geometry->arena.weights = geometry->inputWeights;
+    geometry->arena.freqScales = geometry->inputFreqScales;
+    geometry->numSamples = 0;
+    geometry->staticTransform = true;
+    int i;
+    for (i = 0; i < request.numSamples; ++i)
+    {
+        MotionBlurSample &sample = geometry->samples[i];
+        EvalSettings sampleSettings = geometry->settings;
+        copySettingsAtTime(request.settings[i], sampleSettings);
+        memcpy(sample.values, request.values[i], sizeof(sample.values));
+        sampleSettings.amps = sample.values;
+        sampleSettings.freqs = sample.values + 3;
+        sampleSettings.offsets = sample.values + 6;
+        sample.time = sampleSettings.time;
+
+        packSharedData(sampleSettings, geometry->localToWorldMat, &geometry->arena.points, &geometry->arena.weights, sample.sharedData);
+        if (!geometry->arena.freqScales.empty())
+        {
+            sample.sharedData.freqScales = sample.sharedData.meshFreqScales = &geometry->arena.freqScales[0];
+        }
+        sample.signature = evaluationSignature(sample.sharedData, geometry->arena.points, geometry->arena.weights);
+        sample.points.setLength(geometry->arena.points.length());
+
+        //the locator space position and falloff of a point can be shared if they are the same at every sample
+        const SharedData &firstData = geometry->samples[0].sharedData;
+        if (sample.sharedData.localToLocatorSpaceMat != firstData.localToLocatorSpaceMat
+            || sample.sharedData.falloffShape != firstData.falloffShape
+            || sample.sharedData.falloffRadius != firstData.falloffRadius
+            || sample.sharedData.falloffInnerRadius != firstData.falloffInnerRadius)
+        {
+            geometry->staticTransform = false;
+        }
+    }
+    for (i = request.numSamples; i < MOTION_BLUR_MAX_SAMPLES; ++i)
+    {
+        geometry->samples[i].points.clear();
+    }
+    geometry->numSamples = request.numSamples;
+    geometry->frame = request.frame;
+    geometry->shutter = request.shutter;
+
+    //split the points into tasks that each deform their range at every sample
+    SharedData *firstData = &geometry->samples[0].sharedData;
+    const EvalSettings &settings = geometry->settings;
+    const int numPoints = geometry->arena.points.length();
+    const int numTasks = settings.taskTuner ? settings.taskTuner->numTasks(numPoints, settings.numTasks) : settings.numTasks;
+    const int chunkSize = std::max(1, static_cast<int>(std::ceil(numPoints / static_cast<double>(numTasks))));
+    ThreadData *threadData = geometry->arena.reserveThreadData(numTasks);
+    const int numBatchTasks = appendTasks(firstData, chunkSize, threadData, 0);
+    std::vector<MotionBlurTask> tasks(numBatchTasks);
+    for (i = 0; i < numBatchTasks; ++i)
+    {
+        tasks[i].geometry = geometry;
+        tasks[i].threadData = &threadData[i];
+    }
+    if (numBatchTasks > 0)
+    {
+        parallelFor(numBatchTasks, runMotionBlurTask, &tasks[0], sizeof(MotionBlurTask));
+    }
+}
+
+//returns whether the input geometry at the given index has the same points at every sample time of
+//the request as at the current time. Only mesh inputs can be compared.
+MStatus SkNoiseDeformerMT::checkStaticInput(unsigned int multiIndex, const MotionBlurRequest& request, bool& staticInput)
+{
+    MStatus stat = MS::kSuccess;
+
+    MPlug inputGeomPlug = MPlug(thisMObject(), input).elementByLogicalIndex(multiIndex).child(inputGeom);
+    MObject currentObj;
+    stat = inputGeomPlug.getValue(currentObj);
+    CHECK_ERROR(stat, "Unable to get the input geometry\n");
+    MFnMesh currentFn(currentObj, &stat);
+    CHECK_ERROR(stat, "The motion blur samples can only be deformed for mesh inputs\n");
+    MPointArray currentPoints;
+    stat = currentFn.getPoints(currentPoints);
+    CHECK_ERROR(stat, "Unable to get the input points\n");
+
+    MObject sampleObj;
+    MPointArray samplePoints;
+    staticInput = true;
+    int i;
+    for (i = 0; i < request.numSamples && staticInput; ++i)
+    {
+        MDGContext context(request.settings[i].time);
+        stat = inputGeomPlug.getValue(sampleObj, context);
+        CHECK_ERROR(stat, "Unable to get the input geometry of a motion blur sample\n");
+        MFnMesh sampleFn(sampleObj, &stat);
+        CHECK_ERROR(stat, "Unable to get the input mesh of a motion blur sample\n");
+        stat = sampleFn.getPoints(samplePoints);
+        CHECK_ERROR(stat, "Unable to get the input points of a motion blur sample\n");
+        staticInput = samplePoints.length() == currentPoints.length()
+                      && (0 == currentPoints.length() || 0 == memcmp(&samplePoints[0], &currentPoints[0], currentPoints.length() * sizeof(MPoint)));
+    }
+
+    return stat;
+}
+
+//deforms the motion blur samples of the current frame of one geometry in one pass, returning the
+//x y z of every point of every sample in a flat list, one sample after the other in time order.
+//The attribute values and input points at the sample times are read here, outside of compute. The
+//geometry is evaluated once more through a dirtied refresh attribute, which neither modifies the
+//scene nor goes on the undo queue, so that the inputs it keeps are those of the current time.
+MStatus SkNoiseDeformerMT::deformMotionBlurSamples(unsigned int multiIndex, MDoubleArray& result)
+{
+    MStatus stat = MS::kSuccess;
+    MObject thisObj = thisMObject();
+
+    MotionBlurRequest request;
+    request.numSamples = std::min(MPlug(thisObj, motionBlurSamples).asInt(), MOTION_BLUR_MAX_SAMPLES);
+    request.shutter = MPlug(thisObj, motionBlurShutter).asDouble();
+    if (request.numSamples < 2)
+    {
+        MGlobal::displayError("[" + nodeType + "] motionBlurSamples must be at least 2");
+        return MS::kInvalidParameter;
+    }
+
+    //the samples are spread evenly over the shutter, centred on the nearest frame, and the one at
+    //the current time is taken at its exact time
+    const MTime::Unit unit = MTime::uiUnit();
+    const MTime currentTime = MAnimControl::currentTime();
+    request.frame = std::floor(currentTime.as(unit) + 0.5);
+    MTime sampleTime;
+    int i;
+    for (i = 0; i < request.numSamples; ++i)
+    {
+        sampleTime = MTime(request.frame + request.shutter * (i / static_cast<double>(request.numSamples - 1) - 0.5), unit);
+        if (std::fabs(sampleTime.as(unit) - currentTime.as(unit)) < MOTION_BLUR_TIME_TOLERANCE)
+        {
+            sampleTime = currentTime;
+        }
+        stat = getEvalSettingsAtTime(sampleTime, request.settings[i], request.values[i]);
+        CHECK_ERROR(stat, "Unable to get attribute values of a motion blur sample\n");
+    }
+
+    //all samples are deformed from the same input points, which an animated input does not have
+    bool staticInput = false;
+    stat = checkStaticInput(multiIndex, request, staticInput);
+    CHECK_ERROR(stat, "Unable to check the input geometry over the shutter\n");
+    if (!staticInput)
+    {
+        MGlobal::displayError("[" + nodeType + "] The input geometry changes over the shutter, so its motion blur samples can not be deformed in one pass");
+        return MS::kFailure;
+    }
+
+    //evaluate the geometry again so that it keeps its inputs at the current time
+    std::map<unsigned int, MotionBlurGeometry*>::iterator it = m_motionBlurGeometries.find(multiIndex);
+    if (it != m_motionBlurGeometries.end())
+    {
+        it->second->inputsValid = false;
+        it->second->numSamples = 0;
+    }
+    MFnDependencyNode thisFn(thisObj);
+    stat = MGlobal::executeCommand("dgdirty " + thisFn.name() + ".lodRefresh");
+    CHECK_ERROR(stat, "Unable to dirty the output geometry\n");
+    MObject outputGeomObj;
+    stat = MPlug(thisObj, outputGeom).elementByLogicalIndex(multiIndex).getValue(outputGeomObj);
+    CHECK_ERROR(stat, "Unable to evaluate the output geometry\n");
+
+    //the inputs are missing if the geometry was not deformed, e.g. while the envelope is 0
+    it = m_motionBlurGeometries.find(multiIndex);
+    if (it == m_motionBlurGeometries.end() || !it->second->inputsValid)
+    {
+        MGlobal::displayError("[" + nodeType + "] The motion blur samples of this geometry could not be deformed");
+        return MS::kFailure;
+    }
+    MotionBlurGeometry *geometry = it->second;
+    buildMotionBlurBatch(geometry, request);
+
+    const unsigned int numPoints = geometry->arena.points.length();
+    result.setLength(3 * numPoints * request.numSamples);
+    unsigned int j, k = 0;
+    for (i = 0; i < request.numSamples; ++i)
+    {
+        const MPointArray &points = geometry->samples[i].points;
+        for (j = 0; j < numPoints; ++j)
+        {
+            result[k++] = points[j].x;
+            result[k++] = points[j].y;
+            result[k++] = points[j].z;
+        }
+    }
+
+    return stat;
+}
+
+//returns the frame cache, creating it on first use
+FrameCache* SkNoiseDeformerMT::getFrameCache()
+{
+    if (!m_frameCache)
+    {
+        m_frameCache = new FrameCache();
+    }
+    return m_frameCache;
+}
+
+//applies the cached displacements of a geometry at the given time to its points, if there are
+//some that were computed from the same inputs
+static bool applyCachedFrame(FrameCache *cache,
+                             unsigned int multiIndex,
+                             const MTime& time,
+                             MUint64 signature,
+                             const SharedData& sharedData,
+                             MPointArray& points)
+{
+    std::map<FrameCache::Key, CachedFrame*>::const_iterator it = cache->frames.find(FrameCache::Key(multiIndex, time.as(MTime::kSeconds)));
+    const int numPoints = points.length();
+    if (it == cache->frames.end() || it->second->signature != signature || it->second->numValues != 3 * numPoints)
+    {
+        return false;
+    }
+
+    //decode all displacements
+    const CachedFrame *frame = it->second;
+    const float *displacements;
+    if (FRAME_CACHE_FLOAT == frame->format)
+    {
+        displacements = frame->numValues ? &frame->floats[0] : NULL;
+    }
+    else
+    {
+        cache->decoded.resize(frame->numValues);
+        if (FRAME_CACHE_HALF == frame->format)
+        {
+            decodeHalf(frame->numValues ? &frame->halves[0] : NULL, frame->numValues ? &cache->decoded[0] : NULL, frame->numValues);
+        }
+        else
+        {
+            decodeFixed16(frame->numValues ? &frame->codes[0] : NULL, frame->numValues ? &cache->decoded[0] : NULL, frame->numValues, frame->scales);
+        }
+        displacements = frame->numValues ? &cache->decoded[0] : NULL;
+    }
+
+    //displace in locator space, leaving the points that were not displaced untouched
+    MPoint pos;
+    int i;
+    for (i = 0; i < numPoints; ++i)
+    {
+        const float *displacement = displacements + 3 * i;
+        if (0.0f == displacement[0] && 0.0f == displacement[1] && 0.0f == displacement[2])
+        {
+            continue;
+        }
+        pos = points[i] * sharedData.localToLocatorSpaceMat;
+        pos.x += displacement[0];
+        pos.y += displacement[1];
+        pos.z += displacement[2];
+        points[i] = pos * sharedData.locatorToLocalSpaceMat;
+    }
+    return true;
+}
+
+//gathers the locator space displacements of a geometry from inputPoints to points
+static void gatherDisplacements(const SharedData& sharedData,
+                                const MPointArray& inputPoints,
+                                const MPointArray& points,
+                                std::vector<float>& displacements)
+{
+    const int numPoints = points.length();
+    displacements.resize(3 * numPoints);
+    MPoint inputPos, pos;
+    int i;
+    for (i = 0; i < numPoints; ++i)
+    {
+        //points that were not displaced get exact zeros so that they are left untouched when applied
+        if (points[i].x == inputPoints[i].x && points[i].y == inputPoints[i].y && points[i].z == inputPoints[i].z)
+        {
+            displacements[3 * i] = displacements[3 * i + 1] = displacements[3 * i + 2] = 0.0f;
+            continue;
+        }
+        inputPos = inputPoints[i] * sharedData.localToLocatorSpaceMat;
+        pos = points[i] * sharedData.localToLocatorSpaceMat;
+        displacements[3 * i] = static_cast<float>(pos.x - inputPos.x);
+        displacements[3 * i + 1] = static_cast<float>(pos.y - inputPos.y);
+        displacements[3 * i + 2] = static_cast<float>(pos.z - inputPos.z);
+    }
+}
+
+//encodes the displacements of a geometry and stores them for the given time, evicting the oldest
+//frames that no longer fit in the budget
+static void storeCachedFrame(FrameCache *cache,
+                             unsigned int multiIndex,
+                             const MTime& time,
+                             MUint64 signature,
+                             const EvalSettings& settings,
+                             const SharedData& sharedData,
+                             const std::vector<float>& displacements)
+{
+    //get the entry of this frame, replacing what was there before
+    const FrameCache::Key key(multiIndex, time.as(MTime::kSeconds));
+    CachedFrame *&frame = cache->frames[key];
+    if (frame)
+    {
+        cache->bytes -= frame->memoryUsage();
+    }
+    else
+    {
+        frame = new CachedFrame();
+        cache->insertionOrder.push_back(key);
+    }
+    frame->signature = signature;
+    frame->format = settings.frameCache;
+    const int numValues = displacements.size();
+    frame->numValues = numValues;
+    frame->floats.clear();
+    frame->halves.clear();
+    frame->codes.clear();
+
+    //encode and measure the error against the amplitude
+    const float *values = numValues ? &displacements[0] : NULL;
+    if (FRAME_CACHE_FLOAT == frame->format)
+    {
+        frame->floats.assign(displacements.begin(), displacements.end());
+    }
+    else if (numValues)
+    {
+        cache->decoded.resize(numValues);
+        float *decoded = &cache->decoded[0];
+        if (FRAME_CACHE_HALF == frame->format)
+        {
+            frame->halves.resize(numValues);
+            encodeHalf(values, &frame->halves[0], numValues);
+            decodeHalf(&frame->halves[0], decoded, numValues);
+        }
+        else
+        {
+            frame->codes.resize(numValues);
+            fixed16Scales(values, numValues, frame->scales);
+            encodeFixed16(values, &frame->codes[0], numValues, frame->scales);
+            decodeFixed16(&frame->codes[0], decoded, numValues, frame->scales);
+        }
+        int i;
+        for (i = 0; i < numValues; ++i)
+        {
+            const float amp = std::fabs(sharedData.amps[i % 3]);
+            if (amp > EPSILON)
+            {
+                cache->maxRelativeError = std::max(cache->maxRelativeError, std::fabs(decoded[i] - values[i]) / amp);
+            }
+        }
+    }
+    cache->bytes += frame->memoryUsage();
+
+    //evict the oldest frames, always keeping the one that was just stored
+    const double budgetBytes = settings.frameCacheBudget * 1024.0 * 1024.0;
+    while (cache->bytes > budgetBytes && cache->insertionOrder.size() > 1)
+    {
+        std::map<FrameCache::Key, CachedFrame*>::iterator it = cache->frames.find(cache->insertionOrder.front());
+        cache->insertionOrder.pop_front();
+        if (it != cache->frames.end() && it->second != frame)
+        {
+            cache->bytes -= it->second->memoryUsage();
+            delete it->second;
+            cache->frames.erase(it);
+        }
+    }
+}
+
+//records the inputs of a full evaluation of a geometry, whose displacements have been gathered
+//into lastDisplacements
+static void recordLastResult(ScratchArena *arena, MUint64 noiseSignature, const SharedData& sharedData)
+{
+    arena->lastValid = true;
+    arena->lastNoiseSignature = noiseSignature;
+    arena->lastEnv = sharedData.env;
+    memcpy(arena->lastAmps, sharedData.amps, sizeof(arena->lastAmps));
+    arena->lastWeights = arena->weights;
+}
+
+//updates the points of a geometry whose noise has not changed since the last full evaluation by
+//rescaling its displacements to the new envelope, amplitude and weights. Returns
+//EVAL_PATH_FULL, leaving the points untouched, if some of them can not be rescaled because they
+//were not displaced before.
+static short rescaleLastResult(ScratchArena *arena, const SharedData& sharedData)
+{
+    MPointArray &points = arena->points;
+    const MFloatArray &weights = arena->weights;
+    const MFloatArray &lastWeights = arena->lastWeights;
+    const int numPoints = points.length();
+    if (static_cast<int>(arena->lastDisplacements.size()) != 3 * numPoints)
+    {
+        return EVAL_PATH_FULL;
+    }
+
+    //per-axis scales
+    float axisScales[3];
+    bool unchanged = true;
+    int i;
+    for (i = 0; i < 3; ++i)
+    {
+        if (0.0f == arena->lastAmps[i])
+        {
+            if (0.0f != sharedData.amps[i])
+            {
+                return EVAL_PATH_FULL;
+            }
+            axisScales[i] = 0.0f;
+        }
+        else
+        {
+            axisScales[i] = sharedData.amps[i] / arena->lastAmps[i];
+            unchanged = unchanged && 1.0f == axisScales[i];
+        }
+    }
+
+    //per-point scales, checked before anything is touched
+    float lastEnvTimesWeight, envTimesWeight;
+    for (i = 0; i < numPoints; ++i)
+    {
+        lastEnvTimesWeight = arena->lastEnv * lastWeights[i];
+        envTimesWeight = sharedData.env * weights[i];
+        if (0.0f == lastEnvTimesWeight)
+        {
+            if (0.0f != envTimesWeight)
+            {
+                return EVAL_PATH_FULL;
+            }
+        }
+        else
+        {
+            unchanged = unchanged && envTimesWeight == lastEnvTimesWeight;
+        }
+    }
+
+    //displace in locator space, leaving the points that were not displaced untouched
+    const float *displacements = &arena->lastDisplacements[0];
+    MPoint pos;
+    float scale;
+    for (i = 0; i < numPoints; ++i)
+    {
+        const float *displacement = displacements + 3 * i;
+        if (0.0f == displacement[0] && 0.0f == displacement[1] && 0.0f == displacement[2])
+        {
+            continue;
+        }
+        lastEnvTimesWeight = arena->lastEnv * lastWeights[i];
+        scale = (sharedData.env * weights[i]) / lastEnvTimesWeight;
+        pos = points[i] * sharedData.localToLocatorSpaceMat;
+        pos.x += displacement[0] * axisScales[0] * scale;
+        pos.y += displacement[1] * axisScales[1] * scale;
+        pos.z += displacement[2] * axisScales[2] * scale;
+        points[i] = pos * sharedData.locatorToLocalSpaceMat;
+    }
+    return unchanged ? EVAL_PATH_REUSE : EVAL_PATH_RESCALE;
+}
+
+//takes the cheapest valid path to the result of one geometry: the background result of this frame,
+//a motion blur sample, a rescale of the last full evaluation or the cached displacements of this
+//frame. The points of
+//the geometry are deformed in place by the last two. If none applies, eval.path is set to
+//EVAL_PATH_FULL and the tasks have to be run.
+void SkNoiseDeformerMT::selectEvalPath(unsigned int multiIndex,
+                                       const MMatrix& localToWorldMat,
+                                       const EvalSettings& settings,
+                                       AsyncFrame& asyncFrame,
+                                       SharedData& sharedData,
+                                       GeometryEval& eval)
+{
+    ScratchArena *arena = scratchArena(multiIndex, settings.background);
+    eval.path = EVAL_PATH_FULL;
+    eval.resultSlot = NULL;
+    eval.stagedSlot = NULL;
+    eval.motionBlurPoints = NULL;
+
+    //take the background result of this frame if there is a valid one
+    if (asyncFrame.active)
+    {
+        eval.resultSlot = exchangeAsyncResult(asyncGeometry(multiIndex), *arena, sharedData, localToWorldMat, asyncFrame, &eval.stagedSlot);
+        if (eval.resultSlot)
+        {
+            eval.path = EVAL_PATH_ASYNC;
+            return;
+        }
+    }
+
+    //otherwise take the sample of this time from the motion blur batch of this frame
+    if (settings.motionBlurSamples > 1)
+    {
+        eval.motionBlurPoints = motionBlurPoints(multiIndex, localToWorldMat, settings, sharedData);
+        if (eval.motionBlurPoints)
+        {
+            eval.path = EVAL_PATH_MOTION_BLUR;
+            return;
+        }
+    }
+
+    //otherwise rescale the last result if only the envelope, the amplitude or the weights changed.
+    //There is no need to hash the noise inputs if the evaluation manager says that only those changed.
+    if (settings.incrementalUpdate)
+    {
+        eval.noiseSignature = (m_scaleInputsOnly && arena->lastValid) ? arena->lastNoiseSignature : noiseSignature(sharedData, arena->points);
+        if (arena->lastValid && arena->lastNoiseSignature == eval.noiseSignature)
+        {
+            eval.path = rescaleLastResult(arena, sharedData);
+            if (EVAL_PATH_FULL != eval.path)
+            {
+                return;
+            }
+        }
+    }
+    else if (arena->lastValid)
+    {
+        arena->releaseLastResult();
+    }
+
+    //otherwise reuse the cached displacements of this frame if they were computed from the same inputs
+    if (FRAME_CACHE_OFF != settings.frameCache)
+    {
+        eval.signature = evaluationSignature(sharedData, arena->points, arena->weights);
+        if (applyCachedFrame(getFrameCache(), multiIndex, settings.time, eval.signature, sharedData, arena->points))
+        {
+            eval.path = EVAL_PATH_FRAME_CACHE;
+            return;
+        }
+    }
+
+    //keep the input points to gather the displacements of the full evaluation from
+    if (settings.incrementalUpdate || FRAME_CACHE_OFF != settings.frameCache)
+    {
+        arena->inputPoints = arena->points;
+    }
+}
+
+//returns the deformed points of one geometry once its path has been taken, keeping the
+//displacements of a full evaluation for later updates and frames
+MPointArray& SkNoiseDeformerMT::finishGeometry(unsigned int multiIndex,
+                                               const EvalSettings& settings,
+                                               const SharedData& sharedData,
+                                               const GeometryEval& eval)
+{
+    ScratchArena *arena = scratchArena(multiIndex, settings.background);
+    if (!settings.background)
+    {
+        arena->lastEvalTime = settings.time;
+        arena->lastEvalEnd = traceClock();
+    }
+    if (eval.resultSlot)
+    {
+        return eval.resultSlot->arena.points;
+    }
+    if (eval.motionBlurPoints)
+    {
+        return *eval.motionBlurPoints;
+    }
+    if (EVAL_PATH_FULL != eval.path)
+    {
+        return arena->points;
+    }
+
+    MPointArray &points = restoreOrder(sharedData);
+    if (settings.incrementalUpdate)
+    {
+        gatherDisplacements(sharedData, arena->inputPoints, points, arena->lastDisplacements);
+        recordLastResult(arena, eval.noiseSignature, sharedData);
+        if (FRAME_CACHE_OFF != settings.frameCache && !arena->lodActive)
+        {
+            storeCachedFrame(getFrameCache(), multiIndex, settings.time, eval.signature, settings, sharedData, arena->lastDisplacements);
+        }
+    }
+    else if (FRAME_CACHE_OFF != settings.frameCache && !arena->lodActive)
+    {
+        FrameCache *cache = getFrameCache();
+        gatherDisplacements(sharedData, arena->inputPoints, points, cache->displacements);
+        storeCachedFrame(cache, multiIndex, settings.time, eval.signature, settings, sharedData, cache->displacements);
+    }
+    return points;
+}
+
+//returns the scratch arena slot of a geometry. Background evaluations have their own arenas, so
+//that they never share memory with an evaluation in the foreground.
+ScratchArena*& SkNoiseDeformerMT::scratchArena(unsigned int multiIndex, bool background)
+{
+    return background ? m_backgroundArenas[multiIndex] : m_scratchArenas[multiIndex];
+}
+
+//reports the memory held across all geometries, the frame cache error and the path taken by the
+//most expensive geometry. Background evaluations only report the path, since the rest belongs to
+//the foreground.
+MStatus SkNoiseDeformerMT::reportStatistics(MDataBlock& dataBlock, const EvalSettings& settings, short path)
+{
+    MStatus stat = MS::kSuccess;
+
+    MDataHandle evalPathDataHandle = dataBlock.outputValue(evalPath, &stat);
+    CHECK_ERROR(stat, "Unable to get evalPath data handle\n");
+    evalPathDataHandle.set(path);
+    evalPathDataHandle.setClean();
+    if (settings.background)
+    {
+        return stat;
+    }
+
+    double scratchBytes = m_batchArena ? m_batchArena->tasks.memoryUsage() : 0.0;
+    std::map<unsigned int, ScratchArena*>::const_iterator it;
+    for (it = m_scratchArenas.begin(); it != m_scratchArenas.end(); ++it)
+    {
+        scratchBytes += it->second->memoryUsage();
+    }
+    std::map<unsigned int, AsyncGeometry*>::const_iterator asyncIt;
+    for (asyncIt = m_asyncGeometries.begin(); asyncIt != m_asyncGeometries.end(); ++asyncIt)
+    {
+        scratchBytes += asyncIt->second->slots[0].arena.memoryUsage() + asyncIt->second->slots[1].arena.memoryUsage();
+    }
+    std::map<unsigned int, MotionBlurGeometry*>::const_iterator motionBlurIt;
+    for (motionBlurIt = m_motionBlurGeometries.begin(); motionBlurIt != m_motionBlurGeometries.end(); ++motionBlurIt)
+    {
+        scratchBytes += motionBlurIt->second->memoryUsage();
+    }
+    MDataHandle scratchMemoryDataHandle = dataBlock.outputValue(scratchMemory, &stat);
+    CHECK_ERROR(stat, "Unable to get scratchMemory data handle\n");
+    scratchMemoryDataHandle.set(static_cast<float>(scratchBytes / (1024.0 * 1024.0)));
+    scratchMemoryDataHandle.setClean();
 
-//constructor
-SkNoiseDeformerMT::SkNoiseDeformerMT()
-{
-    //init thread pool
-    cerr << "[" << nodeType << "] Initializing thread pool" << endl;
-    MStatus stat = MThreadPool::init();
-    CHECK_ERROR_NO_RETURN(stat, "Unable to create thread pool\n");
+    MDataHandle frameCacheMemoryDataHandle = dataBlock.outputValue(frameCacheMemory, &stat);
+    CHECK_ERROR(stat, "Unable to get frameCacheMemory data handle\n");
+    frameCacheMemoryDataHandle.set(static_cast<float>(m_frameCache ? m_frameCache->bytes / (1024.0 * 1024.0) : 0.0));
+    frameCacheMemoryDataHandle.setClean();
+
+    MDataHandle frameCacheErrorDataHandle = dataBlock.outputValue(frameCacheError, &stat);
+    CHECK_ERROR(stat, "Unable to get frameCacheError data handle\n");
+    frameCacheErrorDataHandle.set(m_frameCache ? m_frameCache->maxRelativeError : 0.0f);
+    frameCacheErrorDataHandle.setClean();
+
+    MDataHandle tunedTasksDataHandle = dataBlock.outputValue(tunedTasks, &stat);
+    CHECK_ERROR(stat, "Unable to get tunedTasks data handle\n");
+    tunedTasksDataHandle.set(m_taskTuner && m_taskTuner->lastTasks > 0 ? m_taskTuner->lastTasks : settings.numTasks);
+    tunedTasksDataHandle.setClean();
+
+    return stat;
 }
 
-//destructor
-SkNoiseDeformerMT::~SkNoiseDeformerMT()
+//counts one traced evaluation, and writes the timeline of the last traceEvaluations evaluations
+//to the next numbered trace file once they are complete
+static void flushTrace(const EvalSettings& settings)
 {
-    //release thread pool
-    cerr << "[" << nodeType << "] Releasing thread pool" << endl;
-    MThreadPool::release();
+    TraceSession *trace = settings.trace;
+    if (!trace || ++trace->numEvaluations < std::max(settings.traceEvaluations, 1))
+    {
+        return;
+    }
+    trace->numEvaluations = 0;
+
+    MString path = settings.traceFile;
+    path += ".";
+    path += trace->numFiles++;
+    path += ".json";
+    if (!trace->write(path.asChar()))
+    {
+        MGlobal::displayWarning("[" + nodeType + "] Unable to write trace file " + path);
+    }
 }
 
-//main task method for a single thread
-MThreadRetVal threadTask(void* data)
+//main deform method
+MStatus SkNoiseDeformerMT::deform(MDataBlock& dataBlock,
+                                MItGeometry& geomIter,
+                                const MMatrix& localToWorldMat,
+                                unsigned int multiIndex)
 {
-    ThreadData *threadData = static_cast<ThreadData*>(data);
+    MStatus stat = MS::kSuccess;
 
-    //store local variables
-    const SharedData *sharedData = threadData->sharedData;
-    const int sharedStart = sharedData->start;
-    const int sharedEnd = sharedData->end;
-    MPointArray *sharedPoints = sharedData->points;
-    const MFloatArray *sharedWeights = sharedData->weights;
-    const float sharedEnv= sharedData->env;
-    const int sharedWidth = sharedData->width;
-    const float *sharedAmps = sharedData->amps;
-    const float *sharedFreqs = sharedData->freqs;
-    const float *sharedOffsets = sharedData->offsets;
-    const int sharedOctaves = sharedData->octaves;
-    const float sharedLacunarity = sharedData->lacunarity;
-    const float sharedPersistence = sharedData->persistence;
-    const MMatrix *sharedLocalToLocatorSpaceMat = sharedData->localToLocatorSpaceMat;
-    const MMatrix *sharedLocatorToLocalSpaceMat = sharedData->locatorToLocalSpaceMat;
+    //get attribute values, return if envelope is sufficiently near to 0
+    EvalSettings settings;
+    stat = getEvalSettings(dataBlock, settings);
+    CHECK_ERROR(stat, "Unable to get attribute values\n");
+    if (EPSILON >= settings.env)
+    {
+        return reportStatistics(dataBlock, settings, EVAL_PATH_PASS_THROUGH);
+    }
 
-    //get range of ids to work on
-    const int threadStartId = sharedStart + threadData->id * sharedWidth;
-    const int threadEndId = threadStartId + sharedWidth;
+    //predict the next frame during async playback
+    const double deformStart = traceBegin(settings.trace);
+    AsyncFrame asyncFrame;
+    prepareAsyncFrame(settings, asyncFrame);
 
-    //iterate through points within the range
-    float noiseInput[3];
-    float envTimesWeight;
-    MPoint *pos;
-    int i;
-    for (i = threadStartId; i < threadEndId && i <= sharedEnd; ++i)
+    //gather points and weights
+    double traceStart = traceBegin(settings.trace);
+    SharedData sharedData;
+    stat = prepareGeometry(dataBlock, geomIter, localToWorldMat, multiIndex, settings, sharedData);
+    CHECK_ERROR(stat, "Unable to prepare geometry\n");
+    ScratchArena *arena = scratchArena(multiIndex, settings.background);
+    sharedData.trace = settings.trace;
+    traceEnd(settings.trace, "prepareGeometry", traceStart, "points", sharedData.points->length());
+
+    //skip the noise evaluation if there is a cheaper way to the result
+    traceStart = traceBegin(settings.trace);
+    GeometryEval eval;
+    selectEvalPath(multiIndex, localToWorldMat, settings, asyncFrame, sharedData, eval);
+    traceEnd(settings.trace, "selectEvalPath", traceStart, "path", eval.path);
+
+    //use the task count learned for geometries of this size if tuning
+    const int numPoints = sharedData.points->length();
+    const int numTasks = settings.taskTuner ? settings.taskTuner->numTasks(numPoints, settings.numTasks) : settings.numTasks;
+    if (EVAL_PATH_FULL == eval.path)
     {
-        //get locator space position
-        pos = &((*sharedPoints)[i]);
-        *pos *= *sharedLocalToLocatorSpaceMat;
+        //split the points into one task per slice
+        const int chunkSize = static_cast<int>(std::ceil(numPoints / static_cast<double>(numTasks)));
+        TaskList taskList;
+        taskList.threadData = arena->reserveThreadData(numTasks);
+        taskList.numTasks = chunkSize > 0 ? appendTasks(&sharedData, chunkSize, taskList.threadData, 0) : 0;
+        assignNumaNodes(taskList.threadData, taskList.numTasks, sharedData.numNumaNodes);
 
-        //precompute some values
-        noiseInput[0] = sharedFreqs[0] * pos->x - sharedOffsets[0];
-        noiseInput[1] = sharedFreqs[1] * pos->y - sharedOffsets[1];
-        noiseInput[2] = sharedFreqs[2] * pos->z - sharedOffsets[2];
-        envTimesWeight = sharedEnv * (*sharedWeights)[i];
+        //start off the multi-threading functions, timing them for the tuner
+        traceStart = traceClock();
+        executeTasks(&taskList);
+        traceEnd(settings.trace, "parallelFor", traceStart, "tasks", taskList.numTasks);
+        if (settings.taskTuner)
+        {
+            settings.taskTuner->record(numPoints, numTasks, traceClock() - traceStart);
+        }
+    }
 
-        //calculate new position
-        pos->x += sharedAmps[0] * fbm_noise3(noiseInput[0], noiseInput[1], noiseInput[2], sharedOctaves, sharedPersistence, sharedLacunarity) * envTimesWeight;
-        pos->y += sharedAmps[1] * fbm_noise3(noiseInput[0] + 123, noiseInput[1] + 456, noiseInput[2] + 789, sharedOctaves, sharedPersistence, sharedLacunarity) * envTimesWeight;
-        pos->z += sharedAmps[2] * fbm_noise3(noiseInput[0] + 234, noiseInput[1] + 567, noiseInput[2] + 890, sharedOctaves, sharedPersistence, sharedLacunarity) * envTimesWeight;
+    //set all points
+    traceStart = traceBegin(settings.trace);
+    geomIter.setAllPositions(finishGeometry(multiIndex, settings, sharedData, eval));
+    traceEnd(settings.trace, "finishGeometry", traceStart, NULL, 0);
 
-        //convert back to local space
-        *pos *= *sharedLocatorToLocalSpaceMat;
+    //start computing the next frame in the background
+    if (eval.stagedSlot)
+    {
+        launchAsyncSlot(eval.stagedSlot, numTasks);
     }
 
-    return static_cast<MThreadRetVal>(0);
+    traceEnd(settings.trace, "deform", deformStart, "geometry", multiIndex);
+    flushTrace(settings);
+
+    return reportStatistics(dataBlock, settings, eval.path);
 }
 
-//task creation and execution method
-void createTasksAndExecute(void* data, MThreadRootTask* root)
+//compute method, deforms all geometries in a single parallel region when batching is on
+MStatus SkNoiseDeformerMT::compute(const MPlug& plug, MDataBlock& dataBlock)
 {
-    SharedData *sharedData = static_cast<SharedData*>(data);
+    MStatus stat = MS::kSuccess;
 
-    //store local variables
-    const int numTasks = sharedData->numTasks;
+    if (plug.attribute() != outputGeom)
+    {
+        return MPxDeformerNode::compute(plug, dataBlock);
+    }
 
-    //create array to store thread data for each task
-    ThreadData *threadData = new ThreadData[numTasks];
+    //fall back to the per-geometry deform calls unless batching is on and the node is active. The
+    //batch memory belongs to the foreground, so background evaluations fall back too.
+    MTime evaluationTime;
+    if (getEvaluationTime(dataBlock, evaluationTime))
+    {
+        return MPxDeformerNode::compute(plug, dataBlock);
+    }
+    MDataHandle batchGeometriesDataHandle = dataBlock.inputValue(batchGeometries, &stat);
+    CHECK_ERROR(stat, "Unable to get batchGeometries data handle\n");
+    MDataHandle nodeStateDataHandle = dataBlock.inputValue(state, &stat);
+    CHECK_ERROR(stat, "Unable to get nodeState data handle\n");
+    if (!batchGeometriesDataHandle.asBool() || 0 != nodeStateDataHandle.asShort())
+    {
+        return MPxDeformerNode::compute(plug, dataBlock);
+    }
 
-    //create tasks
-    int i;
-    for (i = 0; i < numTasks; ++i)
+    //get attribute values, let the base class pass the geometries through if envelope is near 0
+    EvalSettings settings;
+    stat = getEvalSettings(dataBlock, settings);
+    CHECK_ERROR(stat, "Unable to get attribute values\n");
+    if (EPSILON >= settings.env)
+    {
+        return MPxDeformerNode::compute(plug, dataBlock);
+    }
+
+    //predict the next frame during async playback
+    const double computeStart = traceBegin(settings.trace);
+    AsyncFrame asyncFrame;
+    prepareAsyncFrame(settings, asyncFrame);
+
+    if (!m_batchArena)
+    {
+        m_batchArena = new BatchArena();
+    }
+    std::vector<BatchGeometry> &geometries = m_batchArena->geometries;
+
+    //gather the points and weights of every input geometry
+    MObject thisObj = thisMObject();
+    MPlug outputGeomPlug(thisObj, outputGeom);
+    MArrayDataHandle inputArrayDataHandle = dataBlock.inputArrayValue(input, &stat);
+    CHECK_ERROR(stat, "Unable to get input array data handle\n");
+    unsigned int numGeometries = inputArrayDataHandle.elementCount();
+    geometries.resize(numGeometries);
+    int totalPoints = 0;
+    short path = EVAL_PATH_PASS_THROUGH;
+    unsigned int i;
+    for (i = 0; i < numGeometries; ++i)
+    {
+        stat = inputArrayDataHandle.jumpToArrayElement(i);
+        CHECK_ERROR(stat, "Unable to jump to input array element\n");
+        BatchGeometry &geometry = geometries[i];
+        geometry.multiIndex = inputArrayDataHandle.elementIndex();
+
+        MDataHandle inputDataHandle = inputArrayDataHandle.inputValue(&stat);
+        CHECK_ERROR(stat, "Unable to get input data handle\n");
+        MDataHandle inputGeomDataHandle = inputDataHandle.child(inputGeom);
+        geometry.groupId = inputDataHandle.child(groupId).asLong();
+
+        //copy the input geometry to the output before deforming it in place
+        MDataHandle outputGeomDataHandle = dataBlock.outputValue(outputGeomPlug.elementByLogicalIndex(geometry.multiIndex), &stat);
+        CHECK_ERROR(stat, "Unable to get outputGeom data handle\n");
+        outputGeomDataHandle.copy(inputGeomDataHandle);
+
+        //get the world matrix carried by the input geometry data, which is the matrix that the base
+        //class passes to deform, also for instanced shapes and inputs without a DAG path
+        const MMatrix localToWorldMat = inputGeomDataHandle.geometryTransformMatrix();
+
+        MItGeometry geomIter(outputGeomDataHandle, geometry.groupId, false, &stat);
+        CHECK_ERROR(stat, "Unable to create geometry iterator\n");
+        double traceStart = traceBegin(settings.trace);
+        stat = prepareGeometry(dataBlock, geomIter, localToWorldMat, geometry.multiIndex, settings, geometry.sharedData);
+        CHECK_ERROR(stat, "Unable to prepare geometry\n");
+        geometry.sharedData.trace = settings.trace;
+        traceEnd(settings.trace, "prepareGeometry", traceStart, "points", geometry.sharedData.points->length());
+
+        //skip the noise evaluation if there is a cheaper way to the result
+        traceStart = traceBegin(settings.trace);
+        selectEvalPath(geometry.multiIndex, localToWorldMat, settings, asyncFrame, geometry.sharedData, geometry.eval);
+        traceEnd(settings.trace, "selectEvalPath", traceStart, "path", geometry.eval.path);
+        if (EVAL_PATH_FULL == geometry.eval.path)
+        {
+            totalPoints += geometry.sharedData.points->length();
+        }
+        path = std::max(path, geometry.eval.path);
+    }
+
+    //build one combined work list, splitting every geometry into chunks of about the same size, with
+    //the task count learned for this total number of points if tuning
+    const int numTasks = settings.taskTuner ? settings.taskTuner->numTasks(totalPoints, settings.numTasks) : settings.numTasks;
+    const int chunkSize = std::max(1, static_cast<int>(std::ceil(totalPoints / static_cast<double>(numTasks))));
+    TaskList taskList;
+    taskList.threadData = m_batchArena->tasks.reserveThreadData(numTasks + numGeometries);
+    taskList.numTasks = 0;
+    for (i = 0; i < numGeometries; ++i)
+    {
+        if (EVAL_PATH_FULL == geometries[i].eval.path)
+        {
+            taskList.numTasks = appendTasks(&geometries[i].sharedData, chunkSize, taskList.threadData, taskList.numTasks);
+        }
+    }
+    assignNumaNodes(taskList.threadData, taskList.numTasks, settings.numaAware ? numaNodeCount() : 1);
+
+    //run all chunks in a single parallel region, timing them for the tuner
+    double traceStart = traceClock();
+    executeTasks(&taskList);
+    traceEnd(settings.trace, "parallelFor", traceStart, "tasks", taskList.numTasks);
+    if (settings.taskTuner && totalPoints > 0)
+    {
+        settings.taskTuner->record(totalPoints, numTasks, traceClock() - traceStart);
+    }
+
+    //start computing the next frame in the background
+    for (i = 0; i < numGeometries; ++i)
+    {
+        if (geometries[i].eval.stagedSlot)
+        {
+            launchAsyncSlot(geometries[i].eval.stagedSlot, numTasks);
+        }
+    }
+
+    //scatter the results back into the output geometries
+    traceStart = traceBegin(settings.trace);
+    for (i = 0; i < numGeometries; ++i)
     {
-        threadData[i].id = i;
-        threadData[i].sharedData = sharedData;
-        MThreadPool::createTask(threadTask, static_cast<void*>(&threadData[i]), root);
+        BatchGeometry &geometry = geometries[i];
+        MPlug outputGeomElementPlug = outputGeomPlug.elementByLogicalIndex(geometry.multiIndex);
+        MDataHandle outputGeomDataHandle = dataBlock.outputValue(outputGeomElementPlug, &stat);
+        CHECK_ERROR(stat, "Unable to get outputGeom data handle\n");
+        MItGeometry geomIter(outputGeomDataHandle, geometry.groupId, false, &stat);
+        CHECK_ERROR(stat, "Unable to create geometry iterator\n");
+        geomIter.setAllPositions(finishGeometry(geometry.multiIndex, settings, geometry.sharedData, geometry.eval));
+        dataBlock.setClean(outputGeomElementPlug);
     }
+    dataBlock.setClean(plug);
+    traceEnd(settings.trace, "finishGeometry", traceStart, NULL, 0);
 
-    //execute tasks in parallel region and wait for all to finish
-    MThreadPool::executeAndJoin(root);
+    traceEnd(settings.trace, "compute", computeStart, "geometries", numGeometries);
+    flushTrace(settings);
 
-    //delete array memory
-    delete [] threadData;
+    return reportStatistics(dataBlock, settings, path);
 }
 
-//main deform method
-MStatus SkNoiseDeformerMT::deform(MDataBlock& dataBlock,
-                                MItGeometry& geomIter,
-                                const MMatrix& localToWorldMat,
-                                unsigned int multiIndex)
+#if MAYA_API_VERSION >= 201600
+
+//the node only keeps per-node state, and the thread pool takes calls from several threads, so
+//different instances can be evaluated in parallel
+MPxNode::SchedulingType SkNoiseDeformerMT::schedulingType() const
+{
+    return MPxNode::kParallel;
+}
+
+//setDependentsDirty is not called under the evaluation manager, so the dirty plugs are looked at
+//here instead. If nothing but the envelope, the amplitude, the weights or the amplitude map are
+//dirty, the noise inputs are known to be unchanged and the last result can be rescaled without
+//hashing them. The per-vertex maps are gathered again if any of their sources are dirty.
+MStatus SkNoiseDeformerMT::preEvaluation(const MDGContext& context, const MEvaluationNode& evaluationNode)
 {
     MStatus stat = MS::kSuccess;
 
-    //get envelope value, return if sufficiently near to 0
-    MDataHandle envDataHandle = dataBlock.inputValue(envelope, &stat);
-    CHECK_ERROR(stat, "Unable to get envelope data handle\n");
-    float env = envDataHandle.asFloat();
-    if (EPSILON >= env)
+    m_scaleInputsOnly = false;
+    if (!context.isNormal())
     {
         return stat;
     }
 
-    //get attribute values
-    MDataHandle numTasksDataHandle = dataBlock.inputValue(numTasks, &stat);
-    CHECK_ERROR(stat, "Unable to get numTasks data handle\n");
-    int numTasks = numTasksDataHandle.asInt();
-
-    MDataHandle ampDataHandle = dataBlock.inputValue(amp, &stat);
-    CHECK_ERROR(stat, "Unable to get amplitude data handle\n");
-    float *amps = ampDataHandle.asFloat3();
+    MEvaluationNodeIterator dirtyIt = evaluationNode.iterator(&stat);
+    CHECK_ERROR(stat, "Unable to get dirty plug iterator\n");
+    bool scaleInputsOnly = true;
+    bool vertexMapDirty = false;
+    MPlug dirtyPlug;
+    MObject attr;
+    for (; !dirtyIt.isDone(); dirtyIt.next())
+    {
+        //the amplitude map scales the displacements too, but the frequency map does not
+        dirtyPlug = dirtyIt.plug();
+        if (isVertexMapSource(dirtyPlug))
+        {
+            vertexMapDirty = true;
+            if (dirtyPlug.attribute() != ampMap)
+            {
+                scaleInputsOnly = false;
+            }
+            continue;
+        }
 
-    MDataHandle freqDataHandle = dataBlock.inputValue(freq, &stat);
-    CHECK_ERROR(stat, "Unable to get frequency data handle\n");
-    float *freqs = freqDataHandle.asFloat3();
+        //climb to the top level attribute of array elements and compound children
+        while (dirtyPlug.isElement() || dirtyPlug.isChild())
+        {
+            dirtyPlug = dirtyPlug.isElement() ? dirtyPlug.array() : dirtyPlug.parent();
+        }
+        attr = dirtyPlug.attribute();
 
-    MDataHandle offsetDataHandle = dataBlock.inputValue(offset, &stat);
-    CHECK_ERROR(stat, "Unable to get offset data handle\n");
-    float *offsets = offsetDataHandle.asFloat3();
+        //outputs are dirtied along with any of the inputs
+        if (!(attr == envelope || attr == amp || attr == weightList
+              || attr == outputGeom || attr == scratchMemory || attr == frameCacheMemory
+              || attr == frameCacheError || attr == evalPath))
+        {
+            scaleInputsOnly = false;
+        }
+    }
+    if (vertexMapDirty)
+    {
+        ++m_vertexMapGeneration;
+    }
+    m_scaleInputsOnly = scaleInputsOnly;
 
-    MDataHandle octavesDataHandle = dataBlock.inputValue(octaves, &stat);
-    CHECK_ERROR(stat, "Unable to get octaves data handle\n");
-    int octaves = octavesDataHandle.asInt();
+    return stat;
+}
 
-    MDataHandle lacunarityDataHandle = dataBlock.inputValue(lacunarity, &stat);
-    CHECK_ERROR(stat, "Unable to get lacunarity data handle\n");
-    float lacunarity = lacunarityDataHandle.asFloat();
+//the dirty plugs only describe the evaluation that has just finished
+MStatus SkNoiseDeformerMT::postEvaluation(const MDGContext& context,
+                                          const MEvaluationNode& evaluationNode,
+                                          PostEvaluationType evalType)
+{
+    if (context.isNormal())
+    {
+        m_scaleInputsOnly = false;
+    }
+    return MPxDeformerNode::postEvaluation(context, evaluationNode, evalType);
+}
 
-    MDataHandle persistenceDataHandle = dataBlock.inputValue(persistence, &stat);
-    CHECK_ERROR(stat, "Unable to get persistence data handle\n");
-    float persistence = persistenceDataHandle.asFloat();
+#endif
 
-    MDataHandle locatorWorldSpaceDataHandle = dataBlock.inputValue(locatorWorldSpace, &stat);
-    CHECK_ERROR(stat, "Unable to get locatorWorldSpace data handle\n");
-    MMatrix locatorWorldSpaceMat = locatorWorldSpaceDataHandle.asMatrix();
+#if MAYA_API_VERSION >= 20200000
 
-    //precompute some transformation matrices
-    MMatrix localToLocatorSpaceMat = localToWorldMat * locatorWorldSpaceMat.inverse();
-    MMatrix locatorToLocalSpaceMat = locatorWorldSpaceMat * localToWorldMat.inverse();
+//the result only depends on the inputs at the evaluated time, so it can always be cached
+void SkNoiseDeformerMT::getCacheSetup(const MEvaluationNode& evaluationNode,
+                                      MNodeCacheDisablingInfo& disablingInfo,
+                                      MNodeCacheSetupInfo& cacheSetupInfo,
+                                      MObjectArray& monitoredAttributes) const
+{
+    MPxDeformerNode::getCacheSetup(evaluationNode, disablingInfo, cacheSetupInfo, monitoredAttributes);
+    cacheSetupInfo.setPreference(MNodeCacheSetupInfo::kWantToCacheByDefault, true);
+}
 
-    //read all points
-    MPointArray points;
-    geomIter.allPositions(points);
-    int numPoints = points.length();
+#endif
 
-    //store all weight values
-    MFloatArray weights(numPoints);
-    int index;
-    for (geomIter.reset(); !geomIter.isDone(); geomIter.next())
+//the learned task counts are node state rather than data block values, so that compute never writes
+//to a storable attribute; the internal learnedTasks attribute only hands them to the scene file
+bool SkNoiseDeformerMT::getInternalValue(const MPlug& plug, MDataHandle& dataHandle)
+{
+    if (plug == learnedTasks)
     {
-        index = geomIter.index();
-        weights.set(weightValue(dataBlock, multiIndex, index), index);
+        if (m_taskTuner)
+        {
+            m_learnedTasks = m_taskTuner->learned();
+        }
+        MStatus stat;
+        MFnIntArrayData learnedFn;
+        MObject learnedData = learnedFn.create(m_learnedTasks, &stat);
+        if (!stat)
+        {
+            return false;
+        }
+        dataHandle.set(learnedData);
+        return true;
     }
+    return MPxDeformerNode::getInternalValue(plug, dataHandle);
+}
 
-    //pack data into a struct
-    SharedData sharedData;
-    sharedData.start = 0;
-    sharedData.end = points.length() - 1;
-    sharedData.points = &points;
-    sharedData.weights = &weights;
-    sharedData.numTasks = numTasks;
-    sharedData.width = static_cast<int>(std::ceil((sharedData.end - sharedData.start + 1.0) / numTasks));
-    sharedData.env = env;
-    sharedData.amps = amps;
-    sharedData.freqs = freqs;
-    sharedData.offsets = offsets;
-    sharedData.octaves = octaves;
-    sharedData.lacunarity = lacunarity;
-    sharedData.persistence = persistence;
-    sharedData.localToLocatorSpaceMat = &localToLocatorSpaceMat;
-    sharedData.locatorToLocalSpaceMat = &locatorToLocalSpaceMat;
-
-    //create new parallel region and start off the multi-threading functions
-    MThreadPool::newParallelRegion(createTasksAndExecute, static_cast<void*>(&sharedData));
-
-    //set all points
-    geomIter.setAllPositions(points);
+//keeps the learned task counts read from the scene file until the task tuner is created
+bool SkNoiseDeformerMT::setInternalValue(const MPlug& plug, const MDataHandle& dataHandle)
+{
+    if (plug == learnedTasks)
+    {
+        MStatus stat;
+        MFnIntArrayData learnedFn(dataHandle.data(), &stat);
+        m_learnedTasks = stat ? learnedFn.array() : MIntArray();
+        return true;
+    }
+    return MPxDeformerNode::setInternalValue(plug, dataHandle);
+}
 
-    return stat;
+//the per-vertex maps are only gathered again once one of their sources has been dirtied
+MStatus SkNoiseDeformerMT::setDependentsDirty(const MPlug& plug, MPlugArray& plugArray)
+{
+    if (isVertexMapSource(plug))
+    {
+        ++m_vertexMapGeneration;
+    }
+    return MPxDeformerNode::setDependentsDirty(plug, plugArray);
 }
 
 //accessory locator setup method
@@ -422,6 +4107,10 @@ MStatus SkNoiseDeformerMT::initialize()
 
     MFnNumericAttribute nAttr;
     MFnMatrixAttribute mAttr;
+    MFnEnumAttribute eAttr;
+    MFnUnitAttribute uAttr;
+    MFnTypedAttribute tAttr;
+    MFnCompoundAttribute cAttr;
 
     //numTasks attr
     numTasks = nAttr.create("numTasks", "nt", MFnNumericData::kInt, 16, &stat);
@@ -430,6 +4119,41 @@ MStatus SkNoiseDeformerMT::initialize()
     stat = addAttribute(numTasks);
     CHECK_ERROR(stat, "Unable to add numTasks attribute\n");
 
+    //autoTasks attr (tune the task count, starting from numTasks, off by default)
+    autoTasks = nAttr.create("autoTasks", "ats", MFnNumericData::kBoolean, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create autoTasks attribute\n");
+    stat = addAttribute(autoTasks);
+    CHECK_ERROR(stat, "Unable to add autoTasks attribute\n");
+
+    //tunedTasks attr (output only, task count of the last evaluation)
+    tunedTasks = nAttr.create("tunedTasks", "tts", MFnNumericData::kInt, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create tunedTasks attribute\n");
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    stat = addAttribute(tunedTasks);
+    CHECK_ERROR(stat, "Unable to add tunedTasks attribute\n");
+
+    //learnedTasks attr (internal, the processor count followed by the learned task count of every
+    //size class, saved with the scene)
+    learnedTasks = tAttr.create("learnedTasks", "lts", MFnData::kIntArray, &stat);
+    CHECK_ERROR(stat, "Unable to create learnedTasks attribute\n");
+    tAttr.setHidden(true);
+    tAttr.setInternal(true);
+    stat = addAttribute(learnedTasks);
+    CHECK_ERROR(stat, "Unable to add learnedTasks attribute\n");
+
+    //numaAware attr (experimental, off by default)
+    numaAware = nAttr.create("numaAware", "numa", MFnNumericData::kBoolean, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create numaAware attribute\n");
+    stat = addAttribute(numaAware);
+    CHECK_ERROR(stat, "Unable to add numaAware attribute\n");
+
+    //batchGeometries attr
+    batchGeometries = nAttr.create("batchGeometries", "bg", MFnNumericData::kBoolean, 1, &stat);
+    CHECK_ERROR(stat, "Unable to create batchGeometries attribute\n");
+    stat = addAttribute(batchGeometries);
+    CHECK_ERROR(stat, "Unable to add batchGeometries attribute\n");
+
     //amplitude attr
     amp = nAttr.createPoint("amplitude", "amp", &stat);
     CHECK_ERROR(stat, "Unable to create amplitude attribute\n");
@@ -488,6 +4212,100 @@ MStatus SkNoiseDeformerMT::initialize()
     stat = attributeAffects(SkNoiseDeformerMT::persistence, SkNoiseDeformerMT::outputGeom);
     CHECK_ERROR(stat, "Unable to call attributeAffects from persistence to outputGeom");
 
+    //noiseType attr
+    noiseType = eAttr.create("noiseType", "nty", NOISE_TYPE_SIMPLEX, &stat);
+    CHECK_ERROR(stat, "Unable to create noiseType attribute\n");
+    eAttr.addField("Simplex", NOISE_TYPE_SIMPLEX);
+    eAttr.addField("Worley F1", NOISE_TYPE_WORLEY_F1);
+    eAttr.addField("Worley F2", NOISE_TYPE_WORLEY_F2);
+    eAttr.addField("Worley F2-F1", NOISE_TYPE_WORLEY_F2_MINUS_F1);
+    eAttr.setKeyable(true);
+    stat = addAttribute(noiseType);
+    CHECK_ERROR(stat, "Unable to add noiseType attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::noiseType, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from noiseType to outputGeom");
+
+    //fractalMode attr
+    fractalMode = eAttr.create("fractalMode", "frm", FRACTAL_MODE_FBM, &stat);
+    CHECK_ERROR(stat, "Unable to create fractalMode attribute\n");
+    eAttr.addField("fBm", FRACTAL_MODE_FBM);
+    eAttr.addField("Turbulence", FRACTAL_MODE_TURBULENCE);
+    eAttr.addField("Billow", FRACTAL_MODE_BILLOW);
+    eAttr.addField("Ridged", FRACTAL_MODE_RIDGED);
+    eAttr.setKeyable(true);
+    stat = addAttribute(fractalMode);
+    CHECK_ERROR(stat, "Unable to add fractalMode attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::fractalMode, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from fractalMode to outputGeom");
+
+    //warpAmount attr (0 turns the domain warp off)
+    warpAmount = nAttr.create("warpAmount", "wpa", MFnNumericData::kFloat, 0.0, &stat);
+    CHECK_ERROR(stat, "Unable to create warpAmount attribute\n");
+    nAttr.setKeyable(true);
+    stat = addAttribute(warpAmount);
+    CHECK_ERROR(stat, "Unable to add warpAmount attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::warpAmount, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from warpAmount to outputGeom");
+
+    //warpFrequency attr (relative to the noise frequency)
+    warpFrequency = nAttr.create("warpFrequency", "wpf", MFnNumericData::kFloat, 1.0, &stat);
+    CHECK_ERROR(stat, "Unable to create warpFrequency attribute\n");
+    nAttr.setKeyable(true);
+    stat = addAttribute(warpFrequency);
+    CHECK_ERROR(stat, "Unable to add warpFrequency attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::warpFrequency, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from warpFrequency to outputGeom");
+
+    //warpOctaves attr
+    warpOctaves = nAttr.create("warpOctaves", "wpo", MFnNumericData::kInt, 2, &stat);
+    CHECK_ERROR(stat, "Unable to create warpOctaves attribute\n");
+    nAttr.setMin(1);
+    nAttr.setKeyable(true);
+    stat = addAttribute(warpOctaves);
+    CHECK_ERROR(stat, "Unable to add warpOctaves attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::warpOctaves, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from warpOctaves to outputGeom");
+
+    //ampMap attr (paintable, per vertex)
+    ampMap = tAttr.create("ampMap", "apm", MFnData::kDoubleArray, &stat);
+    CHECK_ERROR(stat, "Unable to create ampMap attribute\n");
+
+    //freqMap attr (paintable, per vertex)
+    freqMap = tAttr.create("freqMap", "fqm", MFnData::kDoubleArray, &stat);
+    CHECK_ERROR(stat, "Unable to create freqMap attribute\n");
+
+    //vertexMapList attr (one element per input geometry)
+    vertexMapList = cAttr.create("vertexMapList", "vml", &stat);
+    CHECK_ERROR(stat, "Unable to create vertexMapList attribute\n");
+    cAttr.addChild(ampMap);
+    cAttr.addChild(freqMap);
+    cAttr.setArray(true);
+    cAttr.setUsesArrayDataBuilder(true);
+    stat = addAttribute(vertexMapList);
+    CHECK_ERROR(stat, "Unable to add vertexMapList attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::vertexMapList, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from vertexMapList to outputGeom");
+    stat = attributeAffects(SkNoiseDeformerMT::ampMap, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from ampMap to outputGeom");
+    stat = attributeAffects(SkNoiseDeformerMT::freqMap, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from freqMap to outputGeom");
+
+    //ampColorSet attr (name of a color set on the input mesh, used instead of ampMap)
+    ampColorSet = tAttr.create("ampColorSet", "acs", MFnData::kString, &stat);
+    CHECK_ERROR(stat, "Unable to create ampColorSet attribute\n");
+    stat = addAttribute(ampColorSet);
+    CHECK_ERROR(stat, "Unable to add ampColorSet attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::ampColorSet, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from ampColorSet to outputGeom");
+
+    //freqColorSet attr (name of a color set on the input mesh, used instead of freqMap)
+    freqColorSet = tAttr.create("freqColorSet", "fcs", MFnData::kString, &stat);
+    CHECK_ERROR(stat, "Unable to create freqColorSet attribute\n");
+    stat = addAttribute(freqColorSet);
+    CHECK_ERROR(stat, "Unable to add freqColorSet attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::freqColorSet, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from freqColorSet to outputGeom");
+
     //locatorWorldSpace attr
     locatorWorldSpace = mAttr.create("locatorWorldSpace", "locsp", MFnMatrixAttribute::kDouble, &stat);
     CHECK_ERROR(stat, "Unable to create locatorWorldSpace attribute\n");
@@ -498,9 +4316,508 @@ MStatus SkNoiseDeformerMT::initialize()
     stat = attributeAffects(SkNoiseDeformerMT::locatorWorldSpace, SkNoiseDeformerMT::outputGeom);
     CHECK_ERROR(stat, "Unable to call attributeAffects from locatorWorldSpace to outputGeom");
 
+    //reproducible attr (only allows evaluation paths that give bit-identical results)
+    reproducible = nAttr.create("reproducible", "rep", MFnNumericData::kBoolean, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create reproducible attribute\n");
+    stat = addAttribute(reproducible);
+    CHECK_ERROR(stat, "Unable to add reproducible attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::reproducible, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from reproducible to outputGeom");
+
+    //lodMode attr
+    lodMode = eAttr.create("lodMode", "lodm", LOD_MODE_OFF, &stat);
+    CHECK_ERROR(stat, "Unable to create lodMode attribute\n");
+    eAttr.addField("Off", LOD_MODE_OFF);
+    eAttr.addField("Interactive", LOD_MODE_INTERACTIVE);
+    eAttr.setChannelBox(true);
+    stat = addAttribute(lodMode);
+    CHECK_ERROR(stat, "Unable to add lodMode attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::lodMode, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from lodMode to outputGeom");
+
+    //lodMethod attr
+    lodMethod = eAttr.create("lodMethod", "lodmt", LOD_METHOD_REDUCED_OCTAVES, &stat);
+    CHECK_ERROR(stat, "Unable to create lodMethod attribute\n");
+    eAttr.addField("Reduced Octaves", LOD_METHOD_REDUCED_OCTAVES);
+    eAttr.addField("Baked Grid", LOD_METHOD_BAKED_GRID);
+    eAttr.setChannelBox(true);
+    stat = addAttribute(lodMethod);
+    CHECK_ERROR(stat, "Unable to add lodMethod attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::lodMethod, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from lodMethod to outputGeom");
+
+    //lodOctaves attr
+    lodOctaves = nAttr.create("lodOctaves", "lodo", MFnNumericData::kInt, 1, &stat);
+    CHECK_ERROR(stat, "Unable to create lodOctaves attribute\n");
+    nAttr.setMin(1);
+    stat = addAttribute(lodOctaves);
+    CHECK_ERROR(stat, "Unable to add lodOctaves attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::lodOctaves, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from lodOctaves to outputGeom");
+
+    //lodGridResolution attr
+    lodGridResolution = nAttr.create("lodGridResolution", "lodgr", MFnNumericData::kInt, 16, &stat);
+    CHECK_ERROR(stat, "Unable to create lodGridResolution attribute\n");
+    nAttr.setMin(2);
+    stat = addAttribute(lodGridResolution);
+    CHECK_ERROR(stat, "Unable to add lodGridResolution attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::lodGridResolution, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from lodGridResolution to outputGeom");
+
+    //scratchMemory attr (output only, in MB)
+    scratchMemory = nAttr.create("scratchMemory", "scm", MFnNumericData::kFloat, 0.0, &stat);
+    CHECK_ERROR(stat, "Unable to create scratchMemory attribute\n");
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    stat = addAttribute(scratchMemory);
+    CHECK_ERROR(stat, "Unable to add scratchMemory attribute\n");
+
+    //falloffShape attr
+    falloffShape = eAttr.create("falloffShape", "fos", FALLOFF_SHAPE_NONE, &stat);
+    CHECK_ERROR(stat, "Unable to create falloffShape attribute\n");
+    eAttr.addField("None", FALLOFF_SHAPE_NONE);
+    eAttr.addField("Sphere", FALLOFF_SHAPE_SPHERE);
+    eAttr.addField("Box", FALLOFF_SHAPE_BOX);
+    eAttr.setKeyable(true);
+    stat = addAttribute(falloffShape);
+    CHECK_ERROR(stat, "Unable to add falloffShape attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::falloffShape, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from falloffShape to outputGeom");
+
+    //falloffRadius attr (in locator space)
+    falloffRadius = nAttr.create("falloffRadius", "for", MFnNumericData::kFloat, 1.0, &stat);
+    CHECK_ERROR(stat, "Unable to create falloffRadius attribute\n");
+    nAttr.setMin(0.0);
+    nAttr.setKeyable(true);
+    stat = addAttribute(falloffRadius);
+    CHECK_ERROR(stat, "Unable to add falloffRadius attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::falloffRadius, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from falloffRadius to outputGeom");
+
+    //falloffSmoothness attr (fraction of the radius over which the noise fades out)
+    falloffSmoothness = nAttr.create("falloffSmoothness", "fosm", MFnNumericData::kFloat, 0.5, &stat);
+    CHECK_ERROR(stat, "Unable to create falloffSmoothness attribute\n");
+    nAttr.setMin(0.0);
+    nAttr.setMax(1.0);
+    nAttr.setKeyable(true);
+    stat = addAttribute(falloffSmoothness);
+    CHECK_ERROR(stat, "Unable to add falloffSmoothness attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::falloffSmoothness, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from falloffSmoothness to outputGeom");
+
+    //tileable attr
+    tileable = nAttr.create("tileable", "tl", MFnNumericData::kBoolean, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create tileable attribute\n");
+    stat = addAttribute(tileable);
+    CHECK_ERROR(stat, "Unable to add tileable attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::tileable, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from tileable to outputGeom");
+
+    //tilePeriod attr (in noise space units, 0 for no repeat)
+    tilePeriod = nAttr.create("tilePeriod", "tp", MFnNumericData::k3Int, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create tilePeriod attribute\n");
+    nAttr.setMin(0, 0, 0);
+    stat = addAttribute(tilePeriod);
+    CHECK_ERROR(stat, "Unable to add tilePeriod attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::tilePeriod, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from tilePeriod to outputGeom");
+
+    //loopFrames attr (0 for no time loop)
+    loopFrames = nAttr.create("loopFrames", "lpf", MFnNumericData::kInt, 48, &stat);
+    CHECK_ERROR(stat, "Unable to create loopFrames attribute\n");
+    nAttr.setMin(0);
+    stat = addAttribute(loopFrames);
+    CHECK_ERROR(stat, "Unable to add loopFrames attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::loopFrames, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from loopFrames to outputGeom");
+
+    //loopPeriod attr (noise space units travelled along the time axis in one loop)
+    loopPeriod = nAttr.create("loopPeriod", "lpp", MFnNumericData::kInt, 2, &stat);
+    CHECK_ERROR(stat, "Unable to create loopPeriod attribute\n");
+    nAttr.setMin(1);
+    stat = addAttribute(loopPeriod);
+    CHECK_ERROR(stat, "Unable to add loopPeriod attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::loopPeriod, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from loopPeriod to outputGeom");
+
+    //time attr
+    time = uAttr.create("time", "tm", MFnUnitAttribute::kTime, 0.0, &stat);
+    CHECK_ERROR(stat, "Unable to create time attribute\n");
+    stat = addAttribute(time);
+    CHECK_ERROR(stat, "Unable to add time attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::time, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from time to outputGeom");
+
+    //spatialReorder attr
+    spatialReorder = nAttr.create("spatialReorder", "sro", MFnNumericData::kBoolean, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create spatialReorder attribute\n");
+    stat = addAttribute(spatialReorder);
+    CHECK_ERROR(stat, "Unable to add spatialReorder attribute\n");
+
+    //latticeCacheOctaves attr
+    latticeCacheOctaves = nAttr.create("latticeCacheOctaves", "lco", MFnNumericData::kInt, 2, &stat);
+    CHECK_ERROR(stat, "Unable to create latticeCacheOctaves attribute\n");
+    nAttr.setMin(0);
+    stat = addAttribute(latticeCacheOctaves);
+    CHECK_ERROR(stat, "Unable to add latticeCacheOctaves attribute\n");
+
+    //asyncPlayback attr
+    asyncPlayback = nAttr.create("asyncPlayback", "asp", MFnNumericData::kBoolean, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create asyncPlayback attribute\n");
+    stat = addAttribute(asyncPlayback);
+    CHECK_ERROR(stat, "Unable to add asyncPlayback attribute\n");
+
+    //frameCache attr
+    frameCache = eAttr.create("frameCache", "fc", FRAME_CACHE_OFF, &stat);
+    CHECK_ERROR(stat, "Unable to create frameCache attribute\n");
+    eAttr.addField("Off", FRAME_CACHE_OFF);
+    eAttr.addField("Float", FRAME_CACHE_FLOAT);
+    eAttr.addField("Half", FRAME_CACHE_HALF);
+    eAttr.addField("Fixed 16", FRAME_CACHE_FIXED16);
+    stat = addAttribute(frameCache);
+    CHECK_ERROR(stat, "Unable to add frameCache attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::frameCache, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from frameCache to outputGeom");
+
+    //frameCacheBudget attr (in MB)
+    frameCacheBudget = nAttr.create("frameCacheBudget", "fcb", MFnNumericData::kFloat, 1024.0, &stat);
+    CHECK_ERROR(stat, "Unable to create frameCacheBudget attribute\n");
+    nAttr.setMin(0.0);
+    stat = addAttribute(frameCacheBudget);
+    CHECK_ERROR(stat, "Unable to add frameCacheBudget attribute\n");
+
+    //frameCacheMemory attr (output only, in MB)
+    frameCacheMemory = nAttr.create("frameCacheMemory", "fcm", MFnNumericData::kFloat, 0.0, &stat);
+    CHECK_ERROR(stat, "Unable to create frameCacheMemory attribute\n");
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    stat = addAttribute(frameCacheMemory);
+    CHECK_ERROR(stat, "Unable to add frameCacheMemory attribute\n");
+
+    //frameCacheError attr (output only, largest cached displacement error relative to the amplitude)
+    frameCacheError = nAttr.create("frameCacheError", "fce", MFnNumericData::kFloat, 0.0, &stat);
+    CHECK_ERROR(stat, "Unable to create frameCacheError attribute\n");
+    nAttr.setStorable(false);
+    nAttr.setWritable(false);
+    stat = addAttribute(frameCacheError);
+    CHECK_ERROR(stat, "Unable to add frameCacheError attribute\n");
+
+    //incrementalUpdate attr (off by default, it hashes the noise inputs of every evaluation)
+    incrementalUpdate = nAttr.create("incrementalUpdate", "iu", MFnNumericData::kBoolean, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create incrementalUpdate attribute\n");
+    stat = addAttribute(incrementalUpdate);
+    CHECK_ERROR(stat, "Unable to add incrementalUpdate attribute\n");
+
+    //evalPath attr (output only, how the last result was obtained)
+    evalPath = eAttr.create("evalPath", "evp", EVAL_PATH_PASS_THROUGH, &stat);
+    CHECK_ERROR(stat, "Unable to create evalPath attribute\n");
+    eAttr.addField("Pass Through", EVAL_PATH_PASS_THROUGH);
+    eAttr.addField("Reuse", EVAL_PATH_REUSE);
+    eAttr.addField("Rescale", EVAL_PATH_RESCALE);
+    eAttr.addField("Frame Cache", EVAL_PATH_FRAME_CACHE);
+    eAttr.addField("Async", EVAL_PATH_ASYNC);
+    eAttr.addField("Motion Blur", EVAL_PATH_MOTION_BLUR);
+    eAttr.addField("Full", EVAL_PATH_FULL);
+    eAttr.setStorable(false);
+    eAttr.setWritable(false);
+    stat = addAttribute(evalPath);
+    CHECK_ERROR(stat, "Unable to add evalPath attribute\n");
+
+    //motionBlurSamples attr (time samples per frame that are deformed together, 1 for off)
+    motionBlurSamples = nAttr.create("motionBlurSamples", "mbs", MFnNumericData::kInt, 1, &stat);
+    CHECK_ERROR(stat, "Unable to create motionBlurSamples attribute\n");
+    nAttr.setMin(1);
+    nAttr.setMax(MOTION_BLUR_MAX_SAMPLES);
+    stat = addAttribute(motionBlurSamples);
+    CHECK_ERROR(stat, "Unable to add motionBlurSamples attribute\n");
+
+    //motionBlurShutter attr (in frames, centred on the frame)
+    motionBlurShutter = nAttr.create("motionBlurShutter", "mbsh", MFnNumericData::kDouble, 0.5, &stat);
+    CHECK_ERROR(stat, "Unable to create motionBlurShutter attribute\n");
+    nAttr.setMin(0.0);
+    stat = addAttribute(motionBlurShutter);
+    CHECK_ERROR(stat, "Unable to add motionBlurShutter attribute\n");
+
+    //traceFile attr (base path of the trace files, tracing is off if empty)
+    traceFile = tAttr.create("traceFile", "trf", MFnData::kString, &stat);
+    CHECK_ERROR(stat, "Unable to create traceFile attribute\n");
+    tAttr.setUsedAsFilename(true);
+    stat = addAttribute(traceFile);
+    CHECK_ERROR(stat, "Unable to add traceFile attribute\n");
+
+    //traceEvaluations attr (number of evaluations written to each trace file)
+    traceEvaluations = nAttr.create("traceEvaluations", "tre", MFnNumericData::kInt, 1, &stat);
+    CHECK_ERROR(stat, "Unable to create traceEvaluations attribute\n");
+    nAttr.setMin(1);
+    stat = addAttribute(traceEvaluations);
+    CHECK_ERROR(stat, "Unable to add traceEvaluations attribute\n");
+
+    //lodRefresh attr (dirtied internally to evaluate again, exactly once a LOD result is refined, or
+    //to keep the inputs of the current time for skNoiseMotionBlur)
+    lodRefresh = nAttr.create("lodRefresh", "lodrf", MFnNumericData::kInt, 0, &stat);
+    CHECK_ERROR(stat, "Unable to create lodRefresh attribute\n");
+    nAttr.setStorable(false);
+    nAttr.setHidden(true);
+    stat = addAttribute(lodRefresh);
+    CHECK_ERROR(stat, "Unable to add lodRefresh attribute\n");
+    stat = attributeAffects(SkNoiseDeformerMT::lodRefresh, SkNoiseDeformerMT::outputGeom);
+    CHECK_ERROR(stat, "Unable to call attributeAffects from lodRefresh to outputGeom");
+
     return stat;
 }
 
+//---------skNoiseEval command-------------
+
+MString SkNoiseEvalCmd::commandName("skNoiseEval");
+
+//a range of the query positions of one skNoiseEval call
+typedef struct
+{
+    const NoiseQuery *query;
+    const double *positions;
+    float *results;
+    int start;
+    int end;
+} NoiseEvalChunk;
+
+static void runNoiseEvalChunk(void *data)
+{
+    NoiseEvalChunk *chunk = static_cast<NoiseEvalChunk*>(data);
+    evaluateNoiseQuery(*chunk->query, chunk->positions, chunk->start, chunk->end, chunk->results);
+}
+
+//reads count numbers following the flag at index i of the argument list
+static MStatus getFlagValues(const MArgList& args, unsigned int& i, double *values, unsigned int count)
+{
+    MStatus stat = MS::kSuccess;
+    unsigned int j;
+    if (i + count >= args.length())
+    {
+        return MS::kInvalidParameter;
+    }
+    for (j = 0; j < count; ++j)
+    {
+        values[j] = args.asDouble(++i, &stat);
+        if (!stat)
+        {
+            return stat;
+        }
+    }
+    return stat;
+}
+
+//command method. The arguments are parsed by hand since the number of query positions is not
+//fixed: every argument that is not a flag or a flag value is a coordinate.
+MStatus SkNoiseEvalCmd::doIt(const MArgList& args)
+{
+    MStatus stat = MS::kSuccess;
+
+    //defaults of the deformer attributes
+    NoiseQuery query;
+    query.freqs[0] = query.freqs[1] = query.freqs[2] = 1.0f;
+    query.offsets[0] = query.offsets[1] = query.offsets[2] = 0.0f;
+    query.octaves = 1;
+    query.persistence = 0.5f;
+    query.lacunarity = 2.0f;
+    query.fractalMode = FRACTAL_MODE_FBM;
+    query.noiseType = NOISE_TYPE_SIMPLEX;
+    query.warp.amount = 0.0f;
+    query.warp.freq = 1.0f;
+    query.warp.octaves = 2;
+    int numTasks = 16;
+
+    std::vector<double> positions;
+    positions.reserve(args.length());
+    double values[3];
+    MString arg;
+    unsigned int i;
+    for (i = 0; i < args.length(); ++i)
+    {
+        arg = args.asString(i, &stat);
+        if (!stat || 0 == arg.length() || '-' != arg.asChar()[0] || arg.isDouble())
+        {
+            positions.push_back(args.asDouble(i, &stat));
+            CHECK_ERROR(stat, "Query positions must be numbers\n");
+            continue;
+        }
+
+        if (arg == "-f" || arg == "-frequency")
+        {
+            stat = getFlagValues(args, i, values, 3);
+            query.freqs[0] = static_cast<float>(values[0]);
+            query.freqs[1] = static_cast<float>(values[1]);
+            query.freqs[2] = static_cast<float>(values[2]);
+        }
+        else if (arg == "-o" || arg == "-offset")
+        {
+            stat = getFlagValues(args, i, values, 3);
+            query.offsets[0] = static_cast<float>(values[0]);
+            query.offsets[1] = static_cast<float>(values[1]);
+            query.offsets[2] = static_cast<float>(values[2]);
+        }
+        else if (arg == "-oc" || arg == "-octaves")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.octaves = static_cast<int>(values[0]);
+        }
+        else if (arg == "-p" || arg == "-persistence")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.persistence = static_cast<float>(values[0]);
+        }
+        else if (arg == "-l" || arg == "-lacunarity")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.lacunarity = static_cast<float>(values[0]);
+        }
+        else if (arg == "-fm" || arg == "-fractalMode")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.fractalMode = static_cast<int>(values[0]);
+        }
+        else if (arg == "-nty" || arg == "-noiseType")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.noiseType = static_cast<int>(values[0]);
+        }
+        else if (arg == "-wpa" || arg == "-warpAmount")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.warp.amount = static_cast<float>(values[0]);
+        }
+        else if (arg == "-wpf" || arg == "-warpFrequency")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.warp.freq = static_cast<float>(values[0]);
+        }
+        else if (arg == "-wpo" || arg == "-warpOctaves")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            query.warp.octaves = static_cast<int>(values[0]);
+        }
+        else if (arg == "-nt" || arg == "-numTasks")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            numTasks = static_cast<int>(values[0]);
+        }
+        else
+        {
+            stat = MS::kInvalidParameter;
+        }
+        CHECK_ERROR(stat, "Invalid flag or flag value: " + arg + "\n");
+    }
+
+    if (0 != positions.size() % 3)
+    {
+        MGlobal::displayError("[" + commandName + "] The query positions must be a flat list of x y z values");
+        return MS::kInvalidParameter;
+    }
+    if (query.octaves < 1 || (query.warp.amount != 0.0f && query.warp.octaves < 1))
+    {
+        MGlobal::displayError("[" + commandName + "] octaves and warpOctaves must be at least 1");
+        return MS::kInvalidParameter;
+    }
+
+    //split the positions into one chunk per task and evaluate them in parallel
+    const int numPoints = static_cast<int>(positions.size() / 3);
+    std::vector<float> results(positions.size());
+    std::vector<NoiseEvalChunk> chunks;
+    if (numPoints > 0)
+    {
+        const int chunkSize = static_cast<int>(std::ceil(numPoints / static_cast<double>(std::max(1, numTasks))));
+        NoiseEvalChunk chunk;
+        chunk.query = &query;
+        chunk.positions = &positions[0];
+        chunk.results = &results[0];
+        for (chunk.start = 0; chunk.start < numPoints; chunk.start = chunk.end)
+        {
+            chunk.end = std::min(chunk.start + chunkSize, numPoints);
+            chunks.push_back(chunk);
+        }
+        if (!parallelInit())
+        {
+            MGlobal::displayError("[" + commandName + "] Unable to create thread pool");
+            return MS::kFailure;
+        }
+        parallelFor(static_cast<int>(chunks.size()), runNoiseEvalChunk, &chunks[0], sizeof(NoiseEvalChunk));
+        parallelRelease();
+    }
+
+    //return a flat list of the three channels of every position
+    MDoubleArray resultArray;
+    resultArray.setLength(static_cast<unsigned int>(results.size()));
+    for (i = 0; i < results.size(); ++i)
+    {
+        resultArray[i] = results[i];
+    }
+    setResult(resultArray);
+
+    return stat;
+}
+
+//creator function
+void* SkNoiseEvalCmd::creator()
+{
+    return new SkNoiseEvalCmd();
+}
+
+//---------skNoiseMotionBlur command-------------
+
+MString SkNoiseMotionBlurCmd::commandName("skNoiseMotionBlur");
+
+//command method: skNoiseMotionBlur [-index multiIndex] deformerName
+MStatus SkNoiseMotionBlurCmd::doIt(const MArgList& args)
+{
+    MStatus stat = MS::kSuccess;
+
+    unsigned int multiIndex = 0;
+    MString nodeName;
+    double values[1];
+    MString arg;
+    unsigned int i;
+    for (i = 0; i < args.length(); ++i)
+    {
+        arg = args.asString(i, &stat);
+        CHECK_ERROR(stat, "Invalid argument\n");
+        if (arg == "-i" || arg == "-index")
+        {
+            stat = getFlagValues(args, i, values, 1);
+            CHECK_ERROR(stat, "Invalid flag or flag value: " + arg + "\n");
+            multiIndex = static_cast<unsigned int>(values[0]);
+        }
+        else
+        {
+            nodeName = arg;
+        }
+    }
+
+    MSelectionList selection;
+    MObject nodeObj;
+    stat = selection.add(nodeName);
+    CHECK_ERROR(stat, "Unable to find the deformer: " + nodeName + "\n");
+    stat = selection.getDependNode(0, nodeObj);
+    CHECK_ERROR(stat, "Unable to find the deformer: " + nodeName + "\n");
+    MFnDependencyNode nodeFn(nodeObj);
+    if (nodeFn.typeId() != SkNoiseDeformerMT::nodeId)
+    {
+        MGlobal::displayError("[" + commandName + "] " + nodeName + " is not a " + nodeType + " node");
+        return MS::kInvalidParameter;
+    }
+
+    MDoubleArray resultArray;
+    stat = static_cast<SkNoiseDeformerMT*>(nodeFn.userNode())->deformMotionBlurSamples(multiIndex, resultArray);
+    CHECK_ERROR(stat, "Unable to deform the motion blur samples\n");
+    setResult(resultArray);
+
+    return stat;
+}
+
+//creator function
+void* SkNoiseMotionBlurCmd::creator()
+{
+    return new SkNoiseMotionBlurCmd();
+}
+
 //init plugin
 MStatus initializePlugin(MObject obj)
 {
@@ -508,6 +4825,18 @@ MStatus initializePlugin(MObject obj)
     MFnPlugin plugin(obj, "Skeel Lee", nodeVersion.asChar(), "Any");
     stat = plugin.registerNode(nodeType, SkNoiseDeformerMT::nodeId, SkNoiseDeformerMT::creator, SkNoiseDeformerMT::initialize, MPxNode::kDeformerNode);
     CHECK_ERROR(stat, "Failed to register node: " + nodeType + "\n")
+    stat = plugin.registerCommand(SkNoiseEvalCmd::commandName, SkNoiseEvalCmd::creator);
+    CHECK_ERROR(stat, "Failed to register command: " + SkNoiseEvalCmd::commandName + "\n")
+    stat = plugin.registerCommand(SkNoiseMotionBlurCmd::commandName, SkNoiseMotionBlurCmd::creator);
+    CHECK_ERROR(stat, "Failed to register command: " + SkNoiseMotionBlurCmd::commandName + "\n")
+
+    //read the NUMA topology here, so that the worker threads of the first compute never race to
+    //initialize it
+    numaNodeCount();
+
+    //let the per-vertex maps be painted with the artisan attribute paint tool
+    MGlobal::executeCommand("makePaintable -attrType \"doubleArray\" " + nodeType + " ampMap");
+    MGlobal::executeCommand("makePaintable -attrType \"doubleArray\" " + nodeType + " freqMap");
     return stat;
 }
 
@@ -516,7 +4845,13 @@ MStatus uninitializePlugin(MObject obj)
 {
     MStatus stat;
     MFnPlugin plugin(obj);
+    MGlobal::executeCommand("makePaintable -remove " + nodeType + " ampMap");
+    MGlobal::executeCommand("makePaintable -remove " + nodeType + " freqMap");
     stat = plugin.deregisterNode(SkNoiseDeformerMT::nodeId);
     CHECK_ERROR(stat, "Failed to register node: " + nodeType + "\n")
+    stat = plugin.deregisterCommand(SkNoiseEvalCmd::commandName);
+    CHECK_ERROR(stat, "Failed to deregister command: " + SkNoiseEvalCmd::commandName + "\n")
+    stat = plugin.deregisterCommand(SkNoiseMotionBlurCmd::commandName);
+    CHECK_ERROR(stat, "Failed to deregister command: " + SkNoiseMotionBlurCmd::commandName + "\n")
     return stat;
 }
@@ -68,6 +68,178 @@
  * 5) Move/rotate/scale the accessory locator to transform the noise space, as
  * desired
  *
+ * 6) On dense meshes, set lodMode to Interactive so that the deformer uses a
+ * cheaper approximation (reduced octaves or a baked noise grid, chosen with
+ * lodMethod) while the locator or the noise attributes are being dragged. A
+ * geometry counts as being manipulated while it is evaluated again at the
+ * same time within a quarter of a second of its last evaluation, so single
+ * channel box edits, frame steps, playblasts and renders stay exact. The exact
+ * result is computed again once the mouse is released, or once the geometry
+ * has not been evaluated for a quarter of a second, so an approximation never
+ * stays on screen.
+ *
+ * 7) To limit the noise to a region, set falloffShape to Sphere or Box. The
+ * volume is centered on the accessory locator and follows its transform, with
+ * falloffRadius as the sphere radius or the box half-size, and
+ * falloffSmoothness as the fraction of it over which the noise fades out.
+ * Points outside the volume are skipped without evaluating any noise.
+ *
+ * 8) On meshes whose vertex order is spatially random (e.g. scans or merged
+ * meshes), turn on spatialReorder so that the points are evaluated in Z-order
+ * (Morton order) instead. Each task then works on a spatially compact set of
+ * points, which is kinder to the caches. The order is computed once and reused
+ * as long as the number of points does not change. Gathering the points into
+ * that order and scattering them back has a cost of its own, which is not
+ * repaid when all the points fit into the caches anyway, so compare both
+ * settings with "skNoiseBench -order" on the target machine first.
+ *
+ * 9) latticeCacheOctaves sets how many of the lowest octaves look up their
+ * lattice gradients through a small per-task cache. Dense meshes revisit the
+ * same lattice cells a lot at those octaves, especially with spatialReorder
+ * on. The results are the same whatever the value, so it can be set to 0 if it
+ * does not help on a particular mesh.
+ *
+ * 10) Turn on asyncPlayback to overlap the noise evaluation with the rest of
+ * the scene during playback. While frame N is being shown, frame N+1 (in the
+ * direction of playback) is computed on background threads from the inputs of
+ * frame N and the noise attributes at frame N+1, which are read when the time
+ * changes to frame N, before it is evaluated. It is used only if a 64-bit
+ * hash of the inputs at frame N+1 matches the one it was computed from,
+ * otherwise the frame is computed synchronously as usual. A changed input
+ * could only go unnoticed through a hash collision, which is practically
+ * impossible, but asyncPlayback is still best left off for final renders.
+ *
+ * 11) Set frameCache to keep the noise displacements of every evaluated frame
+ * in memory, up to frameCacheBudget MB, so that frames that are played again
+ * with the same inputs skip the noise evaluation. Float keeps the full
+ * precision, while Half (fp16) and Fixed 16 use half the memory. The largest
+ * error of the cached displacements, relative to the amplitude, is shown in
+ * frameCacheError. The cache is not used when reproducible is on.
+ *
+ * 12) With incrementalUpdate on, the deformer keeps the displacements of its
+ * last full evaluation. When only the envelope, the amplitude or the weights
+ * change afterwards (e.g. while painting weights or dragging the envelope),
+ * the displacements are rescaled instead of evaluating the noise again. It is
+ * off by default, since while it is on every evaluation also hashes the input
+ * points with the other noise inputs and every full one copies them, which
+ * costs more than it saves during playback. Under the evaluation manager, the
+ * hash is skipped when only those scaling inputs are dirty. evalPath shows how
+ * the last result was obtained: Pass Through, Reuse (nothing that matters
+ * changed), Rescale, Frame Cache, Async or Full. Incremental updates are not
+ * used when reproducible is on.
+ *
+ * 13) For seamless loops, turn on tileable. The noise then repeats every
+ * tilePeriod units of noise space along each axis (0 for an axis that should
+ * not repeat), and over time every loopFrames frames (0 for no time loop).
+ * loopPeriod sets how far the noise travels along its time axis during one
+ * loop, so larger values change it faster. The loop follows the time
+ * attribute, so a retimed time connection retimes the loop as well. The time
+ * attribute is connected to time1.outTime while tileable is on and loopFrames
+ * is above 0, and disconnected again otherwise, so deformers that do not loop
+ * are not evaluated on every frame. The tileable noise is gradient
+ * noise on a cubic lattice rather than simplex noise, since only the former
+ * can repeat along the axes, so it looks slightly different.
+ *
+ * 14) Set fractalMode to change how the octaves are summed: fBm (the
+ * default), Turbulence (absolute values, so the noise only pushes outwards),
+ * Billow (rounded lumps) or Ridged (ridged multifractal, sharp crests with
+ * smooth valleys, good for rocks). Every mode runs as fast as plain fBm.
+ *
+ * 15) To warp the noise, set warpAmount to a non-zero value. The noise space
+ * position is then moved by warpAmount times three more fBm channels of
+ * warpOctaves octaves, sampled at warpFrequency times the noise frequency,
+ * before the noise is looked up. This gives swirly, organic shapes that
+ * stacking two deformers cannot give, since the second one would move the
+ * points rather than the noise space. The warp is ignored when tileable is on.
+ *
+ * 16) Set noiseType to Worley F1, Worley F2 or Worley F2-F1 to displace with
+ * cellular noise instead of simplex noise, which gives cell, scale and
+ * cracked-earth patterns. F1 and F2 are the distances to the nearest and the
+ * second nearest random feature points, and F2-F1 is close to 0 along the
+ * borders between the cells. Octaves, fractalMode and the warp apply to it as
+ * well. Each task keeps the feature points around the cells it last visited,
+ * so it is cheapest on spatially coherent points (see spatialReorder). The
+ * cellular noise is not tileable and is never baked into the LOD grid.
+ *
+ * 17) The deformer works with Maya's cached playback (Maya 2019 and later)
+ * and the parallel evaluation manager (Maya 2016 and later). Evaluations in
+ * the background fill of the cache always take the exact path: no LOD, async
+ * prediction, incremental update or frame cache. They also use their own
+ * scratch memory, so that they can run while the deformer is used in the
+ * foreground. Their results depend on nothing but the inputs at the evaluated
+ * time. With the evaluation manager, the deformer also uses the list of dirty
+ * plugs to skip checking the noise inputs when only the envelope, the
+ * amplitude or the weights have changed.
+ *
+ * 18) To get noise values without deforming a mesh (e.g. for scatter or
+ * placement tools), use the skNoiseEval command. It takes the query positions
+ * as a flat list of x y z values, followed or preceded by the noise
+ * parameters as flags, and returns a flat list of the three noise channels of
+ * every position, evaluated in parallel:
+ *
+ *     skNoiseEval -frequency 1 1 1 -octaves 4 0 0 0 1.5 0.25 -3;
+ *
+ * The flags are -frequency (-f), -offset (-o), -octaves (-oc), -persistence
+ * (-p), -lacunarity (-l), -fractalMode (-fm), -noiseType (-nty), -warpAmount
+ * (-wpa), -warpFrequency (-wpf), -warpOctaves (-wpo) and -numTasks (-nt),
+ * with the same meaning and defaults as the deformer attributes. The values
+ * match the ones the deformer computes for the same locator space positions,
+ * before they are scaled by the amplitude.
+ *
+ * 19) To vary the noise over the surface, paint the ampMap and freqMap
+ * attributes with the Paint Attributes Tool, or set ampColorSet and
+ * freqColorSet to the names of color sets on the input mesh, whose red
+ * channel is then used instead. The displacement of every vertex is scaled
+ * by its ampMap value and its noise frequency by its freqMap value. Vertices
+ * without a value are not scaled. The maps are only read again after they
+ * have changed, or after the input mesh has changed if color sets are used.
+ *
+ * 20) To see how the work is spread over the threads, set traceFile to a
+ * base path such as /tmp/skNoise. Every traceEvaluations evaluations, a
+ * timeline of them is written to the next numbered file (/tmp/skNoise.0.json,
+ * /tmp/skNoise.1.json, ...). Open it in chrome://tracing or Perfetto. It
+ * shows when each task started and finished on each thread, how long the
+ * parallel region took around them, and the preparation and write-back steps
+ * of every geometry. Clear traceFile to stop tracing.
+ *
+ * 21) Turn autoTasks on to use numTasks only as the starting point. The
+ * deformer then times every full evaluation and adjusts the number of tasks
+ * until the throughput stops improving, which takes about ten frames. It
+ * learns a separate count for every power of two of the number of points.
+ * tunedTasks shows the count of the last evaluation. The learned counts are
+ * kept by the node rather than computed, are saved with the scene and are
+ * reused on machines with the same number of processors. autoTasks is off by
+ * default, so the timings never change the task count unless asked to.
+ *
+ * 22) To render with motion blur, set motionBlurSamples to the number of
+ * time samples per frame of the renderer and motionBlurShutter to its
+ * shutter length in frames, centred on the frame. Then run, e.g. from a pre
+ * render frame script:
+ *
+ *     skNoiseMotionBlur -index 0 skNoiseDeformer1;
+ *
+ * It deforms every sample of the current frame of the geometry at that index
+ * in one pass over the points, which reads every point and weight only once
+ * and, if the locator does not move, transforms it only once. It returns the
+ * deformed points of the samples, one after the other, as a flat list of
+ * x y z values in object space. The sub-frame evaluations of the renderer at
+ * the sample times are then served from that pass. evalPath shows Motion Blur
+ * for them. Whole frame and background evaluations are always computed as
+ * usual. Since every sample is deformed from the same input points, the
+ * command only takes mesh inputs and fails if the input mesh changes over
+ * the shutter (e.g. an animated or skinned mesh). Deform such meshes at every
+ * sample time as usual. Leave motionBlurSamples at 1 otherwise.
+ *
+ * 23) numaAware (off by default) is experimental. On machines with more than
+ * one NUMA node, it pins every task to the node that owns its range of points
+ * and runs the noise phase out of a working buffer allocated on that node.
+ * The points are still read from and written back to the arrays of the mesh,
+ * wherever Maya allocated them, and every point is copied twice more, so
+ * whether it helps depends on the machine. Time it (e.g. with traceFile)
+ * before leaving it on. "skNoiseBench -numa" runs both ways outside of Maya
+ * and, where the kernel exposes the counters, prints how many loads were
+ * served by the memory of another node (see skNoiseBench.cpp).
+ *
  * ---------Credits-------------
  *
  * This plugin uses the noise library from Casey Duncan:
@@ -83,31 +255,194 @@
 #ifndef _SK_NOISE_DEFORMER_MT_H_
 #define _SK_NOISE_DEFORMER_MT_H_
 
+#include <map>
+
+struct ScratchArena;
+struct BatchArena;
+struct EvalSettings;
+struct SharedData;
+struct AsyncGeometry;
+struct AsyncFrame;
+struct FrameCache;
+struct GeometryEval;
+struct TraceSession;
+struct TaskTuner;
+struct MotionBlurGeometry;
+struct MotionBlurRequest;
+
 class SkNoiseDeformerMT : public MPxDeformerNode
 {
 
 public:
     SkNoiseDeformerMT();
     virtual ~SkNoiseDeformerMT();
+    virtual void postConstructor();
+    virtual MStatus compute(const MPlug& plug, MDataBlock& dataBlock);
+    virtual MStatus setDependentsDirty(const MPlug& plug, MPlugArray& plugArray);
+    virtual bool getInternalValue(const MPlug& plug, MDataHandle& dataHandle);
+    virtual bool setInternalValue(const MPlug& plug, const MDataHandle& dataHandle);
     virtual MStatus deform(MDataBlock& dataBlock,
                            MItGeometry& geomIter,
                            const MMatrix& localToWorldMat,
                            unsigned int multiIndex);
     virtual MStatus accessoryNodeSetup(MDagModifier& dagMod);
     virtual MObject& accessoryAttribute() const;
+#if MAYA_API_VERSION >= 201600
+    virtual SchedulingType schedulingType() const;
+    virtual MStatus preEvaluation(const MDGContext& context, const MEvaluationNode& evaluationNode);
+    virtual MStatus postEvaluation(const MDGContext& context,
+                                   const MEvaluationNode& evaluationNode,
+                                   PostEvaluationType evalType);
+#endif
+#if MAYA_API_VERSION >= 20200000
+    virtual void getCacheSetup(const MEvaluationNode& evaluationNode,
+                               MNodeCacheDisablingInfo& disablingInfo,
+                               MNodeCacheSetupInfo& cacheSetupInfo,
+                               MObjectArray& monitoredAttributes) const;
+#endif
     static void* creator();
     static MStatus initialize();
+    MStatus deformMotionBlurSamples(unsigned int multiIndex, MDoubleArray& result);
 
 public:
     static MTypeId nodeId;
     static MObject numTasks;
+    static MObject autoTasks;
+    static MObject tunedTasks;
+    static MObject learnedTasks;
+    static MObject numaAware;
+    static MObject batchGeometries;
     static MObject amp;
     static MObject freq;
     static MObject offset;
     static MObject octaves;
     static MObject lacunarity;
     static MObject persistence;
+    static MObject noiseType;
+    static MObject fractalMode;
+    static MObject warpAmount;
+    static MObject warpFrequency;
+    static MObject warpOctaves;
+    static MObject vertexMapList;
+    static MObject ampMap;
+    static MObject freqMap;
+    static MObject ampColorSet;
+    static MObject freqColorSet;
     static MObject locatorWorldSpace;
+    static MObject reproducible;
+    static MObject lodMode;
+    static MObject lodMethod;
+    static MObject lodOctaves;
+    static MObject lodGridResolution;
+    static MObject lodRefresh;
+    static MObject scratchMemory;
+    static MObject falloffShape;
+    static MObject falloffRadius;
+    static MObject falloffSmoothness;
+    static MObject tileable;
+    static MObject tilePeriod;
+    static MObject loopFrames;
+    static MObject loopPeriod;
+    static MObject time;
+    static MObject spatialReorder;
+    static MObject latticeCacheOctaves;
+    static MObject asyncPlayback;
+    static MObject frameCache;
+    static MObject frameCacheBudget;
+    static MObject frameCacheMemory;
+    static MObject frameCacheError;
+    static MObject incrementalUpdate;
+    static MObject evalPath;
+    static MObject motionBlurSamples;
+    static MObject motionBlurShutter;
+    static MObject traceFile;
+    static MObject traceEvaluations;
+
+private:
+    static void dragReleaseCallback(void* clientData);
+    static void lodRefreshCallback(float elapsedTime, float lastTime, void* clientData);
+    static void attributeChangedCallback(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* clientData);
+    static void timeChangeCallback(MTime& time, void* clientData);
+    MStatus getEvalSettings(MDataBlock& dataBlock, EvalSettings& settings);
+    MStatus prepareGeometry(MDataBlock& dataBlock,
+                            MItGeometry& geomIter,
+                            const MMatrix& localToWorldMat,
+                            unsigned int multiIndex,
+                            const EvalSettings& settings,
+                            SharedData& sharedData);
+    MStatus gatherVertexMaps(MDataBlock& dataBlock,
+                             unsigned int multiIndex,
+                             const EvalSettings& settings,
+                             ScratchArena *arena);
+    bool isVertexMapSource(const MPlug& plug) const;
+    MStatus reportStatistics(MDataBlock& dataBlock, const EvalSettings& settings, short path);
+    ScratchArena*& scratchArena(unsigned int multiIndex, bool background);
+    void refineLodResults(double minIdle);
+    void selectEvalPath(unsigned int multiIndex,
+                        const MMatrix& localToWorldMat,
+                        const EvalSettings& settings,
+                        AsyncFrame& asyncFrame,
+                        SharedData& sharedData,
+                        GeometryEval& eval);
+    MPointArray& finishGeometry(unsigned int multiIndex,
+                                const EvalSettings& settings,
+                                const SharedData& sharedData,
+                                const GeometryEval& eval);
+    FrameCache* getFrameCache();
+    AsyncGeometry* asyncGeometry(unsigned int multiIndex);
+    MTime predictNextTime(const MTime& time);
+    MStatus getEvalSettingsAtTime(const MTime& time, EvalSettings& settings, float *values);
+    void prepareAsyncFrame(const EvalSettings& settings, AsyncFrame& frame);
+    MPointArray* motionBlurPoints(unsigned int multiIndex,
+                                  const MMatrix& localToWorldMat,
+                                  const EvalSettings& settings,
+                                  const SharedData& sharedData);
+    void buildMotionBlurBatch(MotionBlurGeometry *geometry, const MotionBlurRequest& request);
+    MStatus checkStaticInput(unsigned int multiIndex, const MotionBlurRequest& request, bool& staticInput);
+
+    MCallbackId m_dragReleaseCallbackId;
+    MCallbackId m_lodRefreshCallbackId;
+    MCallbackId m_attributeChangedCallbackId;
+    MCallbackId m_timeChangeCallbackId;
+    std::map<unsigned int, ScratchArena*> m_scratchArenas;
+    std::map<unsigned int, ScratchArena*> m_backgroundArenas;
+    bool m_scaleInputsOnly;
+    unsigned int m_vertexMapGeneration;
+    bool m_colorSetsUsed;
+    BatchArena *m_batchArena;
+    std::map<unsigned int, AsyncGeometry*> m_asyncGeometries;
+    bool m_asyncInitialized;
+    MTime m_lastPlaybackTime;
+    FrameCache *m_frameCache;
+    TraceSession *m_trace;
+    TaskTuner *m_taskTuner;
+    MIntArray m_learnedTasks;
+    std::map<unsigned int, MotionBlurGeometry*> m_motionBlurGeometries;
+    AsyncFrame *m_asyncPrediction;
+
+};
+
+class SkNoiseEvalCmd : public MPxCommand
+{
+
+public:
+    virtual MStatus doIt(const MArgList& args);
+    static void* creator();
+
+public:
+    static MString commandName;
+
+};
+
+class SkNoiseMotionBlurCmd : public MPxCommand
+{
+
+public:
+    virtual MStatus doIt(const MArgList& args);
+    static void* creator();
+
+public:
+    static MString commandName;
 
 };
 
@@ -0,0 +1,364 @@
+/*
+ * skNoiseGolden
+ *
+ * Regression check of the noise kernels against golden results. The golden
+ * files in the golden sub-directory hold input points, fBm parameters and
+ * the expected results of two reference implementations:
+ *
+ * - fbm_noise3.golden has the exact 32-bit results of fbm_noise3() in
+ *   libnoise/_simplex.c, the scalar reference of the C++ plugins. The
+ *   reference itself and every dispatch path of skNoiseKernels.h (generic
+ *   and unrolled octave counts, octave scaling presets, isotropic and
+ *   anisotropic frequencies, with and without the lattice cache, and the
+ *   bulk query) must reproduce them bit for bit. A mismatch means that the
+ *   build, the compiler or the machine changed the floating point results,
+ *   e.g. through FMA contraction, and renders would differ between machines.
+ *
+ * - perlin_snoise3.golden has the results of SimplexNoise.snoise3() in
+ *   python/libnoise/perlin.py, which the scripted plugin falls back to. It
+ *   computes in double precision, so the C results only have to be within
+ *   PERLIN_TOLERANCE of it, and only near the origin.
+ *
+ * This tool does not depend on Maya.
+ *
+ * ---------Usage-------------
+ *
+ * 1) Run the check with "make test". It builds this tool with the same
+ * floating point flags as the plugins and runs it on the golden directory.
+ * The exit status is non-zero if any result differs.
+ *
+ * 2) The golden files only need to be generated again if the reference
+ * implementations change on purpose. Generate the C reference results with
+ *
+ *     skNoiseGolden -generate golden/fbm_noise3.golden
+ *
+ * and the Python ones for the same inputs with
+ *
+ *     python golden/perlinGolden.py golden/fbm_noise3.golden golden/perlin_snoise3.golden
+ *
+ * ---------Credits-------------
+ *
+ * This tool uses the noise library from Casey Duncan:
+ * https://github.com/caseman/noise
+ *
+ * ---------License-------------
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "skNoiseKernels.h"
+
+const char *toolName = "skNoiseGolden";
+
+//largest difference allowed between the C results and the double precision ones of perlin.py,
+//and the largest coordinate at which they are compared. Further out, single precision positions
+//are too coarse for the results to be close.
+const double PERLIN_TOLERANCE = 1.0e-4;
+const float PERLIN_MAX_COORDINATE = 100.0f;
+
+//fBm parameters of the generated golden inputs, covering every octave scaling preset
+const int GOLDEN_MAX_OCTAVES = 10;
+const int GOLDEN_NUM_SCALINGS = 3;
+const float GOLDEN_PERSISTENCES[GOLDEN_NUM_SCALINGS] = { 0.5f, 0.6f, 0.45f };
+const float GOLDEN_LACUNARITIES[GOLDEN_NUM_SCALINGS] = { 2.0f, 2.0f, 2.3f };
+
+//number of random points per parameter set, besides the fixed ones
+const int GOLDEN_RANDOM_POINTS = 48;
+
+//one line of a golden file
+typedef struct
+{
+    float x;
+    float y;
+    float z;
+    int octaves;
+    float persistence;
+    float lacunarity;
+    double value;
+    unsigned int bits;
+} GoldenEntry;
+
+//results of a check
+typedef struct
+{
+    int numChecks;
+    int numFailures;
+} GoldenResult;
+
+static unsigned int floatBits(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+//compares one result of a dispatch path with the golden one, reporting the first few mismatches
+static void checkBits(GoldenResult *result, const GoldenEntry& entry, const char *path, float value, unsigned int expectedBits)
+{
+    ++result->numChecks;
+    if (floatBits(value) == expectedBits)
+    {
+        return;
+    }
+    if (++result->numFailures <= 20)
+    {
+        fprintf(stderr, "[%s] %s differs at (%.9g, %.9g, %.9g) octaves %d persistence %.9g lacunarity %.9g: %08x instead of %08x\n",
+                toolName, path, entry.x, entry.y, entry.z, entry.octaves, entry.persistence, entry.lacunarity,
+                floatBits(value), expectedBits);
+    }
+}
+
+//reads the entries of a golden file, with the bits column only in the C reference file
+static bool readGoldenFile(const std::string& path, bool hasBits, std::vector<GoldenEntry>& entries)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file)
+    {
+        fprintf(stderr, "[%s] Unable to open %s\n", toolName, path.c_str());
+        return false;
+    }
+
+    char line[512];
+    GoldenEntry entry;
+    bool valid = true;
+    while (valid && fgets(line, sizeof(line), file))
+    {
+        if ('#' == line[0] || '\n' == line[0] || '\r' == line[0])
+        {
+            continue;
+        }
+        entry.bits = 0;
+        if (hasBits)
+        {
+            valid = 8 == sscanf(line, "%f %f %f %d %f %f %lf %x", &entry.x, &entry.y, &entry.z, &entry.octaves,
+                                &entry.persistence, &entry.lacunarity, &entry.value, &entry.bits);
+        }
+        else
+        {
+            valid = 7 == sscanf(line, "%f %f %f %d %f %f %lf", &entry.x, &entry.y, &entry.z, &entry.octaves,
+                                &entry.persistence, &entry.lacunarity, &entry.value);
+        }
+        if (valid)
+        {
+            entries.push_back(entry);
+        }
+        else
+        {
+            fprintf(stderr, "[%s] Invalid line in %s: %s", toolName, path.c_str(), line);
+        }
+    }
+    fclose(file);
+    return valid && !entries.empty();
+}
+
+//checks every dispatch path of the kernels against the results of fbm_noise3() in _simplex.c
+static void checkReference(const std::vector<GoldenEntry>& entries, GoldenResult *result)
+{
+    const float unitFreqs[3] = { 1.0f, 1.0f, 1.0f };
+    const float zeroOffsets[3] = { 0.0f, 0.0f, 0.0f };
+    LatticeCache latticeCache;
+    float noiseValues[3];
+    NoiseQuery query;
+    double position[3];
+    unsigned int i;
+    int octavesIndex, scaling, isotropic;
+
+    for (i = 0; i < entries.size(); ++i)
+    {
+        const GoldenEntry &entry = entries[i];
+        const int octaves = entry.octaves;
+        const float per = entry.persistence;
+        const float lac = entry.lacunarity;
+
+        //the reference itself, then the fBm kernel with the octave count known at runtime only
+        checkBits(result, entry, "fbm_noise3", fbm_noise3(entry.x, entry.y, entry.z, octaves, per, lac), entry.bits);
+        resetLatticeCache(&latticeCache);
+        checkBits(result, entry, "fbm_noise3_kernel cached", fbm_noise3_kernel<0, OCTAVE_SCALING_GENERIC, FbmOctave>(entry.x, entry.y, entry.z, octaves, per, lac, &latticeCache, octaves), entry.bits);
+
+        //the first channel of every kernel that can be picked for these parameters, whose
+        //other channels are checked against the reference at their fixed offsets
+        const float channel1 = fbm_noise3(entry.x + 123, entry.y + 456, entry.z + 789, octaves, per, lac);
+        const float channel2 = fbm_noise3(entry.x + 234, entry.y + 567, entry.z + 890, octaves, per, lac);
+        for (octavesIndex = 0; octavesIndex <= MAX_SPECIALIZED_OCTAVES; ++octavesIndex)
+        {
+            if (octavesIndex > 0 && octavesIndex != octaves)
+            {
+                continue;
+            }
+            for (scaling = 0; scaling < NUM_OCTAVE_SCALINGS; ++scaling)
+            {
+                if ((OCTAVE_SCALING_LACUNARITY_2 == scaling && 2.0f != lac)
+                    || (OCTAVE_SCALING_DEFAULT == scaling && (2.0f != lac || 0.5f != per)))
+                {
+                    continue;
+                }
+                for (isotropic = 0; isotropic < 2; ++isotropic)
+                {
+                    const NoiseKernel kernel = NOISE_KERNELS[FRACTAL_MODE_FBM][octavesIndex][scaling][isotropic][0];
+                    kernel(entry.x, entry.y, entry.z, unitFreqs, zeroOffsets, octaves, per, lac, NULL, 0, NULL, noiseValues);
+                    checkBits(result, entry, "noiseKernel", noiseValues[0], entry.bits);
+                    checkBits(result, entry, "noiseKernel channel 1", noiseValues[1], floatBits(channel1));
+                    checkBits(result, entry, "noiseKernel channel 2", noiseValues[2], floatBits(channel2));
+
+                    resetLatticeCache(&latticeCache);
+                    kernel(entry.x, entry.y, entry.z, unitFreqs, zeroOffsets, octaves, per, lac, &latticeCache, octaves, NULL, noiseValues);
+                    checkBits(result, entry, "noiseKernel cached", noiseValues[0], entry.bits);
+                }
+            }
+        }
+
+        //the bulk query, which picks its kernel the same way as the deformers
+        query.freqs[0] = query.freqs[1] = query.freqs[2] = 1.0f;
+        query.offsets[0] = query.offsets[1] = query.offsets[2] = 0.0f;
+        query.octaves = octaves;
+        query.persistence = per;
+        query.lacunarity = lac;
+        query.fractalMode = FRACTAL_MODE_FBM;
+        query.noiseType = NOISE_TYPE_SIMPLEX;
+        query.warp.amount = 0.0f;
+        query.warp.freq = 1.0f;
+        query.warp.octaves = 0;
+        position[0] = entry.x;
+        position[1] = entry.y;
+        position[2] = entry.z;
+        evaluateNoiseQuery(query, position, 0, 1, noiseValues);
+        checkBits(result, entry, "evaluateNoiseQuery", noiseValues[0], entry.bits);
+    }
+}
+
+//checks the C reference against the double precision results of perlin.py
+static double checkPerlin(const std::vector<GoldenEntry>& entries, GoldenResult *result)
+{
+    double maxError = 0.0;
+    unsigned int i;
+    for (i = 0; i < entries.size(); ++i)
+    {
+        const GoldenEntry &entry = entries[i];
+        if (std::max(std::fabs(entry.x), std::max(std::fabs(entry.y), std::fabs(entry.z))) > PERLIN_MAX_COORDINATE)
+        {
+            continue;
+        }
+        const float value = fbm_noise3(entry.x, entry.y, entry.z, entry.octaves, entry.persistence, entry.lacunarity);
+        const double error = std::fabs(value - entry.value);
+        maxError = std::max(maxError, error);
+        ++result->numChecks;
+        if (error > PERLIN_TOLERANCE && ++result->numFailures <= 20)
+        {
+            fprintf(stderr, "[%s] fbm_noise3 differs from perlin.py at (%.9g, %.9g, %.9g) octaves %d persistence %.9g lacunarity %.9g: %.9g instead of %.9g\n",
+                    toolName, entry.x, entry.y, entry.z, entry.octaves, entry.persistence, entry.lacunarity, value, entry.value);
+        }
+    }
+    return maxError;
+}
+
+//returns a pseudo-random coordinate in [-range, range), the same on every machine
+static float goldenCoordinate(unsigned int *state, float range)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return static_cast<float>((*state >> 8) * (1.0 / 16777216.0) * 2.0 - 1.0) * range;
+}
+
+//writes the inputs of the golden files with the results of the C reference
+static bool generateGoldenFile(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "[%s] Unable to open %s\n", toolName, path);
+        return false;
+    }
+
+    //points on lattice corners, on simplex boundaries and far from the origin, then random ones
+    const float fixedPoints[][3] = {
+        { 0.0f, 0.0f, 0.0f },
+        { 1.0f, 2.0f, 3.0f },
+        { -1.0f, -2.0f, -3.0f },
+        { 0.5f, 0.5f, 0.5f },
+        { 0.25f, -0.75f, 1.5f },
+        { 1000.5f, -2000.25f, 3000.125f }
+    };
+    const int numFixedPoints = sizeof(fixedPoints) / sizeof(fixedPoints[0]);
+
+    fprintf(file, "# x y z octaves persistence lacunarity value bits\n");
+    fprintf(file, "# results of fbm_noise3() in libnoise/_simplex.c, written by %s -generate\n", toolName);
+    unsigned int state = 12345u;
+    float x, y, z;
+    int octaves, scaling, i;
+    for (scaling = 0; scaling < GOLDEN_NUM_SCALINGS; ++scaling)
+    {
+        const float per = GOLDEN_PERSISTENCES[scaling];
+        const float lac = GOLDEN_LACUNARITIES[scaling];
+        for (octaves = 1; octaves <= GOLDEN_MAX_OCTAVES; ++octaves)
+        {
+            for (i = 0; i < numFixedPoints + GOLDEN_RANDOM_POINTS; ++i)
+            {
+                if (i < numFixedPoints)
+                {
+                    x = fixedPoints[i][0];
+                    y = fixedPoints[i][1];
+                    z = fixedPoints[i][2];
+                }
+                else
+                {
+                    x = goldenCoordinate(&state, 50.0f);
+                    y = goldenCoordinate(&state, 50.0f);
+                    z = goldenCoordinate(&state, 50.0f);
+                }
+                const float value = fbm_noise3(x, y, z, octaves, per, lac);
+                fprintf(file, "%.9g %.9g %.9g %d %.9g %.9g %.9g %08x\n", x, y, z, octaves, per, lac, value, floatBits(value));
+            }
+        }
+    }
+
+    return 0 == fclose(file);
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: %s goldenDirectory\n", toolName);
+    fprintf(stderr, "       %s -generate fbmGoldenFile\n", toolName);
+}
+
+int main(int argc, char **argv)
+{
+    if (3 == argc && !strcmp(argv[1], "-generate"))
+    {
+        return generateGoldenFile(argv[2]) ? 0 : 1;
+    }
+    if (2 != argc || '-' == argv[1][0])
+    {
+        printUsage();
+        return 2;
+    }
+
+    const std::string directory = argv[1];
+    std::vector<GoldenEntry> referenceEntries;
+    std::vector<GoldenEntry> perlinEntries;
+    if (!readGoldenFile(directory + "/fbm_noise3.golden", true, referenceEntries)
+        || !readGoldenFile(directory + "/perlin_snoise3.golden", false, perlinEntries))
+    {
+        return 2;
+    }
+
+    GoldenResult referenceResult = { 0, 0 };
+    checkReference(referenceEntries, &referenceResult);
+    printf("[%s] _simplex.c: %d of %d results bit-identical\n", toolName,
+           referenceResult.numChecks - referenceResult.numFailures, referenceResult.numChecks);
+
+    GoldenResult perlinResult = { 0, 0 };
+    const double maxError = checkPerlin(perlinEntries, &perlinResult);
+    printf("[%s] perlin.py: %d of %d results within %g (largest difference %.3g)\n", toolName,
+           perlinResult.numChecks - perlinResult.numFailures, perlinResult.numChecks, PERLIN_TOLERANCE, maxError);
+
+    return (referenceResult.numFailures > 0 || perlinResult.numFailures > 0) ? 1 : 0;
+}
@@ -0,0 +1,1055 @@
+/*
+ * Noise kernels shared by the noise deformer plugins.
+ *
+ * fbm_noise3() in libnoise/_simplex.c takes octaves, persistence and
+ * lacunarity at runtime, so the compiler can neither unroll its octave loop
+ * nor fold the common presets. The kernels here are templates over the octave
+ * count, the octave scaling (generic, lacunarity 2.0, or lacunarity 2.0 with
+ * persistence 0.5), isotropic frequency and the fractal mode. One of them is
+ * picked from a table once per deform call, with a generic fallback for
+ * everything else.
+ *
+ * The fractal modes (plain fBm, turbulence, billow and ridged multifractal)
+ * are policies that shape the noise of every octave before it is summed, so
+ * each mode gets its own kernel and none of them branches on the mode inside
+ * the octave loop.
+ *
+ * Domain warping offsets the noise space position by three more fBm channels
+ * before the final lookup. The warped kernels evaluate those channels in the
+ * same call as the final ones, see DomainWarp below.
+ *
+ * The specialized kernels perform exactly the same floating point operations
+ * in the same order as the generic one, so all of them return bit-identical
+ * results. Octaves are always accumulated from the lowest to the highest, and
+ * the makefile builds with FMA contraction and fast-math disabled by default
+ * (DETERMINISTIC=1), so results are also identical across machines regardless
+ * of the instruction sets they support.
+ *
+ * The low octaves can also be evaluated through a small per-thread cache of
+ * lattice cell gradients, see LatticeCache below.
+ *
+ * For tileable results there is also a periodic fractal noise, see
+ * fbm_periodic_noise3() and fbm_periodic_noise4() below.
+ *
+ * Cellular (Worley) noise is the other noise type, see worley_noise3() below.
+ *
+ * evaluateNoiseQuery() evaluates the noise for a flat array of positions, for
+ * tools that need the noise values rather than a deformed mesh.
+ *
+ * computeMortonOrder() sorts positions into Z-order, so that evaluations
+ * split into ranges work on spatially compact sets of points.
+ *
+ * This header does not depend on Maya.
+ *
+ * ---------License-------------
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ *
+ */
+
+#ifndef _SK_NOISE_KERNELS_H_
+#define _SK_NOISE_KERNELS_H_
+
+#if defined(SK_NOISE_DETERMINISTIC) && defined(__FAST_MATH__)
+#error "Deterministic noise results cannot be guaranteed with -ffast-math"
+#endif
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "libnoise/_simplex.c"
+
+//largest octave count that gets its own unrolled kernel
+const int MAX_SPECIALIZED_OCTAVES = 8;
+
+//octave scaling presets that get their own kernels
+enum OctaveScaling
+{
+    OCTAVE_SCALING_GENERIC = 0,
+    OCTAVE_SCALING_LACUNARITY_2,
+    OCTAVE_SCALING_DEFAULT, //lacunarity 2.0 and persistence 0.5
+    NUM_OCTAVE_SCALINGS
+};
+
+//values of the fractalMode attribute
+enum FractalMode
+{
+    FRACTAL_MODE_FBM = 0,
+    FRACTAL_MODE_TURBULENCE,
+    FRACTAL_MODE_BILLOW,
+    FRACTAL_MODE_RIDGED,
+    NUM_FRACTAL_MODES
+};
+
+//octave shaping policies. shape() turns the noise of one octave into what is summed, weight is
+//carried from one octave to the next and starts at 1.
+
+//plain fBm, in [-1, 1]
+struct FbmOctave
+{
+    static inline float shape(float noise, float& /*weight*/)
+    {
+        return noise;
+    }
+};
+
+//sum of absolute values, in [0, 1]
+struct TurbulenceOctave
+{
+    static inline float shape(float noise, float& /*weight*/)
+    {
+        return fabsf(noise);
+    }
+};
+
+//absolute values moved back to [-1, 1], which gives rounded lumps
+struct BillowOctave
+{
+    static inline float shape(float noise, float& /*weight*/)
+    {
+        return 2.0f * fabsf(noise) - 1.0f;
+    }
+};
+
+//ridged multifractal (Musgrave), in [0, 1]. Each octave is weighted by the previous one, so the
+//detail gathers along the ridges and the valleys stay smooth.
+struct RidgedOctave
+{
+    static inline float shape(float noise, float& weight)
+    {
+        float signal = 1.0f - fabsf(noise);
+        signal *= signal;
+        signal *= weight;
+        weight = signal * 2.0f;
+        weight = weight > 1.0f ? 1.0f : (weight < 0.0f ? 0.0f : weight);
+        return signal;
+    }
+};
+
+//number of slots in a LatticeCache, must be a power of 2
+const int LATTICE_CACHE_SIZE = 512;
+
+//direct-mapped cache of the gradient indices at the 8 corners of skewed lattice cubes. All four
+//corners of a simplex are corners of its cube, and the gradients only depend on the cube, so an
+//entry stays valid for every octave and channel. At dense sampling neighbouring points mostly
+//land in the same cubes at the low octaves and skip the permutation lookups.
+struct LatticeCache
+{
+    int keys[LATTICE_CACHE_SIZE];
+    unsigned char gradients[LATTICE_CACHE_SIZE][8];
+};
+
+inline void resetLatticeCache(LatticeCache *cache)
+{
+    int i;
+    for (i = 0; i < LATTICE_CACHE_SIZE; ++i)
+    {
+        cache->keys[i] = -1;
+    }
+}
+
+//returns the gradient indices of the cube at the given wrapped lattice coordinates, indexed by
+//(dx << 2) | (dy << 1) | dz of the corner
+inline const unsigned char* lookupLatticeCache(LatticeCache *cache, int I, int J, int K)
+{
+    const int key = (I << 16) | (J << 8) | K;
+    const int slot = (key ^ (key >> 7) ^ (key >> 13)) & (LATTICE_CACHE_SIZE - 1);
+    unsigned char *gradients = cache->gradients[slot];
+    if (cache->keys[slot] != key)
+    {
+        int corner;
+        for (corner = 0; corner < 8; ++corner)
+        {
+            const int dx = corner >> 2;
+            const int dy = (corner >> 1) & 1;
+            const int dz = corner & 1;
+            gradients[corner] = PERM[I + dx + PERM[J + dy + PERM[dz + K]]] % 12;
+        }
+        cache->keys[slot] = key;
+    }
+    return gradients;
+}
+
+//same as noise3() in libnoise/_simplex.c, with the gradient indices taken from the cache. The
+//floating point operations are identical, so the results are bit-identical.
+inline float noise3_cached(float x, float y, float z, LatticeCache *cache)
+{
+    int c, o1[3], o2[3], g[4], I, J, K;
+    float f[4], noise[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float s = (x + y + z) * F3;
+    float i = floorf(x + s);
+    float j = floorf(y + s);
+    float k = floorf(z + s);
+    float t = (i + j + k) * G3;
+
+    float pos[4][3];
+
+    pos[0][0] = x - (i - t);
+    pos[0][1] = y - (j - t);
+    pos[0][2] = z - (k - t);
+
+    if (pos[0][0] >= pos[0][1]) {
+        if (pos[0][1] >= pos[0][2]) {
+            ASSIGN(o1, 1, 0, 0);
+            ASSIGN(o2, 1, 1, 0);
+        } else if (pos[0][0] >= pos[0][2]) {
+            ASSIGN(o1, 1, 0, 0);
+            ASSIGN(o2, 1, 0, 1);
+        } else {
+            ASSIGN(o1, 0, 0, 1);
+            ASSIGN(o2, 1, 0, 1);
+        }
+    } else {
+        if (pos[0][1] < pos[0][2]) {
+            ASSIGN(o1, 0, 0, 1);
+            ASSIGN(o2, 0, 1, 1);
+        } else if (pos[0][0] < pos[0][2]) {
+            ASSIGN(o1, 0, 1, 0);
+            ASSIGN(o2, 0, 1, 1);
+        } else {
+            ASSIGN(o1, 0, 1, 0);
+            ASSIGN(o2, 1, 1, 0);
+        }
+    }
+
+    for (c = 0; c <= 2; c++) {
+        pos[3][c] = pos[0][c] - 1.0f + 3.0f * G3;
+        pos[2][c] = pos[0][c] - o2[c] + 2.0f * G3;
+        pos[1][c] = pos[0][c] - o1[c] + G3;
+    }
+
+    I = (int) i & 255;
+    J = (int) j & 255;
+    K = (int) k & 255;
+    const unsigned char *gradients = lookupLatticeCache(cache, I, J, K);
+    g[0] = gradients[0];
+    g[1] = gradients[(o1[0] << 2) | (o1[1] << 1) | o1[2]];
+    g[2] = gradients[(o2[0] << 2) | (o2[1] << 1) | o2[2]];
+    g[3] = gradients[7];
+
+    for (c = 0; c <= 3; c++) {
+        f[c] = 0.6f - pos[c][0]*pos[c][0] - pos[c][1]*pos[c][1] - pos[c][2]*pos[c][2];
+    }
+
+    for (c = 0; c <= 3; c++) {
+        if (f[c] > 0) {
+            noise[c] = f[c]*f[c]*f[c]*f[c] * dot3(pos[c], GRAD3[g[c]]);
+        }
+    }
+
+    return (noise[0] + noise[1] + noise[2] + noise[3]) * 32.0f;
+}
+
+//evaluates one octave, through the lattice cache if there is one
+inline float noise3_octave(float x, float y, float z, LatticeCache *cache)
+{
+    return cache ? noise3_cached(x, y, z, cache) : noise3(x, y, z);
+}
+
+//fractal kernel, with every octave shaped by SHAPE. OCTAVES of 0 means that the octave count is
+//only known at runtime. The first cachedOctaves octaves go through the lattice cache if one is
+//given. With FbmOctave this is the same as fbm_noise3().
+template <int OCTAVES, int SCALING, class SHAPE>
+inline float fbm_noise3_kernel(float x, float y, float z, int octaves, float persistence, float lacunarity,
+                               LatticeCache *cache, int cachedOctaves)
+{
+    const int numOctaves = OCTAVES > 0 ? OCTAVES : octaves;
+    const float per = OCTAVE_SCALING_DEFAULT == SCALING ? 0.5f : persistence;
+    const float lac = OCTAVE_SCALING_GENERIC == SCALING ? lacunarity : 2.0f;
+
+    float freq = 1.0f;
+    float amp = 1.0f;
+    float max = 1.0f;
+    float weight = 1.0f;
+    float total = SHAPE::shape(noise3_octave(x, y, z, cachedOctaves > 0 ? cache : NULL), weight);
+    int i;
+
+    for (i = 1; i < numOctaves; ++i) {
+        freq *= lac;
+        amp *= per;
+        max += amp;
+        total += SHAPE::shape(noise3_octave(x * freq, y * freq, z * freq, i < cachedOctaves ? cache : NULL), weight) * amp;
+    }
+    return total / max;
+}
+
+//fractal noise of the given mode with all parameters known at runtime only, for the places that
+//are not performance critical
+inline float fractal_noise3(float x, float y, float z, int octaves, float persistence, float lacunarity, int fractalMode)
+{
+    switch (fractalMode)
+    {
+        case FRACTAL_MODE_TURBULENCE:
+            return fbm_noise3_kernel<0, OCTAVE_SCALING_GENERIC, TurbulenceOctave>(x, y, z, octaves, persistence, lacunarity, NULL, 0);
+        case FRACTAL_MODE_BILLOW:
+            return fbm_noise3_kernel<0, OCTAVE_SCALING_GENERIC, BillowOctave>(x, y, z, octaves, persistence, lacunarity, NULL, 0);
+        case FRACTAL_MODE_RIDGED:
+            return fbm_noise3_kernel<0, OCTAVE_SCALING_GENERIC, RidgedOctave>(x, y, z, octaves, persistence, lacunarity, NULL, 0);
+        default:
+            return fbm_noise3_kernel<0, OCTAVE_SCALING_GENERIC, FbmOctave>(x, y, z, octaves, persistence, lacunarity, NULL, 0);
+    }
+}
+
+//domain warp applied before the final lookup. The three warp channels are plain fBm of octaves
+//octaves at freq times the noise space position, and move it by amount times their values.
+struct DomainWarp
+{
+    float amount;
+    float freq;
+    int octaves;
+};
+
+//offsets a noise space position by the warp channels. The warp channels use the same octave
+//scaling as the final lookup and go through the lattice cache as well, which is safe since the
+//cache is keyed by lattice cell.
+template <int SCALING>
+inline void warpNoiseInput(float& x, float& y, float& z, const DomainWarp *warp, float persistence, float lacunarity,
+                           LatticeCache *cache, int cachedOctaves)
+{
+    const float warpX = warp->freq * x;
+    const float warpY = warp->freq * y;
+    const float warpZ = warp->freq * z;
+    const float dx = fbm_noise3_kernel<0, SCALING, FbmOctave>(warpX + 345, warpY + 678, warpZ + 901, warp->octaves, persistence, lacunarity, cache, cachedOctaves);
+    const float dy = fbm_noise3_kernel<0, SCALING, FbmOctave>(warpX + 456, warpY + 789, warpZ + 12, warp->octaves, persistence, lacunarity, cache, cachedOctaves);
+    const float dz = fbm_noise3_kernel<0, SCALING, FbmOctave>(warpX + 567, warpY + 890, warpZ + 123, warp->octaves, persistence, lacunarity, cache, cachedOctaves);
+    x += warp->amount * dx;
+    y += warp->amount * dy;
+    z += warp->amount * dz;
+}
+
+//kernel that evaluates the three displacement channels for a locator space position. warp is only
+//read by the warped kernels.
+typedef void (*NoiseKernel)(double x,
+                            double y,
+                            double z,
+                            const float *freqs,
+                            const float *offsets,
+                            int octaves,
+                            float persistence,
+                            float lacunarity,
+                            LatticeCache *cache,
+                            int cachedOctaves,
+                            const DomainWarp *warp,
+                            float *noiseValues);
+
+template <int OCTAVES, int SCALING, bool ISOTROPIC, class SHAPE, bool WARP>
+void noiseKernel(double x,
+                 double y,
+                 double z,
+                 const float *freqs,
+                 const float *offsets,
+                 int octaves,
+                 float persistence,
+                 float lacunarity,
+                 LatticeCache *cache,
+                 int cachedOctaves,
+                 const DomainWarp *warp,
+                 float *noiseValues)
+{
+    //calculate noise space position
+    const float freqX = freqs[0];
+    const float freqY = ISOTROPIC ? freqX : freqs[1];
+    const float freqZ = ISOTROPIC ? freqX : freqs[2];
+    float noiseInputX = freqX * x - offsets[0];
+    float noiseInputY = freqY * y - offsets[1];
+    float noiseInputZ = freqZ * z - offsets[2];
+    if (WARP)
+    {
+        warpNoiseInput<SCALING>(noiseInputX, noiseInputY, noiseInputZ, warp, persistence, lacunarity, cache, cachedOctaves);
+    }
+
+    //each channel samples the noise at a different, fixed offset
+    noiseValues[0] = fbm_noise3_kernel<OCTAVES, SCALING, SHAPE>(noiseInputX, noiseInputY, noiseInputZ, octaves, persistence, lacunarity, cache, cachedOctaves);
+    noiseValues[1] = fbm_noise3_kernel<OCTAVES, SCALING, SHAPE>(noiseInputX + 123, noiseInputY + 456, noiseInputZ + 789, octaves, persistence, lacunarity, cache, cachedOctaves);
+    noiseValues[2] = fbm_noise3_kernel<OCTAVES, SCALING, SHAPE>(noiseInputX + 234, noiseInputY + 567, noiseInputZ + 890, octaves, persistence, lacunarity, cache, cachedOctaves);
+}
+
+#define SK_NOISE_KERNELS_FOR_ISOTROPIC(octaves, scaling, isotropic, shape) \
+    { &noiseKernel<octaves, scaling, isotropic, shape, false>, &noiseKernel<octaves, scaling, isotropic, shape, true> }
+
+#define SK_NOISE_KERNELS_FOR_SCALING(octaves, scaling, shape) \
+    { \
+        SK_NOISE_KERNELS_FOR_ISOTROPIC(octaves, scaling, false, shape), \
+        SK_NOISE_KERNELS_FOR_ISOTROPIC(octaves, scaling, true, shape) \
+    }
+
+#define SK_NOISE_KERNELS_FOR_OCTAVES(octaves, shape) \
+    { \
+        SK_NOISE_KERNELS_FOR_SCALING(octaves, OCTAVE_SCALING_GENERIC, shape), \
+        SK_NOISE_KERNELS_FOR_SCALING(octaves, OCTAVE_SCALING_LACUNARITY_2, shape), \
+        SK_NOISE_KERNELS_FOR_SCALING(octaves, OCTAVE_SCALING_DEFAULT, shape) \
+    }
+
+#define SK_NOISE_KERNELS_FOR_SHAPE(shape) \
+    { \
+        SK_NOISE_KERNELS_FOR_OCTAVES(0, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(1, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(2, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(3, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(4, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(5, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(6, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(7, shape), \
+        SK_NOISE_KERNELS_FOR_OCTAVES(8, shape) \
+    }
+
+//kernel table indexed by [fractalMode][octaves][scaling][isotropic][warped], octaves of 0 is the
+//generic fallback
+const NoiseKernel NOISE_KERNELS[NUM_FRACTAL_MODES][MAX_SPECIALIZED_OCTAVES + 1][NUM_OCTAVE_SCALINGS][2][2] = {
+    SK_NOISE_KERNELS_FOR_SHAPE(FbmOctave),
+    SK_NOISE_KERNELS_FOR_SHAPE(TurbulenceOctave),
+    SK_NOISE_KERNELS_FOR_SHAPE(BillowOctave),
+    SK_NOISE_KERNELS_FOR_SHAPE(RidgedOctave)
+};
+
+#undef SK_NOISE_KERNELS_FOR_SHAPE
+#undef SK_NOISE_KERNELS_FOR_OCTAVES
+#undef SK_NOISE_KERNELS_FOR_SCALING
+#undef SK_NOISE_KERNELS_FOR_ISOTROPIC
+
+//returns whether the given domain warp moves the noise at all
+inline bool domainWarpActive(const DomainWarp *warp)
+{
+    return warp && 0.0f != warp->amount && warp->octaves > 0;
+}
+
+//picks the most specialized kernel for the given noise parameters, warp may be NULL
+inline NoiseKernel selectNoiseKernel(int octaves, float persistence, float lacunarity, const float *freqs, int fractalMode,
+                                     const DomainWarp *warp)
+{
+    const int modeIndex = (fractalMode >= 0 && fractalMode < NUM_FRACTAL_MODES) ? fractalMode : FRACTAL_MODE_FBM;
+    const int octavesIndex = (octaves >= 1 && octaves <= MAX_SPECIALIZED_OCTAVES) ? octaves : 0;
+
+    int scaling = OCTAVE_SCALING_GENERIC;
+    if (2.0f == lacunarity)
+    {
+        scaling = (0.5f == persistence) ? OCTAVE_SCALING_DEFAULT : OCTAVE_SCALING_LACUNARITY_2;
+    }
+
+    const int isotropic = (freqs[0] == freqs[1] && freqs[0] == freqs[2]) ? 1 : 0;
+
+    const int warped = domainWarpActive(warp) ? 1 : 0;
+
+    return NOISE_KERNELS[modeIndex][octavesIndex][scaling][isotropic][warped];
+}
+
+//---------Periodic noise-------------
+//
+//Simplex noise can not be made to repeat along the axes, since its skewed lattice does not line
+//up with them. The periodic noise is therefore gradient noise on a cubic lattice (Perlin's
+//improved noise), using the same permutation and gradient tables. It repeats by wrapping the
+//lattice coordinates before they are hashed, so it costs the same as non-periodic noise instead
+//of blending several samples.
+
+//wraps a lattice coordinate to the given period, or to the permutation table if the period is 0
+inline int wrapLattice(int i, int period)
+{
+    if (period > 0)
+    {
+        i %= period;
+        if (i < 0)
+        {
+            i += period;
+        }
+    }
+    return i & 255;
+}
+
+//quintic interpolation weight of a fractional lattice position
+inline float latticeFade(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+inline float latticeLerp(float t, float a, float b)
+{
+    return a + t * (b - a);
+}
+
+//3D gradient noise that repeats every periods[c] lattice cells along axis c (0 for no repeat)
+inline float periodic_noise3(float x, float y, float z, const int *periods)
+{
+    const float p[3] = { x, y, z };
+    float f[3], u[3];
+    int i0[3], i1[3], c;
+    for (c = 0; c < 3; ++c)
+    {
+        const float cell = floorf(p[c]);
+        f[c] = p[c] - cell;
+        u[c] = latticeFade(f[c]);
+        i0[c] = wrapLattice(static_cast<int>(cell), periods[c]);
+        i1[c] = wrapLattice(static_cast<int>(cell) + 1, periods[c]);
+    }
+
+    //gradient contributions of the 8 corners, indexed by (dx << 2) | (dy << 1) | dz
+    float corners[8];
+    int corner;
+    for (corner = 0; corner < 8; ++corner)
+    {
+        const int dx = corner >> 2;
+        const int dy = (corner >> 1) & 1;
+        const int dz = corner & 1;
+        const int hash = PERM[(dx ? i1[0] : i0[0]) + PERM[(dy ? i1[1] : i0[1]) + PERM[dz ? i1[2] : i0[2]]]];
+        const float *g = GRAD3[hash & 15];
+        corners[corner] = g[0] * (f[0] - dx) + g[1] * (f[1] - dy) + g[2] * (f[2] - dz);
+    }
+
+    //interpolate along z, then y, then x
+    const float x00 = latticeLerp(u[2], corners[0], corners[1]);
+    const float x01 = latticeLerp(u[2], corners[2], corners[3]);
+    const float x10 = latticeLerp(u[2], corners[4], corners[5]);
+    const float x11 = latticeLerp(u[2], corners[6], corners[7]);
+    return latticeLerp(u[0], latticeLerp(u[1], x00, x01), latticeLerp(u[1], x10, x11));
+}
+
+//4D gradient noise that repeats every periods[c] lattice cells along axis c (0 for no repeat)
+inline float periodic_noise4(float x, float y, float z, float w, const int *periods)
+{
+    const float p[4] = { x, y, z, w };
+    float f[4], u[4];
+    int i0[4], i1[4], c;
+    for (c = 0; c < 4; ++c)
+    {
+        const float cell = floorf(p[c]);
+        f[c] = p[c] - cell;
+        u[c] = latticeFade(f[c]);
+        i0[c] = wrapLattice(static_cast<int>(cell), periods[c]);
+        i1[c] = wrapLattice(static_cast<int>(cell) + 1, periods[c]);
+    }
+
+    //gradient contributions of the 16 corners, indexed by (dx << 3) | (dy << 2) | (dz << 1) | dw
+    float corners[16];
+    int corner;
+    for (corner = 0; corner < 16; ++corner)
+    {
+        const int dx = corner >> 3;
+        const int dy = (corner >> 2) & 1;
+        const int dz = (corner >> 1) & 1;
+        const int dw = corner & 1;
+        const int hash = PERM[(dx ? i1[0] : i0[0]) + PERM[(dy ? i1[1] : i0[1]) + PERM[(dz ? i1[2] : i0[2]) + PERM[dw ? i1[3] : i0[3]]]]];
+        const float *g = GRAD4[hash & 31];
+        corners[corner] = g[0] * (f[0] - dx) + g[1] * (f[1] - dy) + g[2] * (f[2] - dz) + g[3] * (f[3] - dw);
+    }
+
+    //interpolate along w, then z, y and x
+    for (corner = 0; corner < 8; ++corner)
+    {
+        corners[corner] = latticeLerp(u[3], corners[2 * corner], corners[2 * corner + 1]);
+    }
+    for (corner = 0; corner < 4; ++corner)
+    {
+        corners[corner] = latticeLerp(u[2], corners[2 * corner], corners[2 * corner + 1]);
+    }
+    return latticeLerp(u[0], latticeLerp(u[1], corners[0], corners[1]), latticeLerp(u[1], corners[2], corners[3]));
+}
+
+//lattice periods and position scales of one octave of the periodic fBm. The frequency of each
+//periodic axis is snapped so that the octave spans a whole number of cells over the period, which
+//keeps the sum periodic whatever the lacunarity.
+inline void periodicOctave(const int *periods, int dims, float freq, int *octavePeriods, float *scales)
+{
+    int c;
+    for (c = 0; c < dims; ++c)
+    {
+        if (periods[c] > 0)
+        {
+            const int cells = static_cast<int>(floorf(periods[c] * freq + 0.5f));
+            octavePeriods[c] = cells > 1 ? cells : 1;
+            scales[c] = static_cast<float>(octavePeriods[c]) / periods[c];
+        }
+        else
+        {
+            octavePeriods[c] = 0;
+            scales[c] = freq;
+        }
+    }
+}
+
+//fractal sum of periodic_noise3(), with every octave shaped by SHAPE
+template <class SHAPE>
+inline float fbm_periodic_noise3(float x, float y, float z, const int *periods, int octaves, float persistence, float lacunarity)
+{
+    float freq = 1.0f;
+    float amp = 1.0f;
+    float max = 0.0f;
+    float total = 0.0f;
+    float weight = 1.0f;
+    int octavePeriods[3];
+    float scales[3];
+    int i;
+
+    for (i = 0; i < octaves; ++i) {
+        periodicOctave(periods, 3, freq, octavePeriods, scales);
+        total += SHAPE::shape(periodic_noise3(x * scales[0], y * scales[1], z * scales[2], octavePeriods), weight) * amp;
+        max += amp;
+        freq *= lacunarity;
+        amp *= persistence;
+    }
+    return total / max;
+}
+
+//fractal sum of periodic_noise4(), with every octave shaped by SHAPE
+template <class SHAPE>
+inline float fbm_periodic_noise4(float x, float y, float z, float w, const int *periods, int octaves, float persistence, float lacunarity)
+{
+    float freq = 1.0f;
+    float amp = 1.0f;
+    float max = 0.0f;
+    float total = 0.0f;
+    float weight = 1.0f;
+    int octavePeriods[4];
+    float scales[4];
+    int i;
+
+    for (i = 0; i < octaves; ++i) {
+        periodicOctave(periods, 4, freq, octavePeriods, scales);
+        total += SHAPE::shape(periodic_noise4(x * scales[0], y * scales[1], z * scales[2], w * scales[3], octavePeriods), weight) * amp;
+        max += amp;
+        freq *= lacunarity;
+        amp *= persistence;
+    }
+    return total / max;
+}
+
+//kernel that evaluates the three displacement channels with the periodic noise
+typedef void (*PeriodicNoiseKernel)(double x,
+                                    double y,
+                                    double z,
+                                    float w,
+                                    const float *freqs,
+                                    const float *offsets,
+                                    const int *periods,
+                                    int octaves,
+                                    float persistence,
+                                    float lacunarity,
+                                    float *noiseValues);
+
+//evaluates the three displacement channels with the periodic fractal noise. w is the position
+//along the looping time axis, which is only used if periods[3] is not 0.
+template <class SHAPE>
+void periodicNoiseKernel(double x,
+                                double y,
+                                double z,
+                                float w,
+                                const float *freqs,
+                                const float *offsets,
+                                const int *periods,
+                                int octaves,
+                                float persistence,
+                                float lacunarity,
+                                float *noiseValues)
+{
+    //calculate noise space position
+    const float noiseInputX = freqs[0] * x - offsets[0];
+    const float noiseInputY = freqs[1] * y - offsets[1];
+    const float noiseInputZ = freqs[2] * z - offsets[2];
+
+    //the channel offsets are whole cells, so every channel repeats with the same periods
+    if (periods[3] > 0)
+    {
+        noiseValues[0] = fbm_periodic_noise4<SHAPE>(noiseInputX, noiseInputY, noiseInputZ, w, periods, octaves, persistence, lacunarity);
+        noiseValues[1] = fbm_periodic_noise4<SHAPE>(noiseInputX + 123, noiseInputY + 456, noiseInputZ + 789, w, periods, octaves, persistence, lacunarity);
+        noiseValues[2] = fbm_periodic_noise4<SHAPE>(noiseInputX + 234, noiseInputY + 567, noiseInputZ + 890, w, periods, octaves, persistence, lacunarity);
+    }
+    else
+    {
+        noiseValues[0] = fbm_periodic_noise3<SHAPE>(noiseInputX, noiseInputY, noiseInputZ, periods, octaves, persistence, lacunarity);
+        noiseValues[1] = fbm_periodic_noise3<SHAPE>(noiseInputX + 123, noiseInputY + 456, noiseInputZ + 789, periods, octaves, persistence, lacunarity);
+        noiseValues[2] = fbm_periodic_noise3<SHAPE>(noiseInputX + 234, noiseInputY + 567, noiseInputZ + 890, periods, octaves, persistence, lacunarity);
+    }
+}
+
+//periodic kernel table indexed by fractalMode
+const PeriodicNoiseKernel PERIODIC_NOISE_KERNELS[NUM_FRACTAL_MODES] = {
+    &periodicNoiseKernel<FbmOctave>,
+    &periodicNoiseKernel<TurbulenceOctave>,
+    &periodicNoiseKernel<BillowOctave>,
+    &periodicNoiseKernel<RidgedOctave>
+};
+
+//picks the periodic kernel of the given fractal mode
+inline PeriodicNoiseKernel selectPeriodicNoiseKernel(int fractalMode)
+{
+    return PERIODIC_NOISE_KERNELS[(fractalMode >= 0 && fractalMode < NUM_FRACTAL_MODES) ? fractalMode : FRACTAL_MODE_FBM];
+}
+
+//---------Cellular noise-------------
+//
+//Worley noise with one feature point per lattice cell, jittered inside the cell by the
+//permutation table. A sample looks at the 27 cells around its own. The distances to all of them
+//are computed in one branch-free loop over flat arrays, which the compiler can vectorize, and
+//only the selection of the two nearest distances branches.
+//
+//Dense meshes evaluate many points in the same cell in a row, especially in Z-order, so the
+//feature points around the last cell of every octave and channel are kept in a WorleyCache and
+//reused while the samples stay in that cell.
+
+//values of the noiseType attribute
+enum NoiseType
+{
+    NOISE_TYPE_SIMPLEX = 0,
+    NOISE_TYPE_WORLEY_F1,
+    NOISE_TYPE_WORLEY_F2,
+    NOISE_TYPE_WORLEY_F2_MINUS_F1,
+    NUM_NOISE_TYPES
+};
+
+//scales that take the distances to about [0, 1]
+const float WORLEY_F1_SCALE = 1.0f;
+const float WORLEY_F2_SCALE = 0.9f;
+const float WORLEY_F2_MINUS_F1_SCALE = 1.2f;
+
+//number of octaves of each channel whose neighbourhood is cached
+const int WORLEY_CACHE_OCTAVES = 8;
+
+//feature points of the 27 cells around one cell
+struct WorleyNeighbourhood
+{
+    int cell[3];
+    float x[27];
+    float y[27];
+    float z[27];
+};
+
+//per-thread cache of feature point neighbourhoods, one per channel and cached octave
+struct WorleyCache
+{
+    WorleyNeighbourhood neighbourhoods[3][WORLEY_CACHE_OCTAVES];
+};
+
+inline void resetWorleyCache(WorleyCache *cache)
+{
+    int c, i;
+    for (c = 0; c < 3; ++c)
+    {
+        for (i = 0; i < WORLEY_CACHE_OCTAVES; ++i)
+        {
+            //no sample falls into this cell, the lattice coordinates are wrapped long before
+            cache->neighbourhoods[c][i].cell[0] = INT_MIN;
+        }
+    }
+}
+
+//fills in the feature points of the 27 cells around the given cell
+inline void computeWorleyNeighbourhood(int I, int J, int K, WorleyNeighbourhood *neighbourhood)
+{
+    neighbourhood->cell[0] = I;
+    neighbourhood->cell[1] = J;
+    neighbourhood->cell[2] = K;
+
+    //the inner permutations are shared by 9 and 3 cells
+    int hashK[3], hashJK[3][3];
+    int dx, dy, dz, hash, n = 0;
+    for (dz = -1; dz <= 1; ++dz)
+    {
+        hashK[dz + 1] = PERM[(K + dz) & 255];
+    }
+    for (dy = -1; dy <= 1; ++dy)
+    {
+        for (dz = -1; dz <= 1; ++dz)
+        {
+            hashJK[dy + 1][dz + 1] = PERM[((J + dy) & 255) + hashK[dz + 1]];
+        }
+    }
+
+    for (dx = -1; dx <= 1; ++dx)
+    {
+        for (dy = -1; dy <= 1; ++dy)
+        {
+            for (dz = -1; dz <= 1; ++dz, ++n)
+            {
+                hash = PERM[((I + dx) & 255) + hashJK[dy + 1][dz + 1]];
+                neighbourhood->x[n] = static_cast<float>(dx) + PERM[hash] * (1.0f / 255.0f);
+                neighbourhood->y[n] = static_cast<float>(dy) + PERM[hash + 1] * (1.0f / 255.0f);
+                neighbourhood->z[n] = static_cast<float>(dz) + PERM[hash + 2] * (1.0f / 255.0f);
+            }
+        }
+    }
+}
+
+//distances to the nearest (f1) and second nearest (f2) feature points. The neighbourhood is looked
+//up in cached if there is one, otherwise it is computed into scratch.
+inline void worley_distances3(float x, float y, float z, WorleyNeighbourhood *cached, WorleyNeighbourhood *scratch,
+                              float& f1, float& f2)
+{
+    const float cellX = floorf(x);
+    const float cellY = floorf(y);
+    const float cellZ = floorf(z);
+    const int I = static_cast<int>(cellX);
+    const int J = static_cast<int>(cellY);
+    const int K = static_cast<int>(cellZ);
+
+    WorleyNeighbourhood *neighbourhood = cached ? cached : scratch;
+    if (!cached || cached->cell[0] != I || cached->cell[1] != J || cached->cell[2] != K)
+    {
+        computeWorleyNeighbourhood(I, J, K, neighbourhood);
+    }
+
+    //squared distances to all feature points, relative to the cell so that the floats stay small
+    const float fx = x - cellX;
+    const float fy = y - cellY;
+    const float fz = z - cellZ;
+    float dist[28];
+    float dx, dy, dz;
+    int n;
+    for (n = 0; n < 27; ++n)
+    {
+        dx = neighbourhood->x[n] - fx;
+        dy = neighbourhood->y[n] - fy;
+        dz = neighbourhood->z[n] - fz;
+        dist[n] = dx * dx + dy * dy + dz * dz;
+    }
+
+    //branch-free selection of the two smallest in four independent lanes, which are merged at the
+    //end. The order of the points is random, so branches would mispredict a lot.
+    dist[27] = FLT_MAX;
+    float d1[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    float d2[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    int lane;
+    for (n = 0; n < 28; n += 4)
+    {
+        for (lane = 0; lane < 4; ++lane)
+        {
+            d2[lane] = std::min(d2[lane], std::max(d1[lane], dist[n + lane]));
+            d1[lane] = std::min(d1[lane], dist[n + lane]);
+        }
+    }
+    for (lane = 1; lane < 4; ++lane)
+    {
+        d2[0] = std::min(std::min(d2[0], d2[lane]), std::max(d1[0], d1[lane]));
+        d1[0] = std::min(d1[0], d1[lane]);
+    }
+    f1 = sqrtf(d1[0]);
+    f2 = sqrtf(d2[0]);
+}
+
+//Worley noise of the given output, moved to about [-1, 1] like the simplex noise so that the
+//fractal modes shape it the same way. Values past the rare extremes are clamped.
+template <int TYPE>
+inline float worley_noise3(float x, float y, float z, WorleyNeighbourhood *cached, WorleyNeighbourhood *scratch)
+{
+    float f1, f2, value;
+    worley_distances3(x, y, z, cached, scratch, f1, f2);
+    if (NOISE_TYPE_WORLEY_F1 == TYPE)
+    {
+        value = f1 * WORLEY_F1_SCALE;
+    }
+    else if (NOISE_TYPE_WORLEY_F2 == TYPE)
+    {
+        value = f2 * WORLEY_F2_SCALE;
+    }
+    else
+    {
+        value = (f2 - f1) * WORLEY_F2_MINUS_F1_SCALE;
+    }
+    value = value > 1.0f ? 1.0f : value;
+    return 2.0f * value - 1.0f;
+}
+
+//fractal sum of worley_noise3(), with every octave shaped by SHAPE. channel picks the cached
+//neighbourhoods, cache may be NULL.
+template <int TYPE, class SHAPE>
+inline float fbm_worley_noise3(float x, float y, float z, int octaves, float persistence, float lacunarity,
+                               WorleyCache *cache, int channel)
+{
+    WorleyNeighbourhood scratch;
+    float freq = 1.0f;
+    float amp = 1.0f;
+    float max = 0.0f;
+    float total = 0.0f;
+    float weight = 1.0f;
+    int i;
+
+    for (i = 0; i < octaves; ++i) {
+        WorleyNeighbourhood *cached = (cache && i < WORLEY_CACHE_OCTAVES) ? &cache->neighbourhoods[channel][i] : NULL;
+        total += SHAPE::shape(worley_noise3<TYPE>(x * freq, y * freq, z * freq, cached, &scratch), weight) * amp;
+        max += amp;
+        freq *= lacunarity;
+        amp *= persistence;
+    }
+    return total / max;
+}
+
+//kernel that evaluates the three displacement channels with the cellular noise, warp may be NULL
+typedef void (*WorleyNoiseKernel)(double x,
+                                  double y,
+                                  double z,
+                                  const float *freqs,
+                                  const float *offsets,
+                                  int octaves,
+                                  float persistence,
+                                  float lacunarity,
+                                  WorleyCache *cache,
+                                  const DomainWarp *warp,
+                                  float *noiseValues);
+
+template <int TYPE, class SHAPE>
+void worleyNoiseKernel(double x,
+                       double y,
+                       double z,
+                       const float *freqs,
+                       const float *offsets,
+                       int octaves,
+                       float persistence,
+                       float lacunarity,
+                       WorleyCache *cache,
+                       const DomainWarp *warp,
+                       float *noiseValues)
+{
+    //calculate noise space position
+    float noiseInputX = freqs[0] * x - offsets[0];
+    float noiseInputY = freqs[1] * y - offsets[1];
+    float noiseInputZ = freqs[2] * z - offsets[2];
+    if (domainWarpActive(warp))
+    {
+        warpNoiseInput<OCTAVE_SCALING_GENERIC>(noiseInputX, noiseInputY, noiseInputZ, warp, persistence, lacunarity, NULL, 0);
+    }
+
+    noiseValues[0] = fbm_worley_noise3<TYPE, SHAPE>(noiseInputX, noiseInputY, noiseInputZ, octaves, persistence, lacunarity, cache, 0);
+    noiseValues[1] = fbm_worley_noise3<TYPE, SHAPE>(noiseInputX + 123, noiseInputY + 456, noiseInputZ + 789, octaves, persistence, lacunarity, cache, 1);
+    noiseValues[2] = fbm_worley_noise3<TYPE, SHAPE>(noiseInputX + 234, noiseInputY + 567, noiseInputZ + 890, octaves, persistence, lacunarity, cache, 2);
+}
+
+#define SK_WORLEY_NOISE_KERNELS_FOR_SHAPE(shape) \
+    { \
+        &worleyNoiseKernel<NOISE_TYPE_WORLEY_F1, shape>, \
+        &worleyNoiseKernel<NOISE_TYPE_WORLEY_F2, shape>, \
+        &worleyNoiseKernel<NOISE_TYPE_WORLEY_F2_MINUS_F1, shape> \
+    }
+
+//cellular kernel table indexed by [fractalMode][noiseType - NOISE_TYPE_WORLEY_F1]
+const WorleyNoiseKernel WORLEY_NOISE_KERNELS[NUM_FRACTAL_MODES][NUM_NOISE_TYPES - 1] = {
+    SK_WORLEY_NOISE_KERNELS_FOR_SHAPE(FbmOctave),
+    SK_WORLEY_NOISE_KERNELS_FOR_SHAPE(TurbulenceOctave),
+    SK_WORLEY_NOISE_KERNELS_FOR_SHAPE(BillowOctave),
+    SK_WORLEY_NOISE_KERNELS_FOR_SHAPE(RidgedOctave)
+};
+
+#undef SK_WORLEY_NOISE_KERNELS_FOR_SHAPE
+
+//picks the cellular kernel of the given noise type and fractal mode, NULL for simplex noise
+inline WorleyNoiseKernel selectWorleyNoiseKernel(int noiseType, int fractalMode)
+{
+    if (noiseType <= NOISE_TYPE_SIMPLEX || noiseType >= NUM_NOISE_TYPES)
+    {
+        return NULL;
+    }
+    return WORLEY_NOISE_KERNELS[(fractalMode >= 0 && fractalMode < NUM_FRACTAL_MODES) ? fractalMode : FRACTAL_MODE_FBM][noiseType - NOISE_TYPE_WORLEY_F1];
+}
+
+//---------Bulk evaluation-------------
+
+//noise parameters of a bulk evaluation, with the same meaning as the deformer attributes
+struct NoiseQuery
+{
+    float freqs[3];
+    float offsets[3];
+    int octaves;
+    float persistence;
+    float lacunarity;
+    int fractalMode;
+    int noiseType;
+    DomainWarp warp;
+};
+
+//number of octaves that go through the lattice cache in a bulk evaluation, the results do not
+//depend on it
+const int NOISE_QUERY_CACHED_OCTAVES = 2;
+
+//evaluates the three noise channels for the positions start to end - 1 of a flat array of xyz
+//positions, into the same range of a flat array of results. The kernel is picked once, and the
+//values are the same as the ones the deformers compute for locator space positions.
+inline void evaluateNoiseQuery(const NoiseQuery& query, const double *positions, int start, int end, float *results)
+{
+    const DomainWarp *warp = domainWarpActive(&query.warp) ? &query.warp : NULL;
+    const WorleyNoiseKernel worleyKernel = selectWorleyNoiseKernel(query.noiseType, query.fractalMode);
+    const NoiseKernel kernel = selectNoiseKernel(query.octaves, query.persistence, query.lacunarity, query.freqs, query.fractalMode, warp);
+    const double *p;
+    int i;
+
+    if (worleyKernel)
+    {
+        WorleyCache worleyCache;
+        resetWorleyCache(&worleyCache);
+        for (i = start; i < end; ++i)
+        {
+            p = positions + 3 * i;
+            worleyKernel(p[0], p[1], p[2], query.freqs, query.offsets, query.octaves, query.persistence, query.lacunarity,
+                         &worleyCache, warp, results + 3 * i);
+        }
+    }
+    else
+    {
+        LatticeCache latticeCache;
+        resetLatticeCache(&latticeCache);
+        for (i = start; i < end; ++i)
+        {
+            p = positions + 3 * i;
+            kernel(p[0], p[1], p[2], query.freqs, query.offsets, query.octaves, query.persistence, query.lacunarity,
+                   &latticeCache, NOISE_QUERY_CACHED_OCTAVES, warp, results + 3 * i);
+        }
+    }
+}
+
+//---------Spatial order-------------
+
+//spreads the lowest 10 bits of the value out so that there are two zero bits between each of them
+inline unsigned int expandMortonBits(unsigned int v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+//computes the Z-order (Morton order) of a flat array of xyz positions, quantized to 10 bits per
+//axis over their bounding box. order[i] is the index of the position that comes ith.
+inline void computeMortonOrder(const double *positions, unsigned int numPoints, std::vector<unsigned int>& order)
+{
+    double minPos[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+    double maxPos[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+    unsigned int i;
+    int j;
+    for (i = 0; i < numPoints; ++i)
+    {
+        for (j = 0; j < 3; ++j)
+        {
+            minPos[j] = std::min(minPos[j], positions[3 * i + j]);
+            maxPos[j] = std::max(maxPos[j], positions[3 * i + j]);
+        }
+    }
+
+    double scale[3];
+    for (j = 0; j < 3; ++j)
+    {
+        scale[j] = maxPos[j] > minPos[j] ? 1023.0 / (maxPos[j] - minPos[j]) : 0.0;
+    }
+
+    //sort the point ids by their codes, ties keep the original order
+    std::vector< std::pair<unsigned int, unsigned int> > codes(numPoints);
+    const double *p;
+    for (i = 0; i < numPoints; ++i)
+    {
+        p = positions + 3 * i;
+        codes[i].first = (expandMortonBits(static_cast<unsigned int>((p[0] - minPos[0]) * scale[0])) << 2)
+                         | (expandMortonBits(static_cast<unsigned int>((p[1] - minPos[1]) * scale[1])) << 1)
+                         | expandMortonBits(static_cast<unsigned int>((p[2] - minPos[2]) * scale[2]));
+        codes[i].second = i;
+    }
+    std::sort(codes.begin(), codes.end());
+
+    order.resize(numPoints);
+    for (i = 0; i < numPoints; ++i)
+    {
+        order[i] = codes[i].second;
+    }
+}
+
+#endif
@@ -0,0 +1,523 @@
+/*
+ * skNoiseStream
+ *
+ * Command line tool that applies the noise deformation of the
+ * skNoiseDeformer plugins to point files that are too large to be loaded
+ * into Maya, or into memory at all, such as photogrammetry point clouds.
+ *
+ * The points are streamed from a memory-mapped binary file in chunks of a
+ * fixed number of points, so the memory used stays the same whatever the size
+ * of the file. The chunks go through a pipeline of three stages: while one
+ * chunk is deformed in parallel, the next one is read and the previous one is
+ * written out. The noise is evaluated with the same kernels as the plugins,
+ * so the results match the deformers. This tool does not depend on Maya.
+ *
+ * ---------Usage-------------
+ *
+ * 1) Build the tool with "make stream". It is linked against the pthread
+ * backend of the parallel-for layer unless PARALLEL picks another one that
+ * does not need Maya (see skParallel.h).
+ *
+ * 2) Write the points to a raw binary file of fixed-size records, each of
+ * which starts with the x, y and z coordinates as 32-bit floats in the byte
+ * order of the machine. The rest of a record (e.g. colors or normals) is
+ * copied to the output unchanged. Set -stride to the size of a record in
+ * bytes if it is not 12.
+ *
+ * 3) Deform the points by running e.g.:
+ *
+ *     skNoiseStream -amplitude 0.1 0.1 0.1 -frequency 2 2 2 -octaves 4 in.bin out.bin
+ *
+ * The noise flags are -amplitude (-amp), -frequency (-f), -offset (-o),
+ * -octaves (-oc), -persistence (-p), -lacunarity (-l), -fractalMode (-fm),
+ * -noiseType (-nty), -warpAmount (-wpa), -warpFrequency (-wpf),
+ * -warpOctaves (-wpo) and -envelope (-env), with the same meaning and
+ * defaults as the deformer attributes. The points are taken to be in the
+ * space of the noise locator, so the result matches the deformer with its
+ * locator at the origin.
+ *
+ * 4) -chunkSize (-cs) sets the number of points per chunk (1048576 by
+ * default), and -numTasks (-nt) the number of tasks that every chunk is split
+ * into (16 by default). About three chunks are held in memory at a time.
+ *
+ * ---------Credits-------------
+ *
+ * This tool uses the noise library from Casey Duncan:
+ * https://github.com/caseman/noise
+ *
+ * ---------License-------------
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "skNoiseKernels.h"
+#include "skParallel.h"
+
+const char *toolName = "skNoiseStream";
+
+//number of chunks in flight, one for each stage of the pipeline
+const int STREAM_NUM_BUFFERS = 3;
+
+//size of the coordinates at the start of every record
+const int STREAM_POSITION_BYTES = 3 * sizeof(float);
+
+//stage of the pipeline that a buffer is waiting for
+enum BufferState
+{
+    BUFFER_FREE = 0,
+    BUFFER_READ,
+    BUFFER_DEFORMED
+};
+
+//parameters of one run
+struct StreamSettings
+{
+    NoiseQuery query;
+    float amps[3];
+    float env;
+    int stride;
+    int chunkSize;
+    int numTasks;
+};
+
+//records of one chunk and the working memory to deform them
+struct StreamBuffer
+{
+    std::vector<unsigned char> records;
+    std::vector<double> positions;
+    std::vector<float> noiseValues;
+    int numPoints;
+    int state;
+};
+
+//buffers that are handed from the reader to the deforming main thread and on to the writer
+struct StreamPipeline
+{
+    StreamBuffer buffers[STREAM_NUM_BUFFERS];
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    const StreamSettings *settings;
+    int inputFile;
+    FILE *outputFile;
+    long long numPoints;
+    long long numChunks;
+    bool failed;
+};
+
+//a range of the points of a chunk, deformed by one task
+typedef struct
+{
+    const StreamSettings *settings;
+    StreamBuffer *buffer;
+    int start;
+    int end;
+} StreamTask;
+
+//waits until the buffer reaches the given state, returning false if another stage failed
+static bool waitForBuffer(StreamPipeline *pipeline, StreamBuffer *buffer, int state)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    while (buffer->state != state && !pipeline->failed)
+    {
+        pthread_cond_wait(&pipeline->changed, &pipeline->mutex);
+    }
+    const bool failed = pipeline->failed;
+    pthread_mutex_unlock(&pipeline->mutex);
+    return !failed;
+}
+
+//hands the buffer on to the next stage
+static void setBufferState(StreamPipeline *pipeline, StreamBuffer *buffer, int state)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    buffer->state = state;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+//stops all stages of the pipeline
+static void failPipeline(StreamPipeline *pipeline, const char *message)
+{
+    fprintf(stderr, "[%s] %s\n", toolName, message);
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->failed = true;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+//reader stage, copies every chunk out of a memory map of its part of the input file
+static void* readChunks(void *data)
+{
+    StreamPipeline *pipeline = static_cast<StreamPipeline*>(data);
+    const StreamSettings *settings = pipeline->settings;
+    const off_t pageSize = sysconf(_SC_PAGESIZE);
+    long long chunk;
+    for (chunk = 0; chunk < pipeline->numChunks; ++chunk)
+    {
+        StreamBuffer *buffer = &pipeline->buffers[chunk % STREAM_NUM_BUFFERS];
+        if (!waitForBuffer(pipeline, buffer, BUFFER_FREE))
+        {
+            break;
+        }
+
+        //maps start at a page boundary
+        const long long firstPoint = chunk * settings->chunkSize;
+        buffer->numPoints = static_cast<int>(std::min(static_cast<long long>(settings->chunkSize), pipeline->numPoints - firstPoint));
+        const off_t start = static_cast<off_t>(firstPoint) * settings->stride;
+        const off_t mapStart = start - start % pageSize;
+        const size_t numBytes = static_cast<size_t>(buffer->numPoints) * settings->stride;
+        const size_t mapBytes = numBytes + static_cast<size_t>(start - mapStart);
+        void *map = mmap(NULL, mapBytes, PROT_READ, MAP_PRIVATE, pipeline->inputFile, mapStart);
+        if (MAP_FAILED == map)
+        {
+            failPipeline(pipeline, "Unable to map the input file");
+            break;
+        }
+        madvise(map, mapBytes, MADV_SEQUENTIAL);
+        memcpy(&buffer->records[0], static_cast<const char*>(map) + (start - mapStart), numBytes);
+        munmap(map, mapBytes);
+
+        setBufferState(pipeline, buffer, BUFFER_READ);
+    }
+    return NULL;
+}
+
+//writer stage, appends every deformed chunk to the output file
+static void* writeChunks(void *data)
+{
+    StreamPipeline *pipeline = static_cast<StreamPipeline*>(data);
+    const StreamSettings *settings = pipeline->settings;
+    long long chunk;
+    for (chunk = 0; chunk < pipeline->numChunks; ++chunk)
+    {
+        StreamBuffer *buffer = &pipeline->buffers[chunk % STREAM_NUM_BUFFERS];
+        if (!waitForBuffer(pipeline, buffer, BUFFER_DEFORMED))
+        {
+            break;
+        }
+        if (fwrite(&buffer->records[0], settings->stride, buffer->numPoints, pipeline->outputFile) != static_cast<size_t>(buffer->numPoints))
+        {
+            failPipeline(pipeline, "Unable to write the output file");
+            break;
+        }
+        setBufferState(pipeline, buffer, BUFFER_FREE);
+    }
+    return NULL;
+}
+
+//deforms a range of the points of a chunk in place, the same way as the deformers do for locator
+//space positions
+static void deformRange(void *data)
+{
+    const StreamTask *task = static_cast<const StreamTask*>(data);
+    const StreamSettings *settings = task->settings;
+    StreamBuffer *buffer = task->buffer;
+    unsigned char *records = &buffer->records[0];
+    double *positions = &buffer->positions[0];
+    float *noiseValues = &buffer->noiseValues[0];
+    float xyz[3];
+    int i, c;
+
+    //records are not aligned in general, so the coordinates are copied in and out
+    for (i = task->start; i < task->end; ++i)
+    {
+        memcpy(xyz, records + static_cast<size_t>(i) * settings->stride, STREAM_POSITION_BYTES);
+        positions[3 * i] = xyz[0];
+        positions[3 * i + 1] = xyz[1];
+        positions[3 * i + 2] = xyz[2];
+    }
+
+    evaluateNoiseQuery(settings->query, positions, task->start, task->end, noiseValues);
+
+    for (i = task->start; i < task->end; ++i)
+    {
+        for (c = 0; c < 3; ++c)
+        {
+            xyz[c] = static_cast<float>(positions[3 * i + c] + settings->amps[c] * noiseValues[3 * i + c] * settings->env);
+        }
+        memcpy(records + static_cast<size_t>(i) * settings->stride, xyz, STREAM_POSITION_BYTES);
+    }
+}
+
+//reads count numbers after the flag at argv[i] into values, advancing i past them
+static bool getFlagValues(int argc, char **argv, int& i, double *values, int count)
+{
+    char *end;
+    int j;
+    for (j = 0; j < count; ++j)
+    {
+        if (++i >= argc)
+        {
+            return false;
+        }
+        values[j] = strtod(argv[i], &end);
+        if (end == argv[i] || '\0' != *end)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "usage: %s [flags] input output\n", toolName);
+    fprintf(stderr, "flags: -amplitude (-amp) x y z, -frequency (-f) x y z, -offset (-o) x y z,\n");
+    fprintf(stderr, "       -octaves (-oc), -persistence (-p), -lacunarity (-l), -fractalMode (-fm),\n");
+    fprintf(stderr, "       -noiseType (-nty), -warpAmount (-wpa), -warpFrequency (-wpf),\n");
+    fprintf(stderr, "       -warpOctaves (-wpo), -envelope (-env), -stride (-s), -chunkSize (-cs),\n");
+    fprintf(stderr, "       -numTasks (-nt)\n");
+}
+
+int main(int argc, char **argv)
+{
+    //defaults of the deformer attributes
+    StreamSettings settings;
+    NoiseQuery &query = settings.query;
+    query.freqs[0] = query.freqs[1] = query.freqs[2] = 1.0f;
+    query.offsets[0] = query.offsets[1] = query.offsets[2] = 0.0f;
+    query.octaves = 1;
+    query.persistence = 0.5f;
+    query.lacunarity = 2.0f;
+    query.fractalMode = FRACTAL_MODE_FBM;
+    query.noiseType = NOISE_TYPE_SIMPLEX;
+    query.warp.amount = 0.0f;
+    query.warp.freq = 1.0f;
+    query.warp.octaves = 2;
+    settings.amps[0] = settings.amps[1] = settings.amps[2] = 1.0f;
+    settings.env = 1.0f;
+    settings.stride = STREAM_POSITION_BYTES;
+    settings.chunkSize = 1 << 20;
+    settings.numTasks = 16;
+
+    const char *paths[2] = { NULL, NULL };
+    int numPaths = 0;
+    double values[3];
+    bool valid = true;
+    int i;
+    for (i = 1; i < argc && valid; ++i)
+    {
+        const char *arg = argv[i];
+        if ('-' != arg[0])
+        {
+            valid = numPaths < 2;
+            if (valid)
+            {
+                paths[numPaths++] = arg;
+            }
+        }
+        else if (!strcmp(arg, "-amp") || !strcmp(arg, "-amplitude"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 3);
+            settings.amps[0] = static_cast<float>(values[0]);
+            settings.amps[1] = static_cast<float>(values[1]);
+            settings.amps[2] = static_cast<float>(values[2]);
+        }
+        else if (!strcmp(arg, "-f") || !strcmp(arg, "-frequency"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 3);
+            query.freqs[0] = static_cast<float>(values[0]);
+            query.freqs[1] = static_cast<float>(values[1]);
+            query.freqs[2] = static_cast<float>(values[2]);
+        }
+        else if (!strcmp(arg, "-o") || !strcmp(arg, "-offset"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 3);
+            query.offsets[0] = static_cast<float>(values[0]);
+            query.offsets[1] = static_cast<float>(values[1]);
+            query.offsets[2] = static_cast<float>(values[2]);
+        }
+        else if (!strcmp(arg, "-oc") || !strcmp(arg, "-octaves"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.octaves = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-p") || !strcmp(arg, "-persistence"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.persistence = static_cast<float>(values[0]);
+        }
+        else if (!strcmp(arg, "-l") || !strcmp(arg, "-lacunarity"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.lacunarity = static_cast<float>(values[0]);
+        }
+        else if (!strcmp(arg, "-fm") || !strcmp(arg, "-fractalMode"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.fractalMode = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-nty") || !strcmp(arg, "-noiseType"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.noiseType = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-wpa") || !strcmp(arg, "-warpAmount"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.warp.amount = static_cast<float>(values[0]);
+        }
+        else if (!strcmp(arg, "-wpf") || !strcmp(arg, "-warpFrequency"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.warp.freq = static_cast<float>(values[0]);
+        }
+        else if (!strcmp(arg, "-wpo") || !strcmp(arg, "-warpOctaves"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            query.warp.octaves = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-env") || !strcmp(arg, "-envelope"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.env = static_cast<float>(values[0]);
+        }
+        else if (!strcmp(arg, "-s") || !strcmp(arg, "-stride"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.stride = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-cs") || !strcmp(arg, "-chunkSize"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.chunkSize = static_cast<int>(values[0]);
+        }
+        else if (!strcmp(arg, "-nt") || !strcmp(arg, "-numTasks"))
+        {
+            valid = getFlagValues(argc, argv, i, values, 1);
+            settings.numTasks = static_cast<int>(values[0]);
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    if (!valid || numPaths != 2)
+    {
+        printUsage();
+        return 1;
+    }
+    if (query.octaves < 1 || (query.warp.amount != 0.0f && query.warp.octaves < 1))
+    {
+        fprintf(stderr, "[%s] octaves and warpOctaves must be at least 1\n", toolName);
+        return 1;
+    }
+    if (settings.stride < STREAM_POSITION_BYTES || settings.chunkSize < 1 || settings.numTasks < 1)
+    {
+        fprintf(stderr, "[%s] stride must be at least %d, chunkSize and numTasks at least 1\n", toolName, STREAM_POSITION_BYTES);
+        return 1;
+    }
+
+    //open the files, the input must hold whole records
+    StreamPipeline pipeline;
+    pipeline.settings = &settings;
+    pipeline.failed = false;
+    pipeline.inputFile = open(paths[0], O_RDONLY);
+    if (pipeline.inputFile < 0)
+    {
+        fprintf(stderr, "[%s] Unable to open %s\n", toolName, paths[0]);
+        return 1;
+    }
+    struct stat inputStat;
+    if (0 != fstat(pipeline.inputFile, &inputStat) || 0 != inputStat.st_size % settings.stride)
+    {
+        fprintf(stderr, "[%s] The size of %s is not a multiple of the stride\n", toolName, paths[0]);
+        close(pipeline.inputFile);
+        return 1;
+    }
+    pipeline.numPoints = inputStat.st_size / settings.stride;
+    pipeline.numChunks = (pipeline.numPoints + settings.chunkSize - 1) / settings.chunkSize;
+    pipeline.outputFile = fopen(paths[1], "wb");
+    if (!pipeline.outputFile)
+    {
+        fprintf(stderr, "[%s] Unable to open %s\n", toolName, paths[1]);
+        close(pipeline.inputFile);
+        return 1;
+    }
+
+    //allocate all buffers up front, they are the only memory that grows with the chunk size
+    const int chunkSize = static_cast<int>(std::min(static_cast<long long>(settings.chunkSize), std::max(pipeline.numPoints, 1LL)));
+    for (i = 0; i < STREAM_NUM_BUFFERS; ++i)
+    {
+        StreamBuffer &buffer = pipeline.buffers[i];
+        buffer.records.resize(static_cast<size_t>(chunkSize) * settings.stride);
+        buffer.positions.resize(3 * static_cast<size_t>(chunkSize));
+        buffer.noiseValues.resize(3 * static_cast<size_t>(chunkSize));
+        buffer.numPoints = 0;
+        buffer.state = BUFFER_FREE;
+    }
+    pthread_mutex_init(&pipeline.mutex, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+
+    timeval startTime;
+    gettimeofday(&startTime, NULL);
+    parallelInit();
+    pthread_t reader, writer;
+    pthread_create(&reader, NULL, readChunks, &pipeline);
+    pthread_create(&writer, NULL, writeChunks, &pipeline);
+
+    //deform stage, every chunk is split into tasks that run in parallel
+    std::vector<StreamTask> tasks(settings.numTasks);
+    long long chunk;
+    for (chunk = 0; chunk < pipeline.numChunks; ++chunk)
+    {
+        StreamBuffer *buffer = &pipeline.buffers[chunk % STREAM_NUM_BUFFERS];
+        if (!waitForBuffer(&pipeline, buffer, BUFFER_READ))
+        {
+            break;
+        }
+
+        const int taskSize = (buffer->numPoints + settings.numTasks - 1) / settings.numTasks;
+        int numTasks = 0;
+        int start;
+        for (start = 0; start < buffer->numPoints; start += taskSize)
+        {
+            StreamTask &task = tasks[numTasks++];
+            task.settings = &settings;
+            task.buffer = buffer;
+            task.start = start;
+            task.end = std::min(start + taskSize, buffer->numPoints);
+        }
+        parallelFor(numTasks, deformRange, &tasks[0], sizeof(StreamTask));
+
+        setBufferState(&pipeline, buffer, BUFFER_DEFORMED);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+    parallelRelease();
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.mutex);
+    close(pipeline.inputFile);
+    if (0 != fclose(pipeline.outputFile) && !pipeline.failed)
+    {
+        fprintf(stderr, "[%s] Unable to write %s\n", toolName, paths[1]);
+        return 1;
+    }
+    if (pipeline.failed)
+    {
+        return 1;
+    }
+
+    timeval endTime;
+    gettimeofday(&endTime, NULL);
+    const double seconds = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_usec - startTime.tv_usec) * 1.0e-6;
+    printf("[%s] Deformed %lld points in %lld chunks in %.2f s\n", toolName, pipeline.numPoints, pipeline.numChunks, seconds);
+
+    return 0;
+}
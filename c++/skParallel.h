@@ -0,0 +1,391 @@
+/*
+ * Parallel-for layer of the noise deformer plugins, with interchangeable
+ * backends picked at build time (see PARALLEL in the makefile):
+ *
+ *     SK_PARALLEL_MTHREADPOOL  Maya's MThreadPool (the default)
+ *     SK_PARALLEL_OPENMP       OpenMP, needs -fopenmp (gcc 4.2 or later)
+ *     SK_PARALLEL_TBB          Intel TBB, needs -ltbb
+ *     SK_PARALLEL_PTHREAD      a built-in pool of POSIX threads
+ *
+ * parallelFor() runs a task once for every item of an array and returns when
+ * all of them are done. Every backend runs each item exactly once and items
+ * never share outputs, so the results are identical whatever the backend and
+ * the number of threads. Only the MThreadPool backend depends on Maya.
+ *
+ * parallelSetNumThreads() limits the number of threads for benchmarks, on
+ * every backend but MThreadPool, whose threads are set up by Maya.
+ *
+ * ---------License-------------
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ *
+ */
+
+#ifndef _SK_PARALLEL_H_
+#define _SK_PARALLEL_H_
+
+#include <cstddef>
+
+#if !defined(SK_PARALLEL_OPENMP) && !defined(SK_PARALLEL_TBB) && !defined(SK_PARALLEL_PTHREAD)
+#define SK_PARALLEL_MTHREADPOOL
+#endif
+
+#if defined(SK_PARALLEL_MTHREADPOOL)
+#include <maya/MThreadPool.h>
+#include <maya/MAtomic.h>
+#elif defined(SK_PARALLEL_OPENMP)
+#include <omp.h>
+#elif defined(SK_PARALLEL_TBB)
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#if TBB_INTERFACE_VERSION >= 11000
+#include <tbb/global_control.h>
+#else
+#include <tbb/task_scheduler_init.h>
+#endif
+#elif defined(SK_PARALLEL_PTHREAD)
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+#endif
+
+//task that processes one item
+typedef void (*ParallelTask)(void *item);
+
+//one call of parallelFor, items are claimed one at a time through next
+struct ParallelJob
+{
+    ParallelTask task;
+    char *items;
+    size_t itemSize;
+    int count;
+    volatile int next;
+};
+
+//runs the items of a job that are not claimed yet, returning once there are none left
+inline void runParallelJob(ParallelJob *job)
+{
+    int i;
+#if defined(SK_PARALLEL_MTHREADPOOL)
+    while ((i = MAtomic::postIncrement(&job->next)) < job->count)
+#else
+    while ((i = __sync_fetch_and_add(&job->next, 1)) < job->count)
+#endif
+    {
+        job->task(job->items + i * job->itemSize);
+    }
+}
+
+#if defined(SK_PARALLEL_MTHREADPOOL)
+
+#define SK_PARALLEL_BACKEND_NAME "MThreadPool"
+
+inline MThreadRetVal parallelPoolTask(void *data)
+{
+    runParallelJob(static_cast<ParallelJob*>(data));
+    return static_cast<MThreadRetVal>(0);
+}
+
+//creates one pool task per item, each of which claims the next item of the job
+inline void parallelPoolRegion(void *data, MThreadRootTask *root)
+{
+    ParallelJob *job = static_cast<ParallelJob*>(data);
+    int i;
+    for (i = 0; i < job->count; ++i)
+    {
+        MThreadPool::createTask(parallelPoolTask, data, root);
+    }
+    MThreadPool::executeAndJoin(root);
+}
+
+inline bool parallelInit()
+{
+    return MThreadPool::init() == MS::kSuccess;
+}
+
+inline void parallelRelease()
+{
+    MThreadPool::release();
+}
+
+inline void parallelRun(ParallelJob *job)
+{
+    MThreadPool::newParallelRegion(parallelPoolRegion, static_cast<void*>(job));
+}
+
+inline bool parallelSetNumThreads(int)
+{
+    return false;
+}
+
+#elif defined(SK_PARALLEL_OPENMP)
+
+#define SK_PARALLEL_BACKEND_NAME "OpenMP"
+
+inline bool parallelInit()
+{
+    return true;
+}
+
+inline void parallelRelease()
+{
+}
+
+inline void parallelRun(ParallelJob *job)
+{
+    const int count = job->count;
+    int i;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (i = 0; i < count; ++i)
+    {
+        job->task(job->items + i * job->itemSize);
+    }
+}
+
+inline bool parallelSetNumThreads(int numThreads)
+{
+    omp_set_num_threads(numThreads > 0 ? numThreads : omp_get_num_procs());
+    return true;
+}
+
+#elif defined(SK_PARALLEL_TBB)
+
+#define SK_PARALLEL_BACKEND_NAME "TBB"
+
+//body of tbb::parallel_for over the items of a job
+struct ParallelTbbBody
+{
+    const ParallelJob *job;
+
+    void operator()(const tbb::blocked_range<int>& range) const
+    {
+        int i;
+        for (i = range.begin(); i != range.end(); ++i)
+        {
+            job->task(job->items + i * job->itemSize);
+        }
+    }
+};
+
+inline bool parallelInit()
+{
+    return true;
+}
+
+inline void parallelRelease()
+{
+}
+
+inline void parallelRun(ParallelJob *job)
+{
+    ParallelTbbBody body;
+    body.job = job;
+    tbb::parallel_for(tbb::blocked_range<int>(0, job->count, 1), body);
+}
+
+//the limit holds for as long as its control object lives
+inline bool parallelSetNumThreads(int numThreads)
+{
+#if TBB_INTERFACE_VERSION >= 11000
+    static tbb::global_control *control = NULL;
+    delete control;
+    control = numThreads > 0 ? new tbb::global_control(tbb::global_control::max_allowed_parallelism, numThreads) : NULL;
+#else
+    static tbb::task_scheduler_init *control = NULL;
+    delete control;
+    control = numThreads > 0 ? new tbb::task_scheduler_init(numThreads) : NULL;
+#endif
+    return true;
+}
+
+#elif defined(SK_PARALLEL_PTHREAD)
+
+#define SK_PARALLEL_BACKEND_NAME "pthread"
+
+//pool of worker threads that help the calling thread through the current job. Workers pick up a
+//job under the mutex and are counted in active until they are done with it, so the caller can
+//wait for all of them before its job goes out of scope.
+struct ParallelPool
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t finished;
+    pthread_mutex_t runMutex;
+    std::vector<pthread_t> threads;
+    ParallelJob *job;
+    unsigned int generation;
+    int active;
+    int refCount;
+    int numThreads;
+    bool quit;
+};
+
+inline ParallelPool& parallelPool()
+{
+    static ParallelPool pool;
+    return pool;
+}
+
+inline void* parallelWorker(void *data)
+{
+    ParallelPool *pool = static_cast<ParallelPool*>(data);
+    pthread_mutex_lock(&pool->mutex);
+    unsigned int seen = pool->generation;
+    for (;;)
+    {
+        while (!pool->quit && seen == pool->generation)
+        {
+            pthread_cond_wait(&pool->wake, &pool->mutex);
+        }
+        if (pool->quit)
+        {
+            break;
+        }
+        seen = pool->generation;
+
+        //the job is NULL if the caller already finished it alone
+        ParallelJob *job = pool->job;
+        if (!job)
+        {
+            continue;
+        }
+        ++pool->active;
+        pthread_mutex_unlock(&pool->mutex);
+        runParallelJob(job);
+        pthread_mutex_lock(&pool->mutex);
+        if (0 == --pool->active)
+        {
+            pthread_cond_signal(&pool->finished);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+//starts one worker per processor (or per thread set by parallelSetNumThreads()) besides the
+//calling thread, on the first call only
+inline bool parallelInit()
+{
+    ParallelPool &pool = parallelPool();
+    if (pool.refCount++ > 0)
+    {
+        return true;
+    }
+
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+    pthread_cond_init(&pool.finished, NULL);
+    pthread_mutex_init(&pool.runMutex, NULL);
+    pool.job = NULL;
+    pool.generation = 0;
+    pool.active = 0;
+    pool.quit = false;
+
+    const long numThreads = pool.numThreads > 0 ? pool.numThreads : sysconf(_SC_NPROCESSORS_ONLN);
+    const int numWorkers = numThreads > 1 ? static_cast<int>(numThreads) - 1 : 0;
+    pool.threads.reserve(numWorkers);
+    int i;
+    for (i = 0; i < numWorkers; ++i)
+    {
+        pthread_t thread;
+        if (0 != pthread_create(&thread, NULL, parallelWorker, &pool))
+        {
+            break;
+        }
+        pool.threads.push_back(thread);
+    }
+    return true;
+}
+
+//stops the workers once the last user is gone
+inline void parallelRelease()
+{
+    ParallelPool &pool = parallelPool();
+    if (pool.refCount <= 0 || --pool.refCount > 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.mutex);
+    size_t i;
+    for (i = 0; i < pool.threads.size(); ++i)
+    {
+        pthread_join(pool.threads[i], NULL);
+    }
+    pool.threads.clear();
+
+    pthread_mutex_destroy(&pool.runMutex);
+    pthread_cond_destroy(&pool.finished);
+    pthread_cond_destroy(&pool.wake);
+    pthread_mutex_destroy(&pool.mutex);
+}
+
+inline void parallelRun(ParallelJob *job)
+{
+    ParallelPool &pool = parallelPool();
+    if (pool.threads.empty() || job->count < 2)
+    {
+        runParallelJob(job);
+        return;
+    }
+
+    //one job at a time, callers on other threads queue up here
+    pthread_mutex_lock(&pool.runMutex);
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.job = job;
+    ++pool.generation;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.mutex);
+
+    runParallelJob(job);
+
+    //wait for the workers that are still on their last item
+    pthread_mutex_lock(&pool.mutex);
+    while (pool.active > 0)
+    {
+        pthread_cond_wait(&pool.finished, &pool.mutex);
+    }
+    pool.job = NULL;
+    pthread_mutex_unlock(&pool.mutex);
+
+    pthread_mutex_unlock(&pool.runMutex);
+}
+
+//the workers are only started by parallelInit(), so this fails while the pool is running
+inline bool parallelSetNumThreads(int numThreads)
+{
+    ParallelPool &pool = parallelPool();
+    if (pool.refCount > 0)
+    {
+        return false;
+    }
+    pool.numThreads = numThreads;
+    return true;
+}
+
+#endif
+
+//calls task for each of the count items of itemSize bytes starting at items, in parallel, and
+//returns once all of them are done
+inline void parallelFor(int count, ParallelTask task, void *items, size_t itemSize)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    ParallelJob job;
+    job.task = task;
+    job.items = static_cast<char*>(items);
+    job.itemSize = itemSize;
+    job.count = count;
+    job.next = 0;
+    parallelRun(&job);
+}
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Timeline tracing for the noise deformer plugins.
+ *
+ * A trace session records complete events (a name, a start time and a
+ * duration) for every thread that takes part in an evaluation. It writes
+ * them out in the Chrome trace event format, which chrome://tracing and
+ * Perfetto (https://ui.perfetto.dev) open as one timeline row per thread.
+ * Each thread records into a ring buffer of its own, so recording takes no
+ * lock. Once a buffer is full, the oldest events of that thread are
+ * overwritten. A session must only be written out while no thread is
+ * recording into it, e.g. after the parallel region has returned.
+ *
+ * This header does not depend on Maya.
+ *
+ * ---------License-------------
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ *
+ */
+
+#ifndef _SK_TRACE_H_
+#define _SK_TRACE_H_
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#if defined(LINUX) || defined(LINUX_64)
+#include <sys/time.h>
+#endif
+
+//number of threads and number of events per thread that a session keeps
+const int TRACE_MAX_THREADS = 256;
+const unsigned int TRACE_BUFFER_EVENTS = 16384;
+
+//one complete event, with times in microseconds since the start of the session
+typedef struct
+{
+    const char *name;
+    const char *argName;
+    int arg;
+    double start;
+    double duration;
+} TraceEvent;
+
+//ring buffer of the events of one thread, only ever written by that thread
+typedef struct
+{
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    unsigned int count;
+} TraceBuffer;
+
+//returns the current time in microseconds
+inline double traceClock()
+{
+#if defined(LINUX) || defined(LINUX_64)
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1.0e6 + tv.tv_usec;
+#else
+    return std::clock() * (1.0e6 / CLOCKS_PER_SEC);
+#endif
+}
+
+//returns a small id for the calling thread. Ids are handed out in the order in which threads
+//first ask for one, and the same id is used for the row of that thread in every trace.
+inline int traceThreadId()
+{
+    static volatile int numThreads = 0;
+    static __thread int threadId = -1;
+    if (threadId < 0)
+    {
+        threadId = __sync_fetch_and_add(&numThreads, 1);
+    }
+    return threadId;
+}
+
+//events of all threads since the last time the session was written out
+struct TraceSession
+{
+    TraceBuffer *buffers[TRACE_MAX_THREADS];
+    double origin;
+    int numEvaluations;
+    int numFiles;
+
+    TraceSession()
+        : origin(traceClock()),
+          numEvaluations(0),
+          numFiles(0)
+    {
+        memset(buffers, 0, sizeof(buffers));
+    }
+
+    ~TraceSession()
+    {
+        int i;
+        for (i = 0; i < TRACE_MAX_THREADS; ++i)
+        {
+            delete buffers[i];
+        }
+    }
+
+    //records an event of the calling thread that started at the given time and ends now. The
+    //names must be string literals, since only the pointers are kept.
+    void record(const char *name, double start, const char *argName, int arg)
+    {
+        const double end = traceClock();
+        const int threadId = traceThreadId();
+        if (threadId >= TRACE_MAX_THREADS)
+        {
+            return;
+        }
+
+        //the buffer is allocated by the thread that owns it
+        TraceBuffer *buffer = buffers[threadId];
+        if (!buffer)
+        {
+            buffer = new TraceBuffer;
+            buffer->count = 0;
+            buffers[threadId] = buffer;
+        }
+
+        TraceEvent &event = buffer->events[buffer->count % TRACE_BUFFER_EVENTS];
+        event.name = name;
+        event.argName = argName;
+        event.arg = arg;
+        event.start = start - origin;
+        event.duration = end - start;
+        ++buffer->count;
+    }
+
+    //writes the recorded events to a Chrome trace file and clears them, returning whether the
+    //file could be written
+    bool write(const char *path)
+    {
+        FILE *file = fopen(path, "w");
+        if (!file)
+        {
+            return false;
+        }
+
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"skNoiseDeformer\"}}");
+        int i;
+        unsigned int j;
+        for (i = 0; i < TRACE_MAX_THREADS; ++i)
+        {
+            TraceBuffer *buffer = buffers[i];
+            if (!buffer || 0 == buffer->count)
+            {
+                continue;
+            }
+
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", i, i);
+
+            //only the newest events are left once the ring buffer has wrapped around
+            const unsigned int first = buffer->count > TRACE_BUFFER_EVENTS ? buffer->count - TRACE_BUFFER_EVENTS : 0;
+            for (j = first; j < buffer->count; ++j)
+            {
+                const TraceEvent &event = buffer->events[j % TRACE_BUFFER_EVENTS];
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                        event.name, i, event.start, event.duration);
+                if (event.argName)
+                {
+                    fprintf(file, ",\"args\":{\"%s\":%d}", event.argName, event.arg);
+                }
+                fprintf(file, "}");
+            }
+            buffer->count = 0;
+        }
+        fprintf(file, "\n]}\n");
+
+        return 0 == fclose(file);
+    }
+
+private:
+    TraceSession(const TraceSession&);
+    TraceSession& operator=(const TraceSession&);
+};
+
+//returns the start time of an event, or 0 if there is no session to record it in
+inline double traceBegin(const TraceSession *trace)
+{
+    return trace ? traceClock() : 0.0;
+}
+
+//records an event that started at the given time, if there is a session
+inline void traceEnd(TraceSession *trace, const char *name, double start, const char *argName = NULL, int arg = 0)
+{
+    if (trace)
+    {
+        trace->record(name, start, argName, arg);
+    }
+}
+
+#endif
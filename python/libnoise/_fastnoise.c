@@ -0,0 +1,229 @@
+/*
+ * Batched fBm evaluation for skScriptedNoiseDeformer.py, built from the same
+ * _simplex.c that the C++ plugins use.
+ *
+ * Each function takes flat float32 buffers (e.g. array.array('f')) holding
+ * x, y, z triples and writes the results into a float32 output buffer. The GIL
+ * is released while the noise is being evaluated.
+ *
+ * Build it into this directory with:
+ *
+ *     > mayapy setup.py build_ext --inplace
+ *
+ * Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+ * (http://cg.skeelogy.com)
+ */
+
+#include "Python.h"
+#include "_simplex.c"
+
+/* wraps the buffer protocol of the running Python version */
+typedef struct {
+    float *data;
+    Py_ssize_t length;
+#if PY_MAJOR_VERSION >= 3
+    Py_buffer view;
+#endif
+} FloatBuffer;
+
+static int
+get_float_buffer(PyObject *obj, FloatBuffer *buffer, int writable, const char *name)
+{
+    Py_ssize_t numBytes;
+#if PY_MAJOR_VERSION >= 3
+    int flags = PyBUF_FORMAT | PyBUF_C_CONTIGUOUS | (writable ? PyBUF_WRITABLE : 0);
+    if (PyObject_GetBuffer(obj, &buffer->view, flags) < 0) {
+        return -1;
+    }
+    if (buffer->view.itemsize != sizeof(float)
+        || !buffer->view.format || strcmp(buffer->view.format, "f") != 0) {
+        PyBuffer_Release(&buffer->view);
+        PyErr_Format(PyExc_TypeError, "%s must be a float32 buffer, e.g. array.array('f')", name);
+        return -1;
+    }
+    buffer->data = (float *) buffer->view.buf;
+    numBytes = buffer->view.len;
+#else
+    /* the old buffer protocol has no item format, so only arrays with the 'f' typecode are taken */
+    PyObject *typecode = PyObject_GetAttrString(obj, "typecode");
+    int isFloat = typecode && PyString_Check(typecode) && strcmp(PyString_AsString(typecode), "f") == 0;
+    Py_XDECREF(typecode);
+    if (!isFloat) {
+        PyErr_Clear();
+        PyErr_Format(PyExc_TypeError, "%s must be a float32 buffer, e.g. array.array('f')", name);
+        return -1;
+    }
+    if (writable) {
+        void *data;
+        if (PyObject_AsWriteBuffer(obj, &data, &numBytes) < 0) {
+            return -1;
+        }
+        buffer->data = (float *) data;
+    } else {
+        const void *data;
+        if (PyObject_AsReadBuffer(obj, &data, &numBytes) < 0) {
+            return -1;
+        }
+        buffer->data = (float *) data;
+    }
+    if (numBytes % sizeof(float)) {
+        PyErr_Format(PyExc_TypeError, "%s must be a float32 buffer, e.g. array.array('f')", name);
+        return -1;
+    }
+#endif
+    buffer->length = numBytes / sizeof(float);
+    return 0;
+}
+
+static void
+release_float_buffer(FloatBuffer *buffer)
+{
+#if PY_MAJOR_VERSION >= 3
+    PyBuffer_Release(&buffer->view);
+#else
+    (void) buffer;
+#endif
+}
+
+/* parses the common arguments and checks the buffer sizes */
+static int
+parse_batch_args(PyObject *args, PyObject *kwargs, const char *format, int channels,
+                 FloatBuffer *points, FloatBuffer *out,
+                 int *octaves, float *persistence, float *lacunarity)
+{
+    static char *kwlist[] = {"points", "out", "octaves", "persistence", "lacunarity", NULL};
+    PyObject *pointsObj, *outObj;
+
+    *octaves = 1;
+    *persistence = 0.5f;
+    *lacunarity = 2.0f;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, format, kwlist,
+        &pointsObj, &outObj, octaves, persistence, lacunarity)) {
+        return -1;
+    }
+    if (*octaves <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Expected octaves value > 0");
+        return -1;
+    }
+
+    if (get_float_buffer(pointsObj, points, 0, "points") < 0) {
+        return -1;
+    }
+    if (get_float_buffer(outObj, out, 1, "out") < 0) {
+        release_float_buffer(points);
+        return -1;
+    }
+    if (points->length % 3 || out->length != points->length / 3 * channels) {
+        release_float_buffer(points);
+        release_float_buffer(out);
+        PyErr_Format(PyExc_ValueError,
+            "Expected points to hold x, y, z triples and out to hold %d value(s) per point", channels);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *
+py_fbm_noise3(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    FloatBuffer points, out;
+    int octaves;
+    float persistence, lacunarity;
+    Py_ssize_t i, numPoints;
+    const float *p;
+
+    if (parse_batch_args(args, kwargs, "OO|iff:fbm_noise3", 1,
+        &points, &out, &octaves, &persistence, &lacunarity) < 0) {
+        return NULL;
+    }
+
+    numPoints = points.length / 3;
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < numPoints; ++i) {
+        p = points.data + 3 * i;
+        out.data[i] = fbm_noise3(p[0], p[1], p[2], octaves, persistence, lacunarity);
+    }
+    Py_END_ALLOW_THREADS
+
+    release_float_buffer(&points);
+    release_float_buffer(&out);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+py_fbm_noise3_channels(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    FloatBuffer points, out;
+    int octaves;
+    float persistence, lacunarity;
+    Py_ssize_t i, numPoints;
+    const float *p;
+    float *o;
+
+    if (parse_batch_args(args, kwargs, "OO|iff:fbm_noise3_channels", 3,
+        &points, &out, &octaves, &persistence, &lacunarity) < 0) {
+        return NULL;
+    }
+
+    numPoints = points.length / 3;
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < numPoints; ++i) {
+        p = points.data + 3 * i;
+        o = out.data + 3 * i;
+        o[0] = fbm_noise3(p[0], p[1], p[2], octaves, persistence, lacunarity);
+        o[1] = fbm_noise3(p[0] + 123, p[1] + 456, p[2] + 789, octaves, persistence, lacunarity);
+        o[2] = fbm_noise3(p[0] + 234, p[1] + 567, p[2] + 890, octaves, persistence, lacunarity);
+    }
+    Py_END_ALLOW_THREADS
+
+    release_float_buffer(&points);
+    release_float_buffer(&out);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef fastnoise_functions[] = {
+	{"fbm_noise3", (PyCFunction)py_fbm_noise3, METH_VARARGS | METH_KEYWORDS,
+		"fbm_noise3(points, out, octaves=1, persistence=0.5, lacunarity=2.0) "
+		"writes the fBm simplex noise value of every point into out.\n\n"
+		"points -- float32 buffer of x, y, z triples, e.g. array.array('f').\n\n"
+		"out -- writable float32 buffer with one value per point."},
+	{"fbm_noise3_channels", (PyCFunction)py_fbm_noise3_channels, METH_VARARGS | METH_KEYWORDS,
+		"fbm_noise3_channels(points, out, octaves=1, persistence=0.5, lacunarity=2.0) "
+		"writes three fBm simplex noise values per point into out, one for each\n"
+		"displacement axis, sampled at the same channel offsets as the deformer plugins.\n\n"
+		"points -- float32 buffer of x, y, z triples, e.g. array.array('f').\n\n"
+		"out -- writable float32 buffer with three values per point."},
+	{NULL}
+};
+
+PyDoc_STRVAR(module_doc, "Batched native-code fBm simplex noise functions");
+
+#if PY_MAJOR_VERSION >= 3
+
+static struct PyModuleDef moduledef = {
+	PyModuleDef_HEAD_INIT,
+	"_fastnoise",
+	module_doc,
+	-1,                   /* m_size */
+	fastnoise_functions,  /* m_methods */
+	NULL,                 /* m_reload (unused) */
+	NULL,                 /* m_traverse */
+	NULL,                 /* m_clear */
+	NULL                  /* m_free */
+};
+
+PyMODINIT_FUNC
+PyInit__fastnoise(void)
+{
+    return PyModule_Create(&moduledef);
+}
+
+#else
+
+PyMODINIT_FUNC
+init_fastnoise(void)
+{
+	Py_InitModule3("_fastnoise", fastnoise_functions, module_doc);
+}
+
+#endif
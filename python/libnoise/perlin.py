@@ -62,7 +62,7 @@ class BaseNoise:
 		135,130,116,188,159,86,164,100,109,198,173,186,3,64,52,217,226,250,124,123,
 		5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
 		223,183,170,213,119,248,152,2,44,154,163,70,221,153,101,155,167,43,172,9,
-		129,22,39,253,9,98,108,110,79,113,224,232,178,185,112,104,218,246,97,228,
+		129,22,39,253,19,98,108,110,79,113,224,232,178,185,112,104,218,246,97,228,
 		251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
 		49,192,214,31,181,199,106,157,184,84,204,176,115,121,50,45,127,4,150,254,
 		138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180)
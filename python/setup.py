@@ -0,0 +1,26 @@
+"""
+Builds the optional libnoise._fastnoise extension module used by
+skScriptedNoiseDeformer.py. It is compiled from the same _simplex.c as the C++
+plugins.
+
+Build it in place (next to libnoise/perlin.py) with:
+
+    > mayapy setup.py build_ext --inplace
+
+Released under The MIT License (MIT) Copyright (c) 2014 Skeel Lee
+(http://cg.skeelogy.com)
+"""
+
+from distutils.core import setup, Extension
+
+setup(
+    name = 'skNoiseDeformer-libnoise',
+    version = '1.0',
+    ext_modules = [
+        Extension(
+            'libnoise._fastnoise',
+            sources = ['libnoise/_fastnoise.c'],
+            include_dirs = ['../c++/libnoise'],
+        ),
+    ],
+)
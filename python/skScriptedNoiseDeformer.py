@@ -54,6 +54,28 @@ compiling/installing the noise library into mayapy.
         >>> noise.snoise3(2, 8, 3)
         -0.6522196531295776
 
+Faster still is the libnoise._fastnoise extension module that ships with this
+plugin. It is compiled from the same simplex noise code as the C++ plugins and
+evaluates all the points of a geometry in a single call:
+
+1) Execute this command in a terminal from this directory:
+
+        > `which mayapy` setup.py build_ext --inplace
+
+2) To verify that the build has worked, try doing this in a shell from this
+   directory:
+
+        > mayapy
+        [mayapy shell loads...]
+        >>> import array, libnoise._fastnoise
+        >>> out = array.array('f', [0])
+        >>> libnoise._fastnoise.fbm_noise3(array.array('f', [2, 8, 3]), out)
+        >>> out[0]
+        -0.6522196531295776
+
+The plugin uses libnoise._fastnoise when it can be imported, then the noise
+module, then perlin.py.
+
 Note that this Python plugin will still work if you are unable to perform the
 steps above. The plugin will fall back to a pure-Python perlin.py module from
 Casey Duncan if it cannot find the compiled noise module above. The speed is
@@ -82,6 +104,13 @@ except:
     import libnoise.perlin
     noise = libnoise.perlin.SimplexNoise()
 
+try:
+    #import the batched C noise module if user has built it with setup.py
+    import libnoise._fastnoise as fastnoise
+except ImportError:
+    fastnoise = None
+
+import array
 import sys
 
 import maya.OpenMaya as om
@@ -134,12 +163,20 @@ class SkScriptedNoiseDeformer(omMPx.MPxDeformerNode):
         localToLocatorSpaceMat = localToWorldMat * locatorWorldSpaceMat.inverse()
         locatorToLocalSpaceMat = locatorWorldSpaceMat * localToWorldMat.inverse()
 
+        #evaluate all the points in one native call if possible
+        if fastnoise:
+            self.deformBatched(dataBlock, geomIter, multiIndex, envFloat,
+                ampFloats, freqFloats, offsetFloats, octavesInt, lacunarityFloat, persistenceFloat,
+                localToLocatorSpaceMat, locatorToLocalSpaceMat)
+            return
+
         #iterate through all the points
         while not geomIter.isDone():
 
             #get weight value for this point, continue if sufficiently near to 0
             weightFloat = self.weightValue(dataBlock, multiIndex, geomIter.index())
             if weightFloat <= EPSILON:
+                geomIter.next()
                 continue
 
             #get locator space position
@@ -180,6 +217,54 @@ class SkScriptedNoiseDeformer(omMPx.MPxDeformerNode):
 
             geomIter.next()
 
+    def deformBatched(self, dataBlock, geomIter, multiIndex, envFloat,
+        ampFloats, freqFloats, offsetFloats, octavesInt, lacunarityFloat, persistenceFloat,
+        localToLocatorSpaceMat, locatorToLocalSpaceMat):
+
+        #get all the positions at once
+        points = om.MPointArray()
+        geomIter.allPositions(points)
+
+        #gather the noise space positions of the points that have non-zero weights
+        indices = []
+        weights = []
+        noiseInputs = array.array('f')
+        i = 0
+        while not geomIter.isDone():
+            weightFloat = self.weightValue(dataBlock, multiIndex, geomIter.index())
+            if weightFloat > EPSILON:
+                pos = points[i] * localToLocatorSpaceMat
+                indices.append(i)
+                weights.append(weightFloat)
+                noiseInputs.append(freqFloats[0] * pos.x - offsetFloats[0])
+                noiseInputs.append(freqFloats[1] * pos.y - offsetFloats[1])
+                noiseInputs.append(freqFloats[2] * pos.z - offsetFloats[2])
+            i += 1
+            geomIter.next()
+        if not indices:
+            return
+
+        #evaluate the three displacement channels of all the points
+        noiseValues = array.array('f', [0.0]) * len(noiseInputs)
+        fastnoise.fbm_noise3_channels(noiseInputs, noiseValues,
+            octaves = octavesInt,
+            persistence = persistenceFloat,
+            lacunarity = lacunarityFloat
+        )
+
+        #displace in locator space and convert back to local space
+        for j in range(len(indices)):
+            i = indices[j]
+            envTimesWeight = envFloat * weights[j]
+            pos = points[i] * localToLocatorSpaceMat
+            pos.x += ampFloats[0] * noiseValues[3 * j] * envTimesWeight
+            pos.y += ampFloats[1] * noiseValues[3 * j + 1] * envTimesWeight
+            pos.z += ampFloats[2] * noiseValues[3 * j + 2] * envTimesWeight
+            points.set(pos * locatorToLocalSpaceMat, i)
+
+        #set all the new positions at once
+        geomIter.setAllPositions(points)
+
     def accessoryNodeSetup(self, dagMod):
 
         thisObj = self.thisMObject()